@@ -1,56 +1,177 @@
 #include "ASMParser.h"
+#include "MappedFile.h"
+#include "ParallelScan.h"
+
+#include <algorithm>
+#include <memory>
 
 // Specify a text file containing MIPS assembly instructions. Function
 // checks syntactic correctness of file and creates a list of Instructions.
-ASMParser::ASMParser(string filename) {
+// With more than one thread the file is split at line ends and the
+// pieces are parsed at the same time. If requireLabels is true, a label
+// that is never defined is an error even in a file that defines none.
+ASMParser::ASMParser(string filename, int numThreads, bool requireLabels) {
+    myLabelAddress = 0;
+    myRequireLabels = requireLabels;
+    myLineCount = 0;
+
+    // A file that cannot be read holds no instructions, and says so
+    MappedFile file(filename);
+    const char* data = (const char*)file.getData();
+    size_t size = data ? file.getSize() : 0;
+    if (!file.isOpen())
+        addError(1, "the file could not be read");
+
+    if (numThreads <= 1)
+        parseLines(data, data + size);
+    else {
+        // Labels are only looked up once every piece is in, so pieces
+        // need nothing from the ones before them
+        vector<size_t> bounds = splitAtLines(data, size, numThreads);
+        int numChunks = bounds.size() - 1;
+        vector<unique_ptr<ASMParser> > chunks(numChunks);
+        parallelForChunks(numChunks, numChunks, [&](int chunk, int begin, int end) {
+            chunks[chunk].reset(new ASMParser());
+            chunks[chunk]->parseLines(data + bounds[chunk], data + bounds[chunk + 1]);
+        });
+        for (int c = 0; c < numChunks; c++)
+            append(*chunks[c]);
+    }
+    finish();
+}
 
-    Instruction i;
+// Reads MIPS assembly instructions from in, such as standard input.
+// Function checks syntactic correctness and creates a list of Instructions.
+// If requireLabels is true, every label used must be defined.
+ASMParser::ASMParser(istream& in, bool requireLabels) {
+    myLabelAddress = 0;
+    myRequireLabels = requireLabels;
+    myLineCount = 0;
+
+    string line;
+    while (getline(in, line))
+        parseLine(line);
+    if (in.bad())
+        addError(myLineCount + 1, "the input could not be read");
+    finish();
+}
+
+// Creates a parser for one piece of a file
+ASMParser::ASMParser() {
+    myLabelAddress = 0;
+    myRequireLabels = false;
+    myLineCount = 0;
     myFormatCorrect = true;
+    myIndex = 0;
+}
 
-    ifstream in;
-    in.open(filename.c_str());
+// Checks the syntax of one line and collects its instruction and label
+void ASMParser::parseLine(string line) {
+    long long lineNumber = ++myLineCount;
+    Instruction i;
+    string opcode("");
+    string operand[80];
+    int operand_count = 0;
 
+    if (line.length() == 0)
+        return;
 
-    if (in.bad())
-        myFormatCorrect = false;
-    else {
-        string line;
-        while (getline(in, line)) {
-            string opcode("");
-            string operand[80];
-            int operand_count = 0;
+    // A label marks the next instruction, on this line or a later one
+    string label;
+    if (splitLabel(line, label)) {
+        LabelDefinition definition;
+        definition.label = label;
+        definition.instruction = myInstructions.size();
+        definition.line = lineNumber;
+        myLabelDefinitions.push_back(definition);
+    }
+    if (isBlankLine(line))
+        return;
 
-            if (line.length() == 0)
-                continue;
+    getTokens(line, opcode, operand, operand_count);
 
-            getTokens(line, opcode, operand, operand_count);
+    if (opcode.length() == 0 && operand_count != 0) {
+        addError(lineNumber, "operands without an opcode");
+        return;
+    }
 
-            if (opcode.length() == 0 && operand_count != 0) {
-                // No opcode but operands
-                myFormatCorrect = false;
-                break;
-            }
+    Opcode o = opcodes.getOpcode(opcode);
+    if (o == UNDEFINED) {
+        addError(lineNumber, "unknown opcode " + opcode);
+        return;
+    }
 
-            Opcode o = opcodes.getOpcode(opcode);
-            if (o == UNDEFINED) {
-                // invalid opcode specified
-                myFormatCorrect = false;
-                break;
-            }
+    if (!getOperands(i, o, operand, operand_count)) {
+        addError(lineNumber, "bad operands for " + opcode);
+        return;
+    }
 
-            bool success = getOperands(i, o, operand, operand_count);
+    // Listings with labels indent their instructions, which the tables
+    // should not repeat
+    unsigned int start = 0;
+    while (start < line.length() && isWhitespace(line.at(start)))
+        start++;
+    i.setAssembly(line.substr(start));
+    myInstructions.push_back(i);
+}
 
-            if (!success) {
-                myFormatCorrect = false;
-                break;
-            }
+// Parses each line from begin up to end
+void ASMParser::parseLines(const char* begin, const char* end) {
+    const char* p = begin;
+    while (p < end) {
+        const char* newline = (const char*)memchr(p, '\n', end - p);
+        const char* lineEnd = newline ? newline : end;
+        parseLine(string(p, lineEnd));
+        p = newline ? newline + 1 : end;
+    }
+}
 
-            i.setAssembly(line);
-            myInstructions.push_back(i);
-        }
+// Adds the instructions, labels and errors of the piece of the file
+// parsed by chunk, which follows everything parsed so far
+void ASMParser::append(ASMParser& chunk) {
+    int base = myInstructions.size();
+    myInstructions.insert(myInstructions.end(), chunk.myInstructions.begin(), chunk.myInstructions.end());
+
+    for (unsigned int d = 0; d < chunk.myLabelDefinitions.size(); d++) {
+        LabelDefinition definition = chunk.myLabelDefinitions[d];
+        definition.instruction += base;
+        definition.line += myLineCount;
+        myLabelDefinitions.push_back(definition);
+    }
+    for (unsigned int u = 0; u < chunk.myLabelUses.size(); u++) {
+        LabelUse use = chunk.myLabelUses[u];
+        use.instruction += base;
+        use.line += myLineCount;
+        myLabelUses.push_back(use);
+    }
+    for (unsigned int e = 0; e < chunk.myErrors.size(); e++)
+        addError(chunk.myErrors[e].line + myLineCount, chunk.myErrors[e].message);
+
+    myLineCount += chunk.myLineCount;
+}
+
+// Defines every label, fills in the instructions that refer to labels,
+// and readies the list of Instructions
+void ASMParser::finish() {
+    for (unsigned int d = 0; d < myLabelDefinitions.size(); d++) {
+        LabelDefinition& definition = myLabelDefinitions[d];
+        if (!mySymbols.define(definition.label, definition.instruction))
+            addError(definition.line, "label " + definition.label + " is defined twice");
     }
+    resolveLabels();
+
+    // Errors from different passes are reported in file order
+    stable_sort(myErrors.begin(), myErrors.end(), [](const ParseError& a, const ParseError& b) { return a.line < b.line; });
+    myFormatCorrect = myErrors.empty();
     myIndex = 0;
-    in.close();
+}
+
+// Records that line could not be parsed
+void ASMParser::addError(long long line, string message) {
+    ParseError error;
+    error.line = line;
+    error.message = message;
+    myErrors.push_back(error);
 }
 
 // Iterator that returns the next Instruction in the list of Instructions.
@@ -117,6 +238,10 @@ void ASMParser::getTokens(string line, string& opcode, string* operand, int& num
         i++;
     }
 
+    // An opcode on its own has no last operand to split
+    if (numOperands == 0)
+        return;
+
     idx = operand[numOperands - 1].find('(');
     string::size_type idx2 = operand[numOperands - 1].find(')');
 
@@ -217,13 +342,16 @@ bool ASMParser::getOperands(Instruction& i, Opcode o, string* operand, int opera
     if (imm_p != -1) {
         if (isNumberString(operand[imm_p])) { // does it have a numeric immediate field?
             imm = cvtNumString2Number(operand[imm_p]);
-            if (((imm & 0xFFFF0000) << 1)) // too big a number to fit
+            if (imm < -32768 || imm > 65535) // too big a number to fit in 16 bits
                 return false;
         } else {
             if (opcodes.isIMMLabel(o)) { // Can the operand be a label?
-                // Assign the immediate field an address
-                imm = myLabelAddress;
-                myLabelAddress += 4; // increment the label generator
+                // The label may not be defined yet, so fill it in later
+                LabelUse use;
+                use.instruction = myInstructions.size();
+                use.label = operand[imm_p];
+                use.line = myLineCount;
+                myLabelUses.push_back(use);
             } 
             else // There is an error
                 return false;
@@ -233,4 +361,83 @@ bool ASMParser::getOperands(Instruction& i, Opcode o, string* operand, int opera
     i.setValues(o, rs, rt, rd, imm);
 
     return true;
-}
\ No newline at end of file
+}
+
+// If line starts with a label definition like "loop:", sets label to
+// its name, removes it from line and returns true
+bool ASMParser::splitLabel(string& line, string& label) {
+    unsigned int start = 0;
+    while (start < line.length() && isWhitespace(line.at(start)))
+        start++;
+
+    unsigned int end = start;
+    while (end < line.length() && isLabelChar(line.at(end)))
+        end++;
+
+    // Labels cannot start with a digit, so numbers are never taken for one
+    if (end == start || end == line.length() || line.at(end) != ':' || isDigit(line.at(start)))
+        return false;
+
+    label = line.substr(start, end - start);
+
+    // The instruction after the label keeps its own text
+    end++;
+    while (end < line.length() && isWhitespace(line.at(end)))
+        end++;
+    line = line.substr(end);
+    return true;
+}
+
+// Returns true if line holds nothing but white space and a comment
+bool ASMParser::isBlankLine(string line) {
+    for (unsigned int p = 0; p < line.length(); p++) {
+        if (line.at(p) == '#')
+            return true;
+        if (!isWhitespace(line.at(p)))
+            return false;
+    }
+    return true;
+}
+
+// Fills in the immediate of every instruction that names a label,
+// recording an error for each label that is not defined and each
+// branch that cannot reach its label
+void ASMParser::resolveLabels() {
+    // Older listings name labels without defining any, and have always
+    // been given made up addresses for them. Nothing can be run from those
+    // addresses, and a file with labels of its own has simply misspelled one.
+    bool madeUp = !myRequireLabels && myLabelDefinitions.empty();
+
+    for (unsigned int u = 0; u < myLabelUses.size(); u++) {
+        Instruction& i = myInstructions[myLabelUses[u].instruction];
+        int target;
+        int imm;
+
+        if (!mySymbols.lookup(myLabelUses[u].label, target)) {
+            if (!madeUp) {
+                addError(myLabelUses[u].line, "label " + myLabelUses[u].label + " is never defined");
+                continue;
+            }
+            imm = myLabelAddress;
+            myLabelAddress += 4; // increment the label generator
+        }
+        else if (i.getOpcode() == BEQ) {
+            // Branch offsets count from the instruction after the branch
+            imm = target - (myLabelUses[u].instruction + 1);
+            if (imm < -32768 || imm > 32767) {
+                addError(myLabelUses[u].line, "label " + myLabelUses[u].label + " is out of reach of BEQ");
+                continue;
+            }
+        }
+        else {
+            // Jumps hold the instruction number itself
+            imm = target;
+            if (imm >= (1 << 26)) {
+                addError(myLabelUses[u].line, "label " + myLabelUses[u].label + " is out of reach of J");
+                continue;
+            }
+        }
+
+        i.setValues(i.getOpcode(), i.getRS(), i.getRT(), i.getRD(), imm);
+    }
+}
@@ -4,8 +4,10 @@
 #define __ASMPARSER_H__
 
 #include "Instruction.h"
+#include "ParseError.h"
 #include "OpcodeTable.h"
 #include "RegisterTable.h"
+#include "SymbolTable.h"
 
 #include <fstream>
 #include <vector>
@@ -23,12 +25,23 @@ public:
 
     // Specify a text file containing MIPS assembly instructions. Function
     // checks syntactic correctness of file and creates a list of Instructions.
-    ASMParser(string filename);
+    // With more than one thread the file is split at line ends and the
+    // pieces are parsed at the same time. If requireLabels is true, a label
+    // that is never defined is an error even in a file that defines none.
+    ASMParser(string filename, int numThreads = 1, bool requireLabels = false);
+
+    // Reads MIPS assembly instructions from in, such as standard input.
+    // Function checks syntactic correctness and creates a list of Instructions.
+    // If requireLabels is true, every label used must be defined.
+    ASMParser(istream& in, bool requireLabels = false);
 
     // Returns true if the file specified was syntactically correct. Otherwise,
     // returns false.
     bool isFormatCorrect() { return myFormatCorrect; };
 
+    // Returns every line that could not be parsed, in file order
+    vector<ParseError>& getErrors() { return myErrors; }
+
     // Iterator that returns the next Instruction in the list of Instructions.
     Instruction getNextInstruction();
 
@@ -44,7 +57,65 @@ protected:
 
 private:
 
-    int myLabelAddress; // Used to assign labels addresses
+    // The microbenchmarks time getTokens and decode on their own
+    friend struct BenchmarkAccess;
+
+    int myLabelAddress; // Used to assign labels that are never defined addresses
+    bool myRequireLabels; // true if a label that is never defined is always an error
+
+    // Creates a parser for one piece of a file
+    ASMParser();
+
+    // Checks the syntax of one line and collects its instruction and label
+    void parseLine(string line);
+
+    // Parses each line from begin up to end
+    void parseLines(const char* begin, const char* end);
+
+    // Adds the instructions, labels and errors of the piece of the file
+    // parsed by chunk, which follows everything parsed so far
+    void append(ASMParser& chunk);
+
+    // Defines every label, fills in the instructions that refer to labels,
+    // and readies the list of Instructions
+    void finish();
+
+    // Records that line could not be parsed
+    void addError(long long line, string message);
+
+    // A label definition, entered in the symbol table once the whole
+    // file has been read
+    struct LabelDefinition {
+        string label;
+        int instruction; // the instruction it marks
+        long long line;
+    };
+
+    // An instruction whose immediate is a label, to be filled in once
+    // every label is known
+    struct LabelUse {
+        int instruction;
+        string label;
+        long long line;
+    };
+
+    SymbolTable mySymbols; // instruction number of each label defined
+    vector<LabelDefinition> myLabelDefinitions;
+    vector<LabelUse> myLabelUses;
+    vector<ParseError> myErrors;
+    long long myLineCount; // lines read so far
+
+    // If line starts with a label definition like "loop:", sets label to
+    // its name, removes it from line and returns true
+    bool splitLabel(string& line, string& label);
+
+    // Fills in the immediate of every instruction that names a label,
+    // recording an error for each label that is not defined and each
+    // branch that cannot reach its label
+    void resolveLabels();
+
+    // Returns true if line holds nothing but white space and a comment
+    bool isBlankLine(string line);
 
     // Decomposes a line of assembly code into strings for the opcode field and operands,
     // checking for syntax errors and counting the number of operands.
@@ -63,6 +134,9 @@ private:
     // Returns true if character is an uppercase letter
     bool isAlphaUpper(char c) { return (c >= 'A' && c <= 'Z'); };
 
+    // Returns true if character can appear in a label
+    bool isLabelChar(char c) { return (isAlpha(c) || isDigit(c) || c == '_' || c == '.'); };
+
     // Returns true if character is a lowercase letter
     bool isAlphaLower(char c) { return (c >= 'a' && c <= 'z'); };
 
@@ -0,0 +1,87 @@
+// Palmer Robins
+
+#include "Arena.h"
+
+#include <cstdint>
+#include <cstring>
+
+// The arena containers built on each thread draw from
+static thread_local Arena* currentArena = nullptr;
+
+// Creates an arena that takes memory from the heap blockSize bytes at a time
+Arena::Arena(size_t blockSize) {
+    myBlockSize = blockSize;
+    myBlock = 0;
+    myNext = nullptr;
+    myEnd = nullptr;
+    myUsed = 0;
+}
+
+// Frees every block
+Arena::~Arena() {
+    for (unsigned int b = 0; b < myBlocks.size(); b++)
+        ::operator delete(myBlocks[b]);
+}
+
+// Returns bytes of memory aligned to alignment. Safe to call from
+// several threads at once.
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    if (isLarge(bytes))
+        return ::operator new(bytes);
+
+    lock_guard<mutex> hold(myLock);
+    char* start = (char*)(((uintptr_t)myNext + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (myNext == nullptr || start + bytes > myEnd) {
+        // Move on to the next block, taking a new one once the blocks
+        // kept from earlier runs are used up
+        if (myNext != nullptr)
+            myBlock++;
+        if (myBlock == myBlocks.size())
+            myBlocks.push_back((char*)::operator new(myBlockSize));
+        myNext = myBlocks[myBlock];
+        myEnd = myNext + myBlockSize;
+        start = (char*)(((uintptr_t)myNext + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    myUsed += start + bytes - myNext;
+    myNext = start + bytes;
+    return start;
+}
+
+// Gives back memory from allocate. Only requests that went to the
+// heap are freed; the rest wait for reset.
+void Arena::deallocate(void* p, size_t bytes) {
+    if (isLarge(bytes))
+        ::operator delete(p);
+}
+
+// Returns a copy of the length characters at text, ended by a NUL
+const char* Arena::copy(const char* text, size_t length) {
+    char* result = (char*)allocate(length + 1, 1);
+    memcpy(result, text, length);
+    result[length] = '\0';
+    return result;
+}
+
+// Forgets everything allocated, keeping the blocks for what comes next
+void Arena::reset() {
+    lock_guard<mutex> hold(myLock);
+    myBlock = 0;
+    myNext = myBlocks.empty() ? nullptr : myBlocks[0];
+    myEnd = myBlocks.empty() ? nullptr : myBlocks[0] + myBlockSize;
+    myUsed = 0;
+}
+
+// Returns the arena containers built on this thread draw from, or
+// nullptr if they use the heap
+Arena* Arena::current() {
+    return currentArena;
+}
+
+// Makes arena the one containers built on this thread draw from.
+// Returns the one it replaces.
+Arena* Arena::setCurrent(Arena* arena) {
+    Arena* previous = currentArena;
+    currentArena = arena;
+    return previous;
+}
@@ -0,0 +1,156 @@
+// Palmer Robins
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Arena hands out memory for the objects of one run, such as the
+ * dependences, instruction text and table lines of the pipeline models,
+ * by carving it from large blocks. Nothing is given back one object at a
+ * time; reset forgets everything at once and keeps the blocks for the
+ * next run, and the destructor frees them. Requests too large to share a
+ * block go to the heap as usual.
+ *
+ * A model built while an ArenaScope is open on this thread takes its
+ * memory from that scope's arena for its whole life, so a caller that
+ * runs many models can reset one arena between them. A model built
+ * outside any scope makes an arena of its own. Containers draw from an
+ * arena through ArenaAllocator. The arena must outlive everything
+ * allocated from it.
+ */
+class Arena {
+
+    public:
+
+        static const size_t BLOCK_SIZE = 1 << 20;
+
+        // Creates an arena that takes memory from the heap blockSize bytes at a time
+        Arena(size_t blockSize = BLOCK_SIZE);
+
+        // Frees every block
+        ~Arena();
+
+        // Returns bytes of memory aligned to alignment. Safe to call from
+        // several threads at once.
+        void* allocate(size_t bytes, size_t alignment);
+
+        // Gives back memory from allocate. Only requests that went to the
+        // heap are freed; the rest wait for reset.
+        void deallocate(void* p, size_t bytes);
+
+        // Returns a copy of the length characters at text, ended by a NUL
+        const char* copy(const char* text, size_t length);
+
+        // Forgets everything allocated, keeping the blocks for what comes next
+        void reset();
+
+        // Returns the bytes handed out from blocks since the last reset
+        size_t getBytesUsed() { return myUsed; }
+
+        // Returns the number of blocks taken from the heap
+        size_t getBlockCount() { return myBlocks.size(); }
+
+        // Returns the arena containers built on this thread draw from, or
+        // nullptr if they use the heap
+        static Arena* current();
+
+        // Makes arena the one containers built on this thread draw from.
+        // Returns the one it replaces.
+        static Arena* setCurrent(Arena* arena);
+
+    private:
+
+        Arena(const Arena&);
+        Arena& operator=(const Arena&);
+
+        // Returns true if bytes is large enough to go to the heap instead
+        bool isLarge(size_t bytes) { return bytes > myBlockSize / 8; }
+
+        mutex myLock;
+        size_t myBlockSize;
+        vector<char*> myBlocks;
+        size_t myBlock; // index of the block being carved
+        char* myNext; // first free byte of that block
+        char* myEnd;
+        size_t myUsed;
+};
+
+/**
+ * ArenaScope makes an arena the current one on this thread for as long as
+ * it exists, then restores whichever was current before.
+ */
+class ArenaScope {
+
+    public:
+
+        // Makes arena, which may be nullptr for the heap, current
+        ArenaScope(Arena* arena) { myPrevious = Arena::setCurrent(arena); }
+
+        // Restores the arena that was current before
+        ~ArenaScope() { Arena::setCurrent(myPrevious); }
+
+    private:
+
+        ArenaScope(const ArenaScope&);
+        ArenaScope& operator=(const ArenaScope&);
+
+        Arena* myPrevious;
+};
+
+/**
+ * ArenaAllocator is the standard allocator interface over an arena. A
+ * default constructed one uses the current arena of the thread building
+ * it, and copies keep using the same arena.
+ */
+template <class T>
+class ArenaAllocator {
+
+    public:
+
+        typedef T value_type;
+
+        // Uses the current arena, or the heap if there is none
+        ArenaAllocator() { myArena = Arena::current(); }
+
+        // Uses arena, or the heap if it is nullptr
+        ArenaAllocator(Arena* arena) { myArena = arena; }
+
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U>& other) { myArena = other.getArena(); }
+
+        // Returns room for n objects of type T
+        T* allocate(size_t n) {
+            if (myArena)
+                return (T*)myArena->allocate(n * sizeof(T), alignof(T));
+            return (T*)::operator new(n * sizeof(T));
+        }
+
+        // Gives back room for n objects from allocate
+        void deallocate(T* p, size_t n) {
+            if (myArena)
+                myArena->deallocate(p, n * sizeof(T));
+            else
+                ::operator delete(p);
+        }
+
+        // Returns the arena, or nullptr for the heap
+        Arena* getArena() const { return myArena; }
+
+    private:
+
+        Arena* myArena;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.getArena() == b.getArena(); }
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.getArena() != b.getArena(); }
+
+#endif
@@ -1,63 +1,149 @@
 // Palmer Robins
 
 #include "BinaryParser.h"
+#include "MappedFile.h"
+#include "ParallelScan.h"
+
+#include <memory>
 
 // Specify a text file containing MIPS machine instructions. Function
 // checks syntactic correctness of file and creates a list of Instructions.
-BinaryParser::BinaryParser(string filename) {
+// With more than one thread the file is split at line ends and the
+// pieces are parsed at the same time.
+BinaryParser::BinaryParser(string filename, int numThreads) {
+    myLineCount = 0;
+
+    // A file that cannot be read holds no instructions, and says so
+    MappedFile file(filename);
+    const char* data = (const char*)file.getData();
+    size_t size = data ? file.getSize() : 0;
+    if (!file.isOpen()) {
+        ParseError error;
+        error.line = 1;
+        error.message = "the file could not be read";
+        myErrors.push_back(error);
+    }
 
-    Instruction i;
+    if (numThreads <= 1)
+        parseLines(data, data + size);
+    else {
+        vector<size_t> bounds = splitAtLines(data, size, numThreads);
+        int numChunks = bounds.size() - 1;
+        vector<unique_ptr<BinaryParser> > chunks(numChunks);
+        parallelForChunks(numChunks, numChunks, [&](int chunk, int begin, int end) {
+            chunks[chunk].reset(new BinaryParser());
+            chunks[chunk]->parseLines(data + bounds[chunk], data + bounds[chunk + 1]);
+        });
+        for (int c = 0; c < numChunks; c++)
+            append(*chunks[c]);
+    }
+
+    myFormatCorrect = myErrors.empty();
+    myIndex = 0;
+}
+
+// Reads 32b encodings from in, such as standard input. Function
+// checks syntactic correctness and creates a list of Instructions.
+BinaryParser::BinaryParser(istream& in) {
+    myLineCount = 0;
+
+    //For every instruction in the input
+    string line;
+    while (getline(in, line))
+        parseLine(line);
+
+    // There was a problem reading the input
+    if (in.bad()) {
+        ParseError error;
+        error.line = myLineCount + 1;
+        error.message = "the input could not be read";
+        myErrors.push_back(error);
+    }
+
+    myFormatCorrect = myErrors.empty();
+    myIndex = 0;
+}
+
+// Creates a parser with no instructions, for decoding single words
+BinaryParser::BinaryParser() {
     myFormatCorrect = true;
+    myIndex = 0;
+    myLineCount = 0;
+}
 
-    // Try to open the input file
-    ifstream in;
-    in.open(filename.c_str());
+// Checks the syntax of one line and collects its instruction
+void BinaryParser::parseLine(string line) {
+    Instruction i;
+    ParseError error;
+    error.line = ++myLineCount;
 
-    // There was a problem opening the file
-    if (in.bad())
-        myFormatCorrect = false;
+    if (!checkInstSyntax(line))
+        error.message = "expected 32 bits of 0s and 1s";
+    else if (!decodeLine(line, i))
+        error.message = "not a known instruction";
     else {
-        string line;
-        //For every instruction in the input file
-        while (getline(in, line)) {
-            // Check the syntax of the line
-            if (!checkInstSyntax(line)) {
-                myFormatCorrect = false;
-                break;
-            }
+        // Add it to our vector of instructions
+        myInstructions.push_back(i);
+        return;
+    }
+    myErrors.push_back(error);
+}
 
-            //Get the opcode field and function field
-            string opcode_field = getOpcodeField(line);
-            string func_field = getFuncField(line);
+// Parses each line from begin up to end
+void BinaryParser::parseLines(const char* begin, const char* end) {
+    const char* p = begin;
+    while (p < end) {
+        const char* newline = (const char*)memchr(p, '\n', end - p);
+        const char* lineEnd = newline ? newline : end;
+        parseLine(string(p, lineEnd));
+        p = newline ? newline + 1 : end;
+    }
+}
 
-            // Get the opcode as an enum Opcode & check its validity
-            Opcode opcode = myOpcodes.getOpcode_fromBinary(opcode_field, func_field);
-            if (opcode == UNDEFINED) {
-                myFormatCorrect = false;
-                break;
-            }
+// Adds the instructions and errors of the piece of the file parsed
+// by chunk, which follows everything parsed so far
+void BinaryParser::append(BinaryParser& chunk) {
+    myInstructions.insert(myInstructions.end(), chunk.myInstructions.begin(), chunk.myInstructions.end());
+    for (unsigned int e = 0; e < chunk.myErrors.size(); e++) {
+        myErrors.push_back(chunk.myErrors[e]);
+        myErrors.back().line += myLineCount;
+    }
+    myLineCount += chunk.myLineCount;
+}
 
-            // Decode the line
-            bool success = decode(i, opcode, line);
+// Decodes a 32 bit instruction word into i, with its assembly string.
+// Returns false if the word is not a known instruction.
+bool BinaryParser::decodeWord(uint32_t word, Instruction& i) {
+    string line(ENCODED_INST_LENGTH, '0');
+    for (int bit = 0; bit < ENCODED_INST_LENGTH; bit++)
+        if (word & (1u << (ENCODED_INST_LENGTH - 1 - bit)))
+            line[bit] = '1';
+    return decodeLine(line, i);
+}
 
-            // Did the decoding process work correctly
-            if (!success) {
-                myFormatCorrect = false;
-                break;
-            }
+// Decodes one line of 32 '0' and '1' characters into i, with its
+// assembly string. Returns false if the line is not a known instruction.
+bool BinaryParser::decodeLine(string line, Instruction& i) {
+    // Check the syntax of the line
+    if (!checkInstSyntax(line))
+        return false;
 
-            // Create MIPS assembly string
-            string assemblyInstruction = createAssemblyCode(i);
+    //Get the opcode field and function field
+    string opcode_field = getOpcodeField(line);
+    string func_field = getFuncField(line);
 
-            // Set the assembly string into the instruction instance
-            i.setAssembly(assemblyInstruction);
+    // Get the opcode as an enum Opcode & check its validity
+    Opcode opcode = myOpcodes.getOpcode_fromBinary(opcode_field, func_field);
+    if (opcode == UNDEFINED)
+        return false;
 
-            // Add it to our vector of instructions
-            myInstructions.push_back(i);
-        }
-    }
-    in.close();
-    myIndex = 0;
+    // Decode the line, and check that the decoding process worked correctly
+    if (!decode(i, opcode, line))
+        return false;
+
+    // Create MIPS assembly string and set it into the instruction instance
+    i.setAssembly(createAssemblyCode(i));
+    return true;
 }
 
 // This function checks the syntax of a binary MIPS instruction
@@ -161,7 +247,7 @@ bool BinaryParser::decode(Instruction& i, Opcode opcode, string& line) {
 // print the assembly representation.
 // Fields stored in an instruction instance
 bool BinaryParser::decodeRType(Instruction& i, Opcode opcode, string& lineWithoutOpcode) {
-    Register rd, rs, rt = -1;
+    Register rd = -1, rs = -1, rt = -1;
     string imm = "";
     int imm_r = -1;
 
@@ -210,7 +296,7 @@ bool BinaryParser::decodeRType(Instruction& i, Opcode opcode, string& lineWithou
 // Fields stored in an instruction instance
 bool BinaryParser::decodeIType(Instruction& i, Opcode opcode, string& lineWithoutOpcode) {
     string imm;
-    int rt, rs, rd = -1;
+    int rt = -1, rs = -1, rd = -1;
     int imm_r = 0;
 
     // No rd register in ITYPE commands
@@ -265,7 +351,9 @@ bool BinaryParser::decodeJType(Instruction& i, Opcode opcode, string& lineWithou
             imm += lineWithoutOpcode.at(pos);
             pos++;
         }
-        imm_r = stoi(imm, nullptr, 2);
+        // Jumps go to a word address in the text segment, kept as the
+        // instruction number there like a J parsed from assembly
+        imm_r = stoi(imm, nullptr, 2) - (int)(TEXT_BASE >> 2);
     }
 
     i.setValues(opcode, rs, rt, rd, imm_r);
@@ -401,8 +489,7 @@ string BinaryParser::writeJTypeDecoded(Instruction i) {
     assembly << myOpcodes.getOpcodeName(opcode) << " ";
 
     if (myOpcodes.IMMposition(opcode) != -1) {
-        int imm = i.getImmediate();
-        imm *= 4;
+        uint32_t imm = TEXT_BASE + 4 * (uint32_t)i.getImmediate();
 
         // Convert integer representing address to hexadecimal
         assembly << "0x" << hex << imm;
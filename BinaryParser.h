@@ -4,9 +4,11 @@
 #define __BINARYPARSER_H__
 
 #include "Instruction.h"
+#include "ParseError.h"
 #include "OpcodeTable.h"
 #include "RegisterTable.h"
 
+#include <stdint.h>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -25,17 +27,36 @@ public:
 
     // Specify a text file containing 32b encodings. Function
     // checks syntactic correctness of file and creates a list of Instructions.
-    BinaryParser(string filename);
+    // With more than one thread the file is split at line ends and the
+    // pieces are parsed at the same time.
+    BinaryParser(string filename, int numThreads = 1);
+
+    // Reads 32b encodings from in, such as standard input. Function
+    // checks syntactic correctness and creates a list of Instructions.
+    BinaryParser(istream& in);
+
+    // Creates a parser with no instructions, for decoding single words
+    BinaryParser();
 
     // Returns true if the file specified was syntactically correct. Otherwise,
     // returns false.
     bool isFormatCorrect() { return myFormatCorrect; };
 
+    // Returns every line that could not be parsed, in file order
+    vector<ParseError>& getErrors() { return myErrors; }
+
     // Iterator that returns the next Instruction in the list of Instructions.
     Instruction getNextInstruction();
 
+    // Decodes a 32 bit instruction word into i, with its assembly string.
+    // Returns false if the word is not a known instruction.
+    bool decodeWord(uint32_t word, Instruction& i);
+
 private:
 
+    // The microbenchmarks time getTokens and decode on their own
+    friend struct BenchmarkAccess;
+
     vector<Instruction> myInstructions; // list of Instructions
     
     int myIndex; // iterator index
@@ -48,6 +69,23 @@ private:
 
     OpcodeTable myOpcodes; // encodings of opcodes
 
+    vector<ParseError> myErrors;
+    long long myLineCount; // lines read so far
+
+    // Checks the syntax of one line and collects its instruction
+    void parseLine(string line);
+
+    // Parses each line from begin up to end
+    void parseLines(const char* begin, const char* end);
+
+    // Adds the instructions and errors of the piece of the file parsed
+    // by chunk, which follows everything parsed so far
+    void append(BinaryParser& chunk);
+
+    // Decodes one line of 32 '0' and '1' characters into i, with its
+    // assembly string. Returns false if the line is not a known instruction.
+    bool decodeLine(string line, Instruction& i);
+
     // This function checks the syntax of a binary MIPS instruction
     // Receives a string representing a single instruction
     // Returns a boolean which is true if syntax is correct
@@ -0,0 +1,119 @@
+// Palmer Robins
+
+#include "BlockCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static const char BLOCK_CACHE_MAGIC[8] = "PIPEBLK";
+static const uint32_t BLOCK_CACHE_VERSION = 4;
+
+// Creates an empty cache
+BlockTimingCache::BlockTimingCache() {
+    myHits = 0;
+    myMisses = 0;
+}
+
+// Copies the cycles of the block with key and encoding into cycles,
+// which must have room for length values. Returns false if it is
+// not known.
+bool BlockTimingCache::lookup(uint64_t key, const vector<uint64_t>& encoding, int* cycles, int length) {
+    lock_guard<mutex> guard(myLock);
+    unordered_map<uint64_t, Block>::iterator it = myBlocks.find(key);
+
+    // A different encoding under the same key is another block
+    if (it == myBlocks.end() || it->second.encoding != encoding || (int)it->second.cycles.size() != length) {
+        myMisses++;
+        return false;
+    }
+    for (int k = 0; k < length; k++)
+        cycles[k] = it->second.cycles[k];
+    myHits++;
+    return true;
+}
+
+// Remembers the cycles of the block with key and encoding
+void BlockTimingCache::insert(uint64_t key, const vector<uint64_t>& encoding, const int* cycles, int length) {
+    lock_guard<mutex> guard(myLock);
+    Block& block = myBlocks[key];
+    block.encoding = encoding;
+    block.cycles.assign(cycles, cycles + length);
+}
+
+// Returns the number of blocks known
+size_t BlockTimingCache::size() {
+    lock_guard<mutex> guard(myLock);
+    return myBlocks.size();
+}
+
+// Adds the blocks saved in filename. Returns false if the file is
+// missing or not a block cache.
+//
+// The file is the magic, the version and the number of blocks, then for
+// each block its key, the length of its encoding, the encoding, its
+// length and the cycles of its instructions.
+bool BlockTimingCache::load(string filename) {
+    ifstream in(filename.c_str(), ios::binary);
+    char magic[8];
+    uint32_t version;
+    uint64_t count;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, BLOCK_CACHE_MAGIC, sizeof(magic)) != 0)
+        return false;
+    if (!in.read((char*)&version, sizeof(version)) || version != BLOCK_CACHE_VERSION)
+        return false;
+    if (!in.read((char*)&count, sizeof(count)))
+        return false;
+
+    lock_guard<mutex> guard(myLock);
+    for (uint64_t b = 0; b < count; b++) {
+        uint64_t key;
+        uint32_t words;
+        if (!in.read((char*)&key, sizeof(key)) || !in.read((char*)&words, sizeof(words)) || words > MAX_ENCODING_LENGTH)
+            return false;
+        Block block;
+        block.encoding.resize(words);
+        if (!in.read((char*)block.encoding.data(), words * sizeof(uint64_t)))
+            return false;
+        uint32_t length;
+        if (!in.read((char*)&length, sizeof(length)) || length > MAX_BLOCK_LENGTH)
+            return false;
+        block.cycles.resize(length);
+        if (!in.read((char*)block.cycles.data(), length * sizeof(int32_t)))
+            return false;
+        myBlocks[key].encoding.swap(block.encoding);
+        myBlocks[key].cycles.swap(block.cycles);
+    }
+    return true;
+}
+
+// Writes every block known to filename. Returns false if it could
+// not be written.
+bool BlockTimingCache::save(string filename) {
+    lock_guard<mutex> guard(myLock);
+
+    // Write somewhere else first, so a run loading the file meanwhile
+    // never sees half of it
+    string temporary = filename + ".tmp";
+    ofstream out(temporary.c_str(), ios::binary | ios::trunc);
+    uint64_t count = myBlocks.size();
+    out.write(BLOCK_CACHE_MAGIC, sizeof(BLOCK_CACHE_MAGIC));
+    out.write((const char*)&BLOCK_CACHE_VERSION, sizeof(BLOCK_CACHE_VERSION));
+    out.write((const char*)&count, sizeof(count));
+    for (unordered_map<uint64_t, Block>::iterator it = myBlocks.begin(); it != myBlocks.end(); it++) {
+        uint32_t words = it->second.encoding.size();
+        uint32_t length = it->second.cycles.size();
+        out.write((const char*)&it->first, sizeof(it->first));
+        out.write((const char*)&words, sizeof(words));
+        out.write((const char*)it->second.encoding.data(), words * sizeof(uint64_t));
+        out.write((const char*)&length, sizeof(length));
+        out.write((const char*)it->second.cycles.data(), length * sizeof(int32_t));
+    }
+    out.close();
+
+    if (out.fail() || rename(temporary.c_str(), filename.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+// Palmer Robins
+
+#ifndef __BLOCKCACHE_H__
+#define __BLOCKCACHE_H__
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * BlockTimingCache remembers how the stall and forwarding models time a
+ * basic block. A block's encoding is the model, the registers and opcodes
+ * of its instructions, the cycles lost to control hazards inside it and
+ * the instructions before it its hazards can reach, which is all those
+ * models can see. Blocks are found by a hash of the encoding, and the
+ * encoding is kept and compared, so two blocks with the same hash are
+ * never mistaken for each other. The value is the cycles each
+ * instruction of the block adds beyond one. The cache can be shared by
+ * models running on several threads, and saved to a file to be used
+ * again by later runs.
+ *
+ * The cache is experimental and only used when asked for with
+ * --block-cache. Timing a block again costs about as much as hashing and
+ * comparing its encoding, so no input has yet been found where looking
+ * blocks up is clearly faster.
+ */
+class BlockTimingCache {
+
+    public:
+
+        // Longest block timed as one entry
+        static const int MAX_BLOCK_LENGTH = 64;
+
+        // Creates an empty cache
+        BlockTimingCache();
+
+        // Copies the cycles of the block with key and encoding into cycles,
+        // which must have room for length values. Returns false if it is
+        // not known.
+        bool lookup(uint64_t key, const vector<uint64_t>& encoding, int* cycles, int length);
+
+        // Remembers the cycles of the block with key and encoding
+        void insert(uint64_t key, const vector<uint64_t>& encoding, const int* cycles, int length);
+
+        // Adds the blocks saved in filename. Returns false if the file is
+        // missing or not a block cache.
+        bool load(string filename);
+
+        // Writes every block known to filename. Returns false if it could
+        // not be written.
+        bool save(string filename);
+
+        // Returns the number of blocks known
+        size_t size();
+
+        long long getHits() { return myHits; }
+        long long getMisses() { return myMisses; }
+
+    private:
+
+        // A block as it was timed
+        struct Block {
+            vector<uint64_t> encoding;
+            vector<int32_t> cycles;
+        };
+
+        // Longest encoding a saved block may have
+        static const uint32_t MAX_ENCODING_LENGTH = 4096;
+
+        mutex myLock; // models on different threads share one cache
+        unordered_map<uint64_t, Block> myBlocks;
+        long long myHits;
+        long long myMisses;
+};
+
+#endif
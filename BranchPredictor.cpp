@@ -0,0 +1,153 @@
+// Palmer Robins
+
+#include "BranchPredictor.h"
+
+// Creates a predictor with empty statistics
+BranchPredictor::BranchPredictor() {
+    myBranches = 0;
+    myMispredictions = 0;
+}
+
+// Given a predictor name (static, btfn, bimodal, gshare or btb), returns a
+// new predictor of that kind, or nullptr if the name is not known
+BranchPredictor* BranchPredictor::create(string name) {
+    if (name == "static")
+        return new StaticPredictor();
+    if (name == "btfn")
+        return new BTFNPredictor();
+    if (name == "bimodal")
+        return new BimodalPredictor();
+    if (name == "gshare")
+        return new GsharePredictor();
+    if (name == "btb")
+        return new BTBPredictor();
+    return nullptr;
+}
+
+// Predicts and trains on one branch, and returns the cycles it costs
+int BranchPredictor::resolve(uint32_t pc, Opcode op, bool taken, uint32_t target, int flushPenalty) {
+    Prediction p = predict(pc, op, target);
+    update(pc, op, taken, target);
+    myBranches++;
+
+    if (p.taken != taken) {
+        myMispredictions++;
+        return (op == J) ? 1 : flushPenalty;
+    }
+    if (taken && !p.haveTarget)
+        return 1;
+    return 0;
+}
+
+// Moves counter i one step toward taken or not taken
+void BranchPredictor::trainCounter(vector<uint8_t>& table, uint32_t i, bool taken) {
+    int counter = getCounter(table, i);
+    if (taken && counter < 3)
+        counter++;
+    else if (!taken && counter > 0)
+        counter--;
+
+    int shift = (i & 3) * 2;
+    table[i >> 2] = (table[i >> 2] & ~(3 << shift)) | (counter << shift);
+}
+
+// Given a copy of this predictor, empties its statistics and returns it
+BranchPredictor* BranchPredictor::withoutStats(BranchPredictor* copy) {
+    copy->myBranches = 0;
+    copy->myMispredictions = 0;
+    return copy;
+}
+
+// Predicts every BEQ not taken and every J taken; targets are found in decode
+Prediction StaticPredictor::predict(uint32_t pc, Opcode op, uint32_t target) {
+    Prediction p;
+    p.taken = (op == J);
+    p.haveTarget = false;
+    return p;
+}
+
+// Backward taken, forward not taken. Jumps are always taken.
+Prediction BTFNPredictor::predict(uint32_t pc, Opcode op, uint32_t target) {
+    Prediction p;
+    p.taken = (op == J) || target <= pc;
+    p.haveTarget = false;
+    return p;
+}
+
+// Creates a table of 2^indexBits counters, all weakly not taken
+BimodalPredictor::BimodalPredictor(int indexBits) {
+    myMask = (1u << indexBits) - 1;
+    myCounters.assign(((1u << indexBits) + 3) / 4, 0x55);
+}
+
+// Jumps are always taken; BEQ follows its counter
+Prediction BimodalPredictor::predict(uint32_t pc, Opcode op, uint32_t target) {
+    Prediction p;
+    p.taken = (op == J) || getCounter(myCounters, pc & myMask) >= 2;
+    p.haveTarget = false;
+    return p;
+}
+
+// Trains the counter for a BEQ
+void BimodalPredictor::update(uint32_t pc, Opcode op, bool taken, uint32_t target) {
+    if (op == BEQ)
+        trainCounter(myCounters, pc & myMask, taken);
+}
+
+// Creates a table of 2^indexBits counters and a history of as many bits
+GsharePredictor::GsharePredictor(int indexBits) {
+    myMask = (1u << indexBits) - 1;
+    myHistory = 0;
+    myCounters.assign(((1u << indexBits) + 3) / 4, 0x55);
+}
+
+// Jumps are always taken; BEQ follows the counter picked by its history
+Prediction GsharePredictor::predict(uint32_t pc, Opcode op, uint32_t target) {
+    Prediction p;
+    p.taken = (op == J) || getCounter(myCounters, (pc ^ myHistory) & myMask) >= 2;
+    p.haveTarget = false;
+    return p;
+}
+
+// Trains the counter for a BEQ and shifts its outcome into the history
+void GsharePredictor::update(uint32_t pc, Opcode op, bool taken, uint32_t target) {
+    if (op != BEQ)
+        return;
+    trainCounter(myCounters, (pc ^ myHistory) & myMask, taken);
+    myHistory = ((myHistory << 1) | (taken ? 1 : 0)) & myMask;
+}
+
+// Creates a buffer with 2^indexBits entries
+BTBPredictor::BTBPredictor(int indexBits) {
+    myMask = (1u << indexBits) - 1;
+    myTags.assign(1u << indexBits, 0);
+    myCounters.assign(((1u << indexBits) + 3) / 4, 0xAA);
+}
+
+// A hit supplies the target and its counter gives the direction
+Prediction BTBPredictor::predict(uint32_t pc, Opcode op, uint32_t target) {
+    uint32_t index = pc & myMask;
+    Prediction p;
+    p.taken = false;
+    p.haveTarget = false;
+
+    if (myTags[index] == pc + 1) {
+        p.taken = getCounter(myCounters, index) >= 2;
+        p.haveTarget = p.taken;
+    }
+    return p;
+}
+
+// Taken branches are entered into the buffer, and hits train their counter
+void BTBPredictor::update(uint32_t pc, Opcode op, bool taken, uint32_t target) {
+    uint32_t index = pc & myMask;
+
+    if (myTags[index] == pc + 1)
+        trainCounter(myCounters, index, taken);
+    else if (taken) {
+        myTags[index] = pc + 1;
+        // A new entry starts out weakly taken
+        int shift = (index & 3) * 2;
+        myCounters[index >> 2] = (myCounters[index >> 2] & ~(3 << shift)) | (2 << shift);
+    }
+}
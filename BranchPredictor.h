@@ -0,0 +1,147 @@
+// Palmer Robins
+
+#ifndef __BRANCHPREDICTOR_H__
+#define __BRANCHPREDICTOR_H__
+
+#include "OpcodeTable.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// What a predictor expects of a branch when it is fetched
+struct Prediction {
+    bool taken; // the branch is expected to redirect fetch
+    bool haveTarget; // the target is known at fetch, so a taken branch costs nothing
+};
+
+/**
+ * BranchPredictor is the base class for the BEQ/J predictors. Subclasses
+ * provide predict and update; resolve charges the cycles a branch costs the
+ * pipeline and keeps accuracy statistics.
+ *
+ * Costs: a correctly predicted branch costs nothing, unless it is taken and its
+ * target is only known after decode (one cycle). A mispredicted J costs one
+ * cycle, since jumps are resolved in decode, and a mispredicted BEQ costs the
+ * flush penalty.
+ */
+class BranchPredictor {
+
+    public:
+
+        // Creates a predictor with empty statistics
+        BranchPredictor();
+
+        // Virtual deconstructor
+        virtual ~BranchPredictor() {}
+
+        // Given a predictor name (static, btfn, bimodal, gshare or btb), returns a
+        // new predictor of that kind, or nullptr if the name is not known
+        static BranchPredictor* create(string name);
+
+        // Returns the name the predictor was created with
+        virtual string getName() = 0;
+
+        // Returns a new predictor in the same state, with empty statistics
+        virtual BranchPredictor* clone() = 0;
+
+        // Given a branch's instruction number, opcode and target, returns the prediction
+        virtual Prediction predict(uint32_t pc, Opcode op, uint32_t target) = 0;
+
+        // Trains the predictor with a branch's actual outcome
+        virtual void update(uint32_t pc, Opcode op, bool taken, uint32_t target) = 0;
+
+        // Predicts and trains on one branch, and returns the cycles it costs
+        int resolve(uint32_t pc, Opcode op, bool taken, uint32_t target, int flushPenalty);
+
+        // Returns the number of branches resolved
+        long long getBranches() { return myBranches; }
+
+        // Returns the number of mispredicted branches
+        long long getMispredictions() { return myMispredictions; }
+
+        // Empties the statistics, so they count only branches resolved from now on
+        void clearStats() { myBranches = myMispredictions = 0; }
+
+    protected:
+
+        // Given a table of 2 bit counters packed four to a byte, returns counter i
+        static int getCounter(vector<uint8_t>& table, uint32_t i) { return (table[i >> 2] >> ((i & 3) * 2)) & 3; }
+
+        // Moves counter i one step toward taken or not taken
+        static void trainCounter(vector<uint8_t>& table, uint32_t i, bool taken);
+
+        // Given a copy of this predictor, empties its statistics and returns it
+        static BranchPredictor* withoutStats(BranchPredictor* copy);
+
+        long long myBranches;
+        long long myMispredictions;
+};
+
+// Predicts every BEQ not taken and every J taken; targets are found in decode
+class StaticPredictor : public BranchPredictor {
+    public:
+        string getName() { return "static"; }
+        BranchPredictor* clone() { return withoutStats(new StaticPredictor(*this)); }
+        Prediction predict(uint32_t pc, Opcode op, uint32_t target);
+        void update(uint32_t pc, Opcode op, bool taken, uint32_t target) {}
+};
+
+// Backward taken, forward not taken
+class BTFNPredictor : public BranchPredictor {
+    public:
+        string getName() { return "btfn"; }
+        BranchPredictor* clone() { return withoutStats(new BTFNPredictor(*this)); }
+        Prediction predict(uint32_t pc, Opcode op, uint32_t target);
+        void update(uint32_t pc, Opcode op, bool taken, uint32_t target) {}
+};
+
+// A table of 2 bit saturating counters indexed by the branch's address
+class BimodalPredictor : public BranchPredictor {
+    public:
+        // Creates a table of 2^indexBits counters, all weakly not taken
+        BimodalPredictor(int indexBits = 12);
+        string getName() { return "bimodal"; }
+        BranchPredictor* clone() { return withoutStats(new BimodalPredictor(*this)); }
+        Prediction predict(uint32_t pc, Opcode op, uint32_t target);
+        void update(uint32_t pc, Opcode op, bool taken, uint32_t target);
+    private:
+        vector<uint8_t> myCounters;
+        uint32_t myMask;
+};
+
+// 2 bit counters indexed by the branch's address xor the global history
+class GsharePredictor : public BranchPredictor {
+    public:
+        // Creates a table of 2^indexBits counters and a history of as many bits
+        GsharePredictor(int indexBits = 12);
+        string getName() { return "gshare"; }
+        BranchPredictor* clone() { return withoutStats(new GsharePredictor(*this)); }
+        Prediction predict(uint32_t pc, Opcode op, uint32_t target);
+        void update(uint32_t pc, Opcode op, bool taken, uint32_t target);
+    private:
+        vector<uint8_t> myCounters;
+        uint32_t myHistory;
+        uint32_t myMask;
+};
+
+// A small direct mapped branch target buffer. A hit supplies the target at fetch
+// and its counter gives the direction; a miss is predicted not taken. A branch's
+// target never changes, so an entry only needs the branch's address.
+class BTBPredictor : public BranchPredictor {
+    public:
+        // Creates a buffer with 2^indexBits entries
+        BTBPredictor(int indexBits = 6);
+        string getName() { return "btb"; }
+        BranchPredictor* clone() { return withoutStats(new BTBPredictor(*this)); }
+        Prediction predict(uint32_t pc, Opcode op, uint32_t target);
+        void update(uint32_t pc, Opcode op, bool taken, uint32_t target);
+    private:
+        vector<uint32_t> myTags; // branch address + 1 in each entry, 0 when empty
+        vector<uint8_t> myCounters;
+        uint32_t myMask;
+};
+
+#endif
@@ -0,0 +1,317 @@
+// Palmer Robins
+
+#include "DataCache.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#else
+#define HAVE_SSE2 0
+#endif
+
+// Given a power of two, returns its log2, or -1 if n is not a power of two
+static int log2Exact(int n) {
+    if (n <= 0 || (n & (n - 1)) != 0)
+        return -1;
+    int bits = 0;
+    while ((1 << bits) < n)
+        bits++;
+    return bits;
+}
+
+#if HAVE_SSE2 && defined(__GNUC__)
+// Compares eight tags at once. Returns a bit per matching way.
+__attribute__((target("avx2")))
+static int matchEightAVX2(const uint32_t* tags, uint32_t key) {
+    __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)tags), _mm256_set1_epi32(key));
+    return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+}
+
+static bool haveAVX2() {
+    static const bool have = __builtin_cpu_supports("avx2");
+    return have;
+}
+#endif
+
+// Creates an empty cache with the given shape and policies
+CacheLevel::CacheLevel(CacheConfig config, ReplacementPolicy replacement, WritePolicy writes) {
+    myConfig = config;
+    myReplacement = replacement;
+    myWrites = writes;
+    hits = misses = writebacks = 0;
+
+    int sets = config.size / (config.ways * config.lineSize);
+    myOffsetBits = log2Exact(config.lineSize);
+    myIndexBits = log2Exact(sets);
+    mySetMask = sets - 1;
+    myStride = (config.ways + 3) & ~3;
+
+    myTags.assign(sets * myStride, 0);
+    myDirty.assign(sets * myStride, 0);
+    myTreeBits.assign(sets, 0);
+    myAges.assign(sets * myStride, 0);
+    for (int s = 0; s < sets; s++)
+        for (int w = 0; w < config.ways; w++)
+            myAges[s * myStride + w] = w;
+}
+
+// Looks up address, filling its line on a miss. Returns true on a hit.
+// If a dirty line had to be written back, evicted is set to true and
+// victim to the line's address.
+bool CacheLevel::access(uint32_t address, bool isWrite, bool& evicted, uint32_t& victim) {
+    uint32_t set = (address >> myOffsetBits) & mySetMask;
+    uint32_t tag = address >> (myOffsetBits + myIndexBits);
+    uint32_t base = set * myStride;
+    evicted = false;
+
+    int way = findWay(set, tag);
+    bool hit = (way >= 0);
+    if (hit)
+        hits++;
+    else {
+        misses++;
+        way = findVictim(set);
+        if (myDirty[base + way]) {
+            evicted = true;
+            writebacks++;
+            uint32_t oldTag = myTags[base + way] - 1;
+            victim = ((oldTag << myIndexBits) | set) << myOffsetBits;
+        }
+        myTags[base + way] = tag + 1;
+        myDirty[base + way] = 0;
+    }
+
+    if (isWrite && myWrites == WRITE_BACK)
+        myDirty[base + way] = 1;
+    touch(set, way);
+    return hit;
+}
+
+// Given a set and a tag, returns the way holding the tag, or -1
+int CacheLevel::findWay(uint32_t set, uint32_t tag) {
+    const uint32_t* tags = &myTags[set * myStride];
+    uint32_t key = tag + 1;
+
+#if HAVE_SSE2
+#if defined(__GNUC__)
+    if (myStride == 8 && haveAVX2()) {
+        int mask = matchEightAVX2(tags, key);
+        return mask ? __builtin_ctz(mask) : -1;
+    }
+#endif
+    __m128i wanted = _mm_set1_epi32(key);
+    for (int w = 0; w < myStride; w += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(tags + w)), wanted);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (mask)
+            return w + __builtin_ctz(mask);
+    }
+    return -1;
+#else
+    for (int w = 0; w < myConfig.ways; w++)
+        if (tags[w] == key)
+            return w;
+    return -1;
+#endif
+}
+
+// Given a set, returns the way to fill next
+int CacheLevel::findVictim(uint32_t set) {
+    uint32_t base = set * myStride;
+
+    // Fill an empty way first
+    for (int w = 0; w < myConfig.ways; w++)
+        if (myTags[base + w] == 0)
+            return w;
+
+    if (myReplacement == PLRU) {
+        // Follow the tree bits, which point away from recent uses
+        int node = 1;
+        while (node < myConfig.ways)
+            node = 2 * node + ((myTreeBits[set] >> node) & 1);
+        return node - myConfig.ways;
+    }
+
+    int oldest = 0;
+    for (int w = 1; w < myConfig.ways; w++)
+        if (myAges[base + w] > myAges[base + oldest])
+            oldest = w;
+    return oldest;
+}
+
+// Records a use of way in set for the replacement policy
+void CacheLevel::touch(uint32_t set, int way) {
+    if (myReplacement == PLRU) {
+        // Point every node on the path to way toward the other half
+        int node = way + myConfig.ways;
+        while (node > 1) {
+            int parent = node / 2;
+            if (node & 1)
+                myTreeBits[set] &= ~(1u << parent);
+            else
+                myTreeBits[set] |= (1u << parent);
+            node = parent;
+        }
+        return;
+    }
+
+    uint32_t base = set * myStride;
+    uint8_t age = myAges[base + way];
+    for (int w = 0; w < myConfig.ways; w++)
+        if (myAges[base + w] < age)
+            myAges[base + w]++;
+    myAges[base + way] = 0;
+}
+
+// Creates the hierarchy. l2.size may be 0 for no L2.
+DataCache::DataCache(CacheConfig l1, CacheConfig l2, int memoryLatency, ReplacementPolicy replacement, WritePolicy writes) {
+    myL1 = new CacheLevel(l1, replacement, writes);
+    myL2 = (l2.size > 0) ? new CacheLevel(l2, replacement, writes) : nullptr;
+    myMemoryLatency = memoryLatency;
+    myWrites = writes;
+    myMemoryWrites = 0;
+}
+
+// Frees the cache levels
+DataCache::~DataCache() {
+    delete myL1;
+    delete myL2;
+}
+
+// Returns a new cache holding the same lines, with empty statistics
+DataCache* DataCache::clone() {
+    DataCache* copy = new DataCache(*this);
+    copy->myL1 = new CacheLevel(*myL1);
+    copy->myL1->clearStats();
+    copy->myL2 = nullptr;
+    if (myL2) {
+        copy->myL2 = new CacheLevel(*myL2);
+        copy->myL2->clearStats();
+    }
+    copy->myMemoryWrites = 0;
+    return copy;
+}
+
+// Accesses address and returns the cycles it takes beyond the pipeline's
+// own load timing. missed is set to true if the access missed in L1.
+int DataCache::access(uint32_t address, bool isWrite, bool& missed) {
+    bool evicted, l2Evicted;
+    uint32_t victim, l2Victim;
+    bool hit = myL1->access(address, isWrite, evicted, victim);
+    missed = !hit;
+
+    // Written data goes down a level on every write when writing through, or when
+    // a dirty line leaves when writing back. Those writes are buffered, so they
+    // cost the pipeline no cycles.
+    if (myWrites == WRITE_THROUGH && isWrite) {
+        if (myL2)
+            myL2->access(address, true, l2Evicted, l2Victim);
+        myMemoryWrites++;
+    }
+    else if (evicted) {
+        l2Evicted = false;
+        if (myL2)
+            myL2->access(victim, true, l2Evicted, l2Victim);
+        if (!myL2 || l2Evicted)
+            myMemoryWrites++;
+    }
+
+    if (hit)
+        return myL1->getLatency();
+    if (myL2) {
+        if (myL2->access(address, false, l2Evicted, l2Victim))
+            return myL2->getLatency();
+        if (l2Evicted)
+            myMemoryWrites++;
+    }
+    return myMemoryLatency;
+}
+
+// Prints hit and miss counts for every level
+void DataCache::printStats() {
+    cout << "L1 data cache: " << myL1->hits << " hits, " << myL1->misses << " misses, "
+         << myL1->writebacks << " writebacks" << endl;
+    if (myL2)
+        cout << "L2 cache: " << myL2->hits << " hits, " << myL2->misses << " misses, "
+             << myL2->writebacks << " writebacks" << endl;
+    cout << "Memory writes: " << myMemoryWrites << endl;
+}
+
+// Creates numMSHRs empty registers
+MissTracker::MissTracker(int numMSHRs) {
+    myCapacity = (numMSHRs > 0) ? numMSHRs : 1;
+}
+
+// A miss to line wants to start on cycle start and takes extra cycles.
+// Waits for a free register if needed, moving start later, and returns
+// the cycle the data arrives.
+long long MissTracker::issue(uint32_t line, long long& start, int extra) {
+    // Free the registers whose data has arrived
+    for (unsigned int m = 0; m < myLines.size(); ) {
+        if (myFills[m] <= start) {
+            myLines[m] = myLines.back();
+            myFills[m] = myFills.back();
+            myLines.pop_back();
+            myFills.pop_back();
+        }
+        else
+            m++;
+    }
+
+    // A miss to a line already on its way waits for that fill
+    for (unsigned int m = 0; m < myLines.size(); m++)
+        if (myLines[m] == line)
+            return myFills[m];
+
+    // With every register busy, wait for the first one to finish
+    if ((int)myLines.size() >= myCapacity) {
+        unsigned int first = 0;
+        for (unsigned int m = 1; m < myLines.size(); m++)
+            if (myFills[m] < myFills[first])
+                first = m;
+        start = myFills[first];
+        myLines[first] = myLines.back();
+        myFills[first] = myFills.back();
+        myLines.pop_back();
+        myFills.pop_back();
+    }
+
+    myLines.push_back(line);
+    myFills.push_back(start + extra);
+    return start + extra;
+}
+
+// Given a string like "32768:4:32:0" (size, ways, line size, latency),
+// fills config and returns true if it describes a valid cache
+bool parseCacheConfig(string text, CacheConfig& config) {
+    int fields[4];
+    int numFields = 0;
+    size_t begin = 0;
+    while (numFields < 4) {
+        size_t end = text.find(':', begin);
+        string field = text.substr(begin, (end == string::npos) ? string::npos : end - begin);
+        if (field.empty() || field.find_first_not_of("0123456789") != string::npos || field.size() > 9)
+            return false;
+        fields[numFields++] = atoi(field.c_str());
+        if (end == string::npos)
+            break;
+        begin = end + 1;
+    }
+    if (numFields != 4 || text.find(':', begin) != string::npos)
+        return false;
+
+    config.size = fields[0];
+    config.ways = fields[1];
+    config.lineSize = fields[2];
+    config.latency = fields[3];
+
+    // Sets and line size must be powers of two, and PLRU needs a power of two ways
+    if (config.ways < 1 || config.ways > 32 || log2Exact(config.ways) < 0 || log2Exact(config.lineSize) < 2)
+        return false;
+    if (config.size % (config.ways * config.lineSize) != 0)
+        return false;
+    return log2Exact(config.size / (config.ways * config.lineSize)) >= 0;
+}
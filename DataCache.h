@@ -0,0 +1,164 @@
+// Palmer Robins
+
+#ifndef __DATACACHE_H__
+#define __DATACACHE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// How a set picks the line to evict
+enum ReplacementPolicy {
+    LRU, // true least recently used, from per-line ages
+    PLRU // tree pseudo-LRU, one bit per internal node
+};
+
+// When written data reaches the next level
+enum WritePolicy {
+    WRITE_BACK, // when a dirty line is evicted
+    WRITE_THROUGH // on every write
+};
+
+// The shape and cost of one cache level
+struct CacheConfig {
+    int size; // bytes of data, 0 when the level is not present
+    int ways; // lines per set
+    int lineSize; // bytes per line
+    int latency; // cycles beyond the pipeline's own load timing to get data from this level
+
+    // Creates an absent level
+    CacheConfig() {
+        size = 0;
+        ways = 1;
+        lineSize = 32;
+        latency = 0;
+    }
+};
+
+/**
+ * CacheLevel is one set associative cache. Each set's tags are stored side by
+ * side, padded to a multiple of four ways, so a lookup compares a whole set
+ * with one SIMD compare (two for 8 ways without AVX2).
+ */
+class CacheLevel {
+
+    public:
+
+        // Creates an empty cache with the given shape and policies
+        CacheLevel(CacheConfig config, ReplacementPolicy replacement, WritePolicy writes);
+
+        // Looks up address, filling its line on a miss. Returns true on a hit.
+        // If a dirty line had to be written back, evicted is set to true and
+        // victim to the line's address.
+        bool access(uint32_t address, bool isWrite, bool& evicted, uint32_t& victim);
+
+        // Returns the number of bytes in a line
+        int getLineSize() { return myConfig.lineSize; }
+
+        // Returns the cycles beyond the pipeline's own load timing to get data from this level
+        int getLatency() { return myConfig.latency; }
+
+        // Sets the hit, miss and writeback counts back to 0
+        void clearStats() { hits = misses = writebacks = 0; }
+
+        long long hits;
+        long long misses;
+        long long writebacks;
+
+    private:
+
+        // Given a set and a tag, returns the way holding the tag, or -1
+        int findWay(uint32_t set, uint32_t tag);
+
+        // Given a set, returns the way to fill next
+        int findVictim(uint32_t set);
+
+        // Records a use of way in set for the replacement policy
+        void touch(uint32_t set, int way);
+
+        CacheConfig myConfig;
+        ReplacementPolicy myReplacement;
+        WritePolicy myWrites;
+
+        int myOffsetBits; // log2 of the line size
+        uint32_t mySetMask; // number of sets - 1
+        int myIndexBits; // log2 of the number of sets
+        int myStride; // tag slots per set, ways rounded up to a multiple of 4
+
+        vector<uint32_t> myTags; // tag + 1 for each line, 0 if the line is empty
+        vector<uint8_t> myAges; // LRU age of each line, 0 is most recent
+        vector<uint32_t> myTreeBits; // PLRU bits for each set
+        vector<uint8_t> myDirty;
+};
+
+/**
+ * DataCache is an L1 with an optional L2 in front of memory. access says how
+ * many cycles a load or store takes beyond the pipeline's own load timing;
+ * when a miss's data arrives relative to the pipeline is left to the MissTracker.
+ */
+class DataCache {
+
+    public:
+
+        // Creates the hierarchy. l2.size may be 0 for no L2.
+        DataCache(CacheConfig l1, CacheConfig l2, int memoryLatency, ReplacementPolicy replacement, WritePolicy writes);
+
+        // Frees the cache levels
+        ~DataCache();
+
+        // Returns a new cache holding the same lines, with empty statistics
+        DataCache* clone();
+
+        // Accesses address and returns the cycles it takes beyond the pipeline's
+        // own load timing. missed is set to true if the access missed in L1.
+        int access(uint32_t address, bool isWrite, bool& missed);
+
+        // Given an address, returns the address of its L1 line
+        uint32_t lineOf(uint32_t address) { return address & ~(uint32_t)(myL1->getLineSize() - 1); }
+
+        // Prints hit and miss counts for every level
+        void printStats();
+
+    private:
+
+        CacheLevel* myL1;
+        CacheLevel* myL2; // nullptr when there is no L2
+        int myMemoryLatency;
+        WritePolicy myWrites;
+        long long myMemoryWrites;
+};
+
+/**
+ * MissTracker models the miss status holding registers: at most numMSHRs
+ * outstanding misses, with a second miss to a line already in flight merged
+ * into the first.
+ */
+class MissTracker {
+
+    public:
+
+        // Creates numMSHRs empty registers
+        MissTracker(int numMSHRs);
+
+        // Empties every register
+        void clear() { myLines.clear(); myFills.clear(); }
+
+        // A miss to line wants to start on cycle start and takes extra cycles.
+        // Waits for a free register if needed, moving start later, and returns
+        // the cycle the data arrives.
+        long long issue(uint32_t line, long long& start, int extra);
+
+    private:
+
+        int myCapacity;
+        vector<uint32_t> myLines; // line held by each busy register
+        vector<long long> myFills; // cycle each busy register's data arrives
+};
+
+// Given a string like "32768:4:32:0" (size, ways, line size, latency),
+// fills config and returns true if it describes a valid cache
+bool parseCacheConfig(string text, CacheConfig& config);
+
+#endif
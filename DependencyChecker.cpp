@@ -3,18 +3,34 @@
 #include "DependencyChecker.h"
 #include <iterator>
 
-/** Creates RegisterInfo entries for each of the 32 registers and creates lists for
-* dependencies and instructions.
+/** Creates RegisterInfo entries for each of the 32 registers, plus HI and LO,
+* and creates lists for dependencies and instructions.
 */
 DependencyChecker::DependencyChecker(int numRegisters) {
     instCount = 0;
+    myKnownDependences = nullptr;
+    myNextKnown = 0;
+    myKnownFirst = 0;
     RegisterInfo r;
 
+    // Keep the assembly in the caller's arena, or in one of our own
+    myArena = Arena::current();
+    myOwnArena = nullptr;
+    if (myArena == nullptr) {
+        myOwnArena = new Arena();
+        myArena = myOwnArena;
+    }
+
     // Create entries for all registers
     for (int i = 0; i < numRegisters; i++)
         myCurrentState.insert(make_pair(i, r));
 }
 
+// Frees the checker's own arena, if it made one
+DependencyChecker::~DependencyChecker() {
+    delete myOwnArena;
+}
+
 /**
 *  Adds an instruction to the list of instructions and checks to see if that
 * instruction results in any new data dependencies.  If new data dependencies
@@ -22,28 +38,135 @@ DependencyChecker::DependencyChecker(int numRegisters) {
 * are added to the list of dependences.
 */
 void DependencyChecker::addInstruction(Instruction i) {
-    InstType instrType = i.getInstType();
-    myInstructions.push_back(i);
-
-    switch (instrType) {
-    case RTYPE:
-        checkForReadDependence(i.getRT());
-        checkForReadDependence(i.getRS());
-        checkForWriteDependence(i.getRD());
-        break;
-    case ITYPE:
-        checkForReadDependence(i.getRS());
-        checkForWriteDependence(i.getRT());
-        break;
-    case JTYPE:
-        break;
-    default:
-        break;
+    const string& assembly = i.getAssembly();
+    myAssembly.push_back(myArena->copy(assembly.data(), assembly.size()));
+
+    if (myKnownDependences) {
+        // Records are in the order they were found, so this instruction's are next
+        const vector<DependenceRecord>& records = *myKnownDependences;
+        int number = myKnownFirst + instCount;
+        for (; myNextKnown < records.size() && records[myNextKnown].currentInstructionNumber <= number; myNextKnown++)
+            if (records[myNextKnown].currentInstructionNumber == number && records[myNextKnown].previousInstructionNumber >= myKnownFirst)
+                addRecordedDependence(records[myNextKnown]);
+        instCount += 1;
+        return;
     }
 
+    unsigned int reads[2];
+    int numReads = getReadRegisters(i, reads);
+    for (int r = 0; r < numReads; r++)
+        checkForReadDependence(reads[r]);
+
+    unsigned int write = getWriteRegister(i);
+    if (write != (unsigned int)NumDependenceRegisters)
+        checkForWriteDependence(write);
+    if (myOpcodeTable.writesHILO(i.getOpcode()))
+        checkForWriteDependence(HIRegister);
+
     instCount += 1;
 }
 
+/** Has addInstruction take the dependences from records, found earlier by
+* a checker over the same instructions, instead of working them out.
+* Records that involve an instruction before first are dropped and the
+* rest are renumbered to start from first. records must stay alive
+* while instructions are added.
+*/
+void DependencyChecker::useKnownDependences(const vector<DependenceRecord>* records, int first) {
+    myKnownDependences = records;
+    myNextKnown = 0;
+    myKnownFirst = first;
+}
+
+/** Fills records with every dependence found so far, in the order they
+* were found.
+*/
+void DependencyChecker::getDependenceRecords(vector<DependenceRecord>& records) {
+    records.clear();
+    DependenceList::iterator raw = myDependences.begin();
+    DependenceList::iterator other = myFalseDependences.begin();
+
+    // An instruction's reads are checked before its write
+    while (raw != myDependences.end() || other != myFalseDependences.end()) {
+        DependenceList::iterator next = raw;
+        if (raw == myDependences.end() || (other != myFalseDependences.end() && other->currentInstructionNumber < raw->currentInstructionNumber))
+            next = other++;
+        else
+            raw++;
+
+        DependenceRecord record;
+        record.previousInstructionNumber = next->previousInstructionNumber;
+        record.currentInstructionNumber = next->currentInstructionNumber;
+        record.dependenceType = next->dependenceType;
+        record.registerNumber = next->registerNumber;
+        records.push_back(record);
+    }
+}
+
+/** Adds the dependence a record describes to the right list, with the
+* assembly of the instructions involved.
+*/
+void DependencyChecker::addRecordedDependence(const DependenceRecord& record) {
+    Dependence depend;
+    depend.dependenceType = (DependenceType)record.dependenceType;
+    depend.registerNumber = record.registerNumber;
+    depend.previousInstructionNumber = record.previousInstructionNumber - myKnownFirst;
+    depend.currentInstructionNumber = record.currentInstructionNumber - myKnownFirst;
+    setAssembly(depend);
+
+    if (depend.dependenceType == RAW)
+        myDependences.push_back(depend);
+    else
+        myFalseDependences.push_back(depend);
+}
+
+/** Fills in the assembly of the two instructions depend involves.
+*/
+void DependencyChecker::setAssembly(Dependence& depend) {
+    depend.prevInstruction = myAssembly.at(depend.previousInstructionNumber);
+    depend.currInstruction = myAssembly.at(depend.currentInstructionNumber);
+}
+
+/** Given an instruction, fills regs with the registers it reads, in the order
+* they are checked, and returns how many there are. Every register field the
+* opcode table places is read except the one it writes, and MFLO reads
+* LORegister.
+*/
+int DependencyChecker::getReadRegisters(Instruction& i, unsigned int* regs) {
+    Opcode op = i.getOpcode();
+    int numReads = 0;
+    unsigned int rs = i.getRS();
+    unsigned int rt = i.getRT();
+
+    // RT is read unless it is where the result goes
+    bool rtWritten = myOpcodeTable.writesDestination(op) && myOpcodeTable.RDposition(op) == -1;
+    if (myOpcodeTable.RTposition(op) != -1 && !rtWritten && rt < (unsigned int)NumRegisters)
+        regs[numReads++] = rt;
+    if (myOpcodeTable.RSposition(op) != -1 && rs < (unsigned int)NumRegisters)
+        regs[numReads++] = rs;
+
+    if (myOpcodeTable.readsLO(op))
+        regs[numReads++] = LORegister;
+    return numReads;
+}
+
+/** Given an instruction, returns the register a later instruction can read
+* its result from, or NumDependenceRegisters if it does not write one.
+* MULT writes HI as well, but only LO can be read.
+*/
+unsigned int DependencyChecker::getWriteRegister(Instruction& i) {
+    Opcode op = i.getOpcode();
+    if (myOpcodeTable.writesHILO(op))
+        return LORegister;
+    if (!myOpcodeTable.writesDestination(op))
+        return NumDependenceRegisters;
+
+    unsigned int reg = (myOpcodeTable.RDposition(op) != -1) ? i.getRD() : i.getRT();
+    if (reg >= (unsigned int)NumRegisters)
+        return NumDependenceRegisters;
+    return reg;
+}
+
 /** 
  * Determines if a read data dependence occurs when reg is read by the current
 * instruction.  If so, adds an entry to the list of dependences. Also updates
@@ -63,8 +186,7 @@ void DependencyChecker::checkForReadDependence(unsigned int reg) {
         depend.registerNumber = reg;
         depend.previousInstructionNumber = matchInfo.lastInstructionToAccess;
         depend.currentInstructionNumber = instCount;
-        depend.prevInstruction = myInstructions.at(depend.previousInstructionNumber).getAssembly();
-        depend.currInstruction = myInstructions.at(depend.currentInstructionNumber).getAssembly();
+        setAssembly(depend);
         myDependences.push_back(depend);
         stringstream dependence("");
     }
@@ -92,9 +214,8 @@ void DependencyChecker::checkForWriteDependence(unsigned int reg) {
         depend.registerNumber = reg;
         depend.previousInstructionNumber = matchInfo.lastInstructionToAccess;
         depend.currentInstructionNumber = instCount;
-        depend.prevInstruction = myInstructions.at(depend.previousInstructionNumber).getAssembly();
-        depend.currInstruction = myInstructions.at(depend.currentInstructionNumber).getAssembly();
-        //myDependences.push_back(depend);
+        setAssembly(depend);
+        myFalseDependences.push_back(depend);
     } 
     else if (matchInfo.accessType == WRITE) {
         Dependence depend;
@@ -102,9 +223,8 @@ void DependencyChecker::checkForWriteDependence(unsigned int reg) {
         depend.registerNumber = reg;
         depend.previousInstructionNumber = matchInfo.lastInstructionToAccess;
         depend.currentInstructionNumber = instCount;
-        depend.prevInstruction = myInstructions.at(depend.previousInstructionNumber).getAssembly();
-        depend.currInstruction = myInstructions.at(depend.currentInstructionNumber).getAssembly();
-        //myDependences.push_back(depend);
+        setAssembly(depend);
+        myFalseDependences.push_back(depend);
     }
 
     myCurrentState.at(reg).lastInstructionToAccess = instCount;
@@ -117,16 +237,16 @@ void DependencyChecker::checkForWriteDependence(unsigned int reg) {
 */
 void DependencyChecker::printDependences() {
     // First, print all instructions
-    vector<Instruction>::iterator liter;
+    vector<const char*>::iterator liter;
     int i = 0;
     cout << "INSTRUCTIONS:" << endl;
-    for (liter = myInstructions.begin(); liter != myInstructions.end(); liter++) {
-        cout << i << ": " << (*liter).getAssembly() << endl;
+    for (liter = myAssembly.begin(); liter != myAssembly.end(); liter++) {
+        cout << i << ": " << *liter << endl;
         i++;
     }
 
     // Second, print all dependences
-    list<Dependence>::iterator diter;
+    DependenceList::iterator diter;
     cout << "DEPENDENCES: \nType Register (FirstInstr#, SecondInstr#) " << endl;
     for (diter = myDependences.begin(); diter != myDependences.end(); diter++) {
         switch ((*diter).dependenceType) {
@@ -143,26 +263,35 @@ void DependencyChecker::printDependences() {
             break;
         }
 
-        cout << "$" << (*diter).registerNumber << " \t";
+        if ((*diter).registerNumber == (unsigned int)HIRegister)
+            cout << "HI \t";
+        else if ((*diter).registerNumber == (unsigned int)LORegister)
+            cout << "LO \t";
+        else
+            cout << "$" << (*diter).registerNumber << " \t";
         cout << "(" << (*diter).previousInstructionNumber << ", ";
         cout << (*diter).currentInstructionNumber << ")" << endl;
     }
 }
 
-// Print all RAW dependence data in the instruction sequence
-void DependencyChecker::printRAWDependences() {
-    list<Dependence>::iterator diter;
+// Print the RAW dependence data in the instruction sequence where the
+// second instruction is firstInstruction or later, adding numberOffset
+// to every instruction number printed
+void DependencyChecker::printRAWDependences(int firstInstruction, long long numberOffset) {
+    DependenceList::iterator diter;
 
     for (diter = myDependences.begin(); diter != myDependences.end(); diter++) {
+        if ((*diter).currentInstructionNumber < firstInstruction)
+            continue;
         switch ((*diter).dependenceType) {
         case RAW:
-            cout << "RAW Dependence between instruction " << (*diter).previousInstructionNumber << " " << (*diter).prevInstruction << " and " << (*diter).currentInstructionNumber << " " << (*diter).currInstruction << endl;
+            cout << "RAW Dependence between instruction " << numberOffset + (*diter).previousInstructionNumber << " " << (*diter).prevInstruction << " and " << numberOffset + (*diter).currentInstructionNumber << " " << (*diter).currInstruction << endl;
             break;
         case WAR:
-            cout << "WAR Dependence between instruction " << (*diter).previousInstructionNumber << " " << (*diter).prevInstruction << " and " << (*diter).currentInstructionNumber << " " << (*diter).currInstruction << endl;
+            cout << "WAR Dependence between instruction " << numberOffset + (*diter).previousInstructionNumber << " " << (*diter).prevInstruction << " and " << numberOffset + (*diter).currentInstructionNumber << " " << (*diter).currInstruction << endl;
             break;
         case WAW:
-            cout << "WAW Dependence between instruction " << (*diter).previousInstructionNumber << " " << (*diter).prevInstruction << " and " << (*diter).currentInstructionNumber << " " << (*diter).currInstruction << endl;
+            cout << "WAW Dependence between instruction " << numberOffset + (*diter).previousInstructionNumber << " " << (*diter).prevInstruction << " and " << numberOffset + (*diter).currentInstructionNumber << " " << (*diter).currInstruction << endl;
             break;
         default:
             break;
@@ -3,9 +3,11 @@
 #ifndef __DEPENDENCYCHECKER_H__
 #define __DEPENDENCYCHECKER_H__
 
+#include "Arena.h"
 #include "Instruction.h"
 #include "OpcodeTable.h"
 
+#include <stdint.h>
 #include <list>
 #include <vector>
 #include <map>
@@ -48,13 +50,27 @@ struct RegisterInfo {
 */
 struct Dependence {
     DependenceType dependenceType;
-    string prevInstruction;
-    string currInstruction;
+    const char* prevInstruction; // assembly, kept in the checker's arena
+    const char* currInstruction;
     unsigned int registerNumber;
     int previousInstructionNumber; // first instruction to occur
     int currentInstructionNumber; // second instruction to occur
 };
 
+/** A DependenceRecord is a Dependence without its assembly strings, small
+* enough to save and load in bulk.
+*/
+struct DependenceRecord {
+    int32_t previousInstructionNumber;
+    int32_t currentInstructionNumber;
+    uint8_t dependenceType;
+    uint8_t registerNumber;
+};
+
+// Dependence nodes come from the arena current when the checker was
+// created, or from the heap
+typedef list<Dependence, ArenaAllocator<Dependence> > DependenceList;
+
 /**
  *  This class keeps track of a sequence of instructions and determines data
  * dependencies that occur between the instructions due to register usage.  Instructions
@@ -66,10 +82,13 @@ class DependencyChecker {
     public:
 
         /**
-        * Creates RegisterInfo entries for each of the 32 registers and creates lists for
-        * dependencies and instructions.
+        * Creates RegisterInfo entries for each of the 32 registers, plus HI and LO,
+        * and creates lists for dependencies and instructions.
         */
-        DependencyChecker(int numRegisters = 32);
+        DependencyChecker(int numRegisters = NumDependenceRegisters);
+
+        // Frees the checker's own arena, if it made one
+        ~DependencyChecker();
 
         /** Adds an instruction to the list of instructions and checks to see if that
         * instruction results in any new data dependencies.  If new data dependencies
@@ -78,18 +97,57 @@ class DependencyChecker {
         */
         void addInstruction(Instruction i);
 
+        /** Has addInstruction take the dependences from records, found earlier by
+        * a checker over the same instructions, instead of working them out.
+        * Records that involve an instruction before first are dropped and the
+        * rest are renumbered to start from first. records must stay alive
+        * while instructions are added.
+        */
+        void useKnownDependences(const vector<DependenceRecord>* records, int first);
+
+        /** Fills records with every dependence found so far, in the order they
+        * were found.
+        */
+        void getDependenceRecords(vector<DependenceRecord>& records);
+
         /** Prints out the sequence of instructions followed by the sequence of data
         * dependencies.
         */
         void printDependences();
 
         /* Prints out all RAW dependence data of the sequence */
-        void printRAWDependences();
+        void printRAWDependences() { printRAWDependences(0, 0); }
+
+        /* Prints out the RAW dependence data of the sequence where the second
+        * instruction is firstInstruction or later, adding numberOffset to
+        * every instruction number printed */
+        void printRAWDependences(int firstInstruction, long long numberOffset);
+
+        const DependenceList& getDependencies() { return myDependences; }
 
-        list<Dependence> getDependencies() { return myDependences; }
+        /** Returns the WAR and WAW dependences, which are kept apart from the RAW ones
+        * so the RAW listing is unchanged.
+        */
+        const DependenceList& getFalseDependencies() { return myFalseDependences; }
+
+        /** Given an instruction, fills regs with the registers it reads, in the order
+        * they are checked, and returns how many there are. Every register field the
+        * opcode table places is read except the one it writes, and MFLO reads
+        * LORegister.
+        */
+        int getReadRegisters(Instruction& i, unsigned int* regs);
+
+        /** Given an instruction, returns the register a later instruction can read
+        * its result from, or NumDependenceRegisters if it does not write one.
+        * MULT writes HI as well, but only LO can be read.
+        */
+        unsigned int getWriteRegister(Instruction& i);
 
     private:
 
+        DependencyChecker(const DependencyChecker&);
+        DependencyChecker& operator=(const DependencyChecker&);
+
         /** 
         * Determines if a read data dependence occurs when reg is read by the current
         * instruction.  If so, adds an entry to the list of dependences. Also updates
@@ -104,12 +162,28 @@ class DependencyChecker {
         */
         void checkForWriteDependence(unsigned int reg);
 
+        /** Adds the dependence a record describes to the right list, with the
+        * assembly of the instructions involved.
+        */
+        void addRecordedDependence(const DependenceRecord& record);
+
+        /** Fills in the assembly of the two instructions depend involves.
+        */
+        void setAssembly(Dependence& depend);
+
         map<unsigned int, RegisterInfo> myCurrentState;
-        list<Dependence> myDependences;
-        vector<Instruction> myInstructions;
+        DependenceList myDependences;
+        DependenceList myFalseDependences; // WAR and WAW
+        vector<const char*> myAssembly; // assembly of each instruction, kept in myArena
+        Arena* myArena; // the current arena when the checker was created, or myOwnArena
+        Arena* myOwnArena; // or nullptr if there was a current arena
         OpcodeTable myOpcodeTable;
         int instCount;
 
+        const vector<DependenceRecord>* myKnownDependences; // or nullptr to work them out
+        size_t myNextKnown; // next record to look at
+        int myKnownFirst; // instruction number in the records of instruction 0
+
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,5 @@
+add $1, $2, $3
+bogus
+add
+    mult $1, $2
+mflo
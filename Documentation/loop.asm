@@ -0,0 +1,15 @@
+    addi $1, $0, 2000
+    addi $5, $0, 3
+loop:
+    lb $2, 0($1)
+    add $3, $3, $2
+    mult $3, $5
+    mflo $4
+    xor $6, $4, $3
+    sll $7, $6, 2
+    slt $8, $7, $1
+    addi $1, $1, -1
+    beq $1, $0, done
+    j loop
+done:
+    slti $9, $3, 100
@@ -0,0 +1,275 @@
+// Palmer Robins
+
+#include "Executor.h"
+#include "Translator.h"
+
+#include <stdint.h>
+
+// Computed goto is a GNU extension. Other compilers dispatch through a switch
+// on the opcode left in each record's handler field.
+#if defined(__GNUC__)
+#define THREADED_CODE 1
+#define HANDLER(op) op##_handler:
+#define DISPATCH() goto *insn->handler
+#else
+#define THREADED_CODE 0
+#define HANDLER(op) case op:
+#define DISPATCH() goto dispatch
+#endif
+
+// Creates an executor with every register and memory byte set to zero
+Executor::Executor() {
+    for (int r = 0; r <= NumRegisters; r++)
+        myState.regs[r] = 0;
+    myState.hi = myState.lo = 0;
+    myState.budget = 0;
+    myState.log = myState.logEnd = nullptr;
+    myState.memory = &myMemory;
+    myPC = 0;
+    myThreaded = false;
+    myTranslations = nullptr;
+}
+
+// Executor deconstructor
+Executor::~Executor() {
+    delete myTranslations;
+}
+
+// Given a register field, returns it as an index into myRegisters.
+// Fields that are not used point at a scratch register.
+uint8_t Executor::regIndex(Register r) {
+    if (r < 0 || r >= NumRegisters)
+        return NumRegisters;
+    return r;
+}
+
+// Like loadProgram, but if straightLine is true every BEQ and J falls
+// through, so run executes each instruction once in listed order
+void Executor::loadProgram(vector<Instruction>& program, bool straightLine) {
+    myProgram.resize(program.size());
+    mySource = program;
+    myThreaded = false;
+    myPC = 0;
+    invalidateTranslations();
+
+    for (unsigned int k = 0; k < program.size(); k++) {
+        Instruction& i = program[k];
+        DecodedInstr& d = myProgram[k];
+        Opcode op = i.getOpcode();
+
+        d.handler = (const void*)(intptr_t)op;
+        d.rd = regIndex(i.getRD());
+        d.rs = regIndex(i.getRS());
+        d.rt = regIndex(i.getRT());
+        d.imm = i.getImmediate();
+
+        // Branch offsets are relative to the next instruction, so resolve
+        // them once here. J already holds an instruction number.
+        if (op == BEQ)
+            d.imm = k + 1 + i.getImmediate();
+        else if (op == SLL)
+            d.imm = i.getImmediate() & 31;
+
+        if (straightLine && (op == BEQ || op == J))
+            d.imm = k + 1;
+    }
+}
+
+// Runs like run, and also appends the address each committed LB reads
+// to loadAddresses, if it is given
+long long Executor::run(long long maxSteps, vector<int>* committed, vector<uint32_t>* loadAddresses) {
+
+#if THREADED_CODE
+    // Swap each record's opcode for the address of its handler
+    if (!myThreaded) {
+        static const void* handlers[UNDEFINED + 1] = {
+            &&ADD_handler, &&ADDI_handler, &&XOR_handler, &&MULT_handler,
+            &&MFLO_handler, &&SLL_handler, &&SLT_handler, &&SLTI_handler,
+            &&LB_handler, &&J_handler, &&BEQ_handler, &&UNDEFINED_handler
+        };
+        for (unsigned int k = 0; k < myProgram.size(); k++)
+            myProgram[k].handler = handlers[(intptr_t)myProgram[k].handler];
+        myThreaded = true;
+    }
+#endif
+
+    int32_t* R = myState.regs;
+    DecodedInstr* code = myProgram.data();
+    unsigned int size = myProgram.size();
+    unsigned int pc = myPC;
+    long long steps = 0;
+    DecodedInstr* insn;
+
+    // Stop once the PC leaves the program or the step budget is spent,
+    // otherwise record the instruction and jump to its handler
+#define FETCH()                                                 \
+    do {                                                        \
+        if (pc >= size || steps == maxSteps)                    \
+            goto done;                                          \
+        if (committed)                                          \
+            committed->push_back(pc);                           \
+        steps++;                                                \
+        insn = &code[pc];                                       \
+        DISPATCH();                                             \
+    } while (0)
+
+    FETCH();
+
+#if !THREADED_CODE
+dispatch:
+    switch ((intptr_t)insn->handler) {
+#endif
+
+    HANDLER(ADD)
+        R[insn->rd] = (int32_t)((uint32_t)R[insn->rs] + (uint32_t)R[insn->rt]);
+        R[0] = 0;
+        pc++;
+        FETCH();
+
+    HANDLER(ADDI)
+        R[insn->rt] = (int32_t)((uint32_t)R[insn->rs] + (uint32_t)insn->imm);
+        R[0] = 0;
+        pc++;
+        FETCH();
+
+    HANDLER(XOR)
+        R[insn->rd] = R[insn->rs] ^ R[insn->rt];
+        R[0] = 0;
+        pc++;
+        FETCH();
+
+    HANDLER(MULT) {
+        int64_t product = (int64_t)R[insn->rs] * (int64_t)R[insn->rt];
+        myState.hi = (int32_t)(product >> 32);
+        myState.lo = (int32_t)product;
+        pc++;
+        FETCH();
+    }
+
+    HANDLER(MFLO)
+        R[insn->rd] = myState.lo;
+        R[0] = 0;
+        pc++;
+        FETCH();
+
+    HANDLER(SLL)
+        R[insn->rd] = (int32_t)((uint32_t)R[insn->rt] << insn->imm);
+        R[0] = 0;
+        pc++;
+        FETCH();
+
+    HANDLER(SLT)
+        R[insn->rd] = R[insn->rs] < R[insn->rt];
+        R[0] = 0;
+        pc++;
+        FETCH();
+
+    HANDLER(SLTI)
+        R[insn->rt] = R[insn->rs] < insn->imm;
+        R[0] = 0;
+        pc++;
+        FETCH();
+
+    HANDLER(LB) {
+        uint32_t address = (uint32_t)R[insn->rs] + (uint32_t)insn->imm;
+        if (loadAddresses)
+            loadAddresses->push_back(address);
+        R[insn->rt] = (int8_t)myMemory.readByte(address);
+        R[0] = 0;
+        pc++;
+        FETCH();
+    }
+
+    HANDLER(J)
+        pc = insn->imm;
+        FETCH();
+
+    HANDLER(BEQ)
+        pc = (R[insn->rs] == R[insn->rt]) ? insn->imm : pc + 1;
+        FETCH();
+
+    HANDLER(UNDEFINED)
+        // An undefined instruction stops the program where it is
+        // without being committed
+        steps--;
+        if (committed)
+            committed->pop_back();
+        goto done;
+
+#if !THREADED_CODE
+    }
+#endif
+
+#undef FETCH
+
+done:
+    myPC = pc;
+    return steps;
+}
+
+// Runs like run, but compiles hot basic blocks to host code and executes
+// them from a translation cache. Committed instructions are reported a
+// block at a time in blocks, if it is given. Falls back to run when the
+// host cannot execute translated code.
+long long Executor::runTranslated(long long maxSteps, vector<BlockRecord>* blocks) {
+    if (myTranslations == nullptr) {
+        myTranslations = new TranslationCache();
+        myTranslations->reset(mySource, blocks != nullptr);
+    }
+
+    long long steps = 0;
+    vector<uint32_t> log;
+    if (blocks)
+        log.resize(2 * TranslationCache::LOG_RECORDS);
+
+    // Turning block logging on or off changes the code that gets generated
+    if (myTranslations->isLogging() != (blocks != nullptr))
+        myTranslations->reset(mySource, blocks != nullptr);
+
+    while (!isHalted() && steps != maxSteps && myTranslations->isAvailable()) {
+        long long remaining = (maxSteps < 0) ? (1LL << 62) : maxSteps - steps;
+
+        TranslationCache::BlockCode code = myTranslations->lookup(myPC);
+        if (code == nullptr || remaining < myTranslations->blockLength(myPC))
+            break; // the interpreter finishes what translated code cannot
+
+        myState.budget = remaining;
+        if (blocks) {
+            myState.log = &log[0];
+            myState.logEnd = &log[0] + log.size();
+        }
+
+        myPC = code(&myState);
+        steps += remaining - myState.budget;
+
+        // Hand the logged blocks over before running again
+        if (blocks)
+            for (uint32_t* r = &log[0]; r < myState.log; r += 2) {
+                BlockRecord record;
+                record.startPC = r[0];
+                record.length = r[1];
+                blocks->push_back(record);
+            }
+    }
+
+    // Anything left over is interpreted an instruction at a time
+    if (!isHalted() && steps != maxSteps) {
+        vector<int> committed;
+        long long left = (maxSteps < 0) ? -1 : maxSteps - steps;
+        steps += run(left, blocks ? &committed : nullptr);
+        for (unsigned int k = 0; k < committed.size(); k++) {
+            BlockRecord record;
+            record.startPC = committed[k];
+            record.length = 1;
+            blocks->push_back(record);
+        }
+    }
+    return steps;
+}
+
+// Discards every translated block, so the next translated run
+// compiles the program again
+void Executor::invalidateTranslations() {
+    if (myTranslations)
+        myTranslations->reset(mySource, myTranslations->isLogging());
+}
@@ -0,0 +1,138 @@
+// Palmer Robins
+
+#ifndef __EXECUTOR_H__
+#define __EXECUTOR_H__
+
+#include "Instruction.h"
+#include "Memory.h"
+#include "OpcodeTable.h"
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+class TranslationCache;
+
+/**
+ * GuestState holds the architectural state of the running program, laid out
+ * so translated blocks can address every field from a single base register.
+ */
+struct GuestState {
+    int32_t regs[NumRegisters + 1]; // registers 0 to 31, plus a scratch slot for unused fields
+    int32_t hi;
+    int32_t lo;
+    int64_t budget; // instructions left before translated code must return
+    uint32_t* log; // next free block record, when translated code logs blocks
+    uint32_t* logEnd; // end of the block record buffer
+    SparseMemory* memory;
+};
+
+/**
+ * A BlockRecord says that length instructions were committed in a row,
+ * starting with instruction number startPC.
+ */
+struct BlockRecord {
+    uint32_t startPC;
+    uint32_t length;
+};
+
+/**
+ * The Executor runs a program instead of replaying it as a static list.
+ * It keeps the register file, HI/LO and a sparse memory, resolves BEQ and J,
+ * and records the number of every instruction it commits so the committed
+ * stream can be fed to the pipeline models.
+ *
+ * Before running, instructions are predecoded into compact records that hold
+ * the address of their handler, so the interpreter dispatches straight from
+ * one handler to the next (threaded code).
+ */
+class Executor {
+
+    public:
+
+        // Creates an executor with every register and memory byte set to zero
+        Executor();
+
+        // Executor deconstructor
+        ~Executor();
+
+        // Given the program's instructions, in order, predecodes them and resets
+        // the PC to the first instruction
+        void loadProgram(vector<Instruction>& program) { loadProgram(program, false); }
+
+        // Like loadProgram, but if straightLine is true every BEQ and J falls
+        // through, so run executes each instruction once in listed order. This
+        // gives register values for a trace that was not executed.
+        void loadProgram(vector<Instruction>& program, bool straightLine);
+
+        // Runs until the PC leaves the program or maxSteps instructions have been
+        // committed. The number of each committed instruction is appended to
+        // committed, if it is given. Returns the number of instructions committed.
+        long long run(long long maxSteps, vector<int>* committed) { return run(maxSteps, committed, nullptr); }
+
+        // Runs like run, and also appends the address each committed LB reads
+        // to loadAddresses, if it is given
+        long long run(long long maxSteps, vector<int>* committed, vector<uint32_t>* loadAddresses);
+
+        // Runs like run, but compiles hot basic blocks to host code and executes
+        // them from a translation cache. Committed instructions are reported a
+        // block at a time in blocks, if it is given. Falls back to run when the
+        // host cannot execute translated code.
+        long long runTranslated(long long maxSteps, vector<BlockRecord>* blocks);
+
+        // Discards every translated block, so the next translated run
+        // compiles the program again
+        void invalidateTranslations();
+
+        // Returns true if the program ran off its end, rather than being stopped
+        bool isHalted() { return myPC < 0 || myPC >= (int)myProgram.size(); }
+
+        // Returns the number of the next instruction to execute
+        int getPC() { return myPC; }
+
+        // Returns the value held in register r
+        int32_t getRegister(Register r) { return myState.regs[r]; }
+
+        // Sets register r to value. Writes to $0 are ignored.
+        void setRegister(Register r, int32_t value) { if (r != 0) myState.regs[r] = value; }
+
+        // Returns the value in HI
+        int32_t getHI() { return myState.hi; }
+
+        // Returns the value in LO
+        int32_t getLO() { return myState.lo; }
+
+        // Returns the memory the program loads from
+        SparseMemory& getMemory() { return myMemory; }
+
+    private:
+
+        // A predecoded instruction. handler starts out as the Opcode and is
+        // replaced with the address of its handler the first time run is called.
+        struct DecodedInstr {
+            const void* handler;
+            int32_t imm; // immediate, shift amount or resolved branch target
+            uint8_t rd;
+            uint8_t rs;
+            uint8_t rt;
+        };
+
+        // Given a register field, returns it as an index into myRegisters.
+        // Fields that are not used point at a scratch register.
+        uint8_t regIndex(Register r);
+
+        vector<DecodedInstr> myProgram;
+        vector<Instruction> mySource; // the program as loaded, for the translator
+        bool myThreaded; // true once handler addresses have been filled in
+
+        GuestState myState;
+        int myPC;
+
+        TranslationCache* myTranslations; // created on the first translated run
+
+        SparseMemory myMemory;
+        OpcodeTable myOpcodes;
+};
+
+#endif
@@ -0,0 +1,110 @@
+// Palmer Robins
+
+#include "InputReader.h"
+
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+
+// How long the reading thread waits for input before checking whether
+// it should stop
+static const int POLL_MILLIS = 50;
+
+// Waits a little for the other side of the ring, spinning first since
+// the other side is usually about to catch up
+static void waitBriefly(int& spins) {
+    if (++spins < 64)
+        this_thread::yield();
+    else
+        this_thread::sleep_for(chrono::microseconds(20));
+}
+
+// Starts reading fd. The caller keeps fd open until the reader is gone.
+InputReader::InputReader(int fd) : myFilled(0), myReleased(0), myStopping(false), myFailed(false) {
+    myFd = fd;
+    myHolding = false;
+    myAtEnd = false;
+    for (int c = 0; c < NUM_CHUNKS; c++) {
+        myChunks[c].resize(CHUNK_SIZE);
+        myLengths[c] = 0;
+    }
+    setg(nullptr, nullptr, nullptr);
+    myThread = thread(&InputReader::readChunks, this);
+}
+
+// Stops the reading thread, even if the input was not read to its end
+InputReader::~InputReader() {
+    myStopping.store(true);
+    myThread.join();
+}
+
+// Fills chunks on the reading thread until the end of the input
+void InputReader::readChunks() {
+    unsigned int next = 0;
+    while (true) {
+        // Wait for the parser to give back a chunk
+        int spins = 0;
+        while (next - myReleased.load(memory_order_acquire) == (unsigned int)NUM_CHUNKS) {
+            if (myStopping.load())
+                return;
+            waitBriefly(spins);
+        }
+
+        // A chunk is handed over as soon as anything is read into it, so a
+        // slow generator does not keep lines it has written from the parser
+        int c = next % NUM_CHUNKS;
+        ssize_t n;
+        while (true) {
+            if (myStopping.load())
+                return;
+            struct pollfd input;
+            input.fd = myFd;
+            input.events = POLLIN;
+            if (poll(&input, 1, POLL_MILLIS) == 0)
+                continue;
+            n = read(myFd, myChunks[c].data(), CHUNK_SIZE);
+            if (n >= 0 || errno != EINTR)
+                break;
+        }
+        if (n < 0) {
+            myFailed.store(true);
+            n = 0;
+        }
+
+        myLengths[c] = n;
+        myFilled.store(++next, memory_order_release);
+        if (n == 0)
+            return;
+    }
+}
+
+// Moves on to the next chunk once the parser has used this one
+InputReader::int_type InputReader::underflow() {
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+    if (myAtEnd)
+        return traits_type::eof();
+
+    unsigned int current = myReleased.load(memory_order_relaxed);
+    if (myHolding) {
+        myHolding = false;
+        myReleased.store(++current, memory_order_release);
+    }
+
+    int spins = 0;
+    while (myFilled.load(memory_order_acquire) == current)
+        waitBriefly(spins);
+
+    int c = current % NUM_CHUNKS;
+    if (myLengths[c] == 0) {
+        myAtEnd = true;
+        setg(nullptr, nullptr, nullptr);
+        return traits_type::eof();
+    }
+
+    char* begin = myChunks[c].data();
+    setg(begin, begin, begin + myLengths[c]);
+    myHolding = true;
+    return traits_type::to_int_type(*gptr());
+}
@@ -0,0 +1,62 @@
+// Palmer Robins
+
+#ifndef __INPUTREADER_H__
+#define __INPUTREADER_H__
+
+#include <atomic>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * InputReader is a stream buffer over a file descriptor, such as standard
+ * input, that is read by a thread of its own. The thread fills a ring of
+ * chunks while the parser reading through the buffer uses the chunk in
+ * front, so reading and parsing overlap and a pipe runs at the speed of
+ * whichever side is slower. The ring has one writer and one reader, so
+ * handing a chunk over is two atomic counters and no lock.
+ */
+class InputReader : public streambuf {
+
+    public:
+
+        static const int NUM_CHUNKS = 4;
+        static const size_t CHUNK_SIZE = 1 << 16;
+
+        // Starts reading fd. The caller keeps fd open until the reader is gone.
+        InputReader(int fd);
+
+        // Stops the reading thread, even if the input was not read to its end
+        ~InputReader();
+
+        // Returns true if reading the input failed before its end
+        bool hasFailed() { return myFailed.load(); }
+
+    protected:
+
+        // Moves on to the next chunk once the parser has used this one
+        int_type underflow();
+
+    private:
+
+        InputReader(const InputReader&);
+        InputReader& operator=(const InputReader&);
+
+        // Fills chunks on the reading thread until the end of the input
+        void readChunks();
+
+        int myFd;
+        vector<char> myChunks[NUM_CHUNKS];
+        size_t myLengths[NUM_CHUNKS]; // bytes read into each chunk, 0 at the end of the input
+        atomic<unsigned int> myFilled; // chunks handed to the parser so far
+        atomic<unsigned int> myReleased; // chunks the parser is done with
+        bool myHolding; // whether the parser is using a chunk
+        bool myAtEnd;
+        atomic<bool> myStopping; // set to stop the thread early
+        atomic<bool> myFailed;
+        thread myThread;
+};
+
+#endif
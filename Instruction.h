@@ -6,6 +6,13 @@
 #include "OpcodeTable.h"
 #include "RegisterTable.h"
 
+#include <stdint.h>
+
+// Address of the first instruction in a binary listing. The field of an
+// encoded J is this address over four plus the instruction number it
+// goes to, while an Instruction's J immediate is the number alone.
+const uint32_t TEXT_BASE = 0x00400000;
+
 // This class provides an internal representation for a MIPS assembly instruction.
 // Any of the fields can be queried.  Additionally, the class stores a 32 bit binary
 // encoding of the MIPS instruction.
@@ -48,7 +55,7 @@ class Instruction {
         void setAssembly(string assembly) { myAssembly = assembly; };
 
         // Returns the assembly representation of the instruction
-        string getAssembly() { return myAssembly; };
+        const string& getAssembly() { return myAssembly; };
 
     private:
 
@@ -0,0 +1,67 @@
+// Palmer Robins
+
+#include "MappedFile.h"
+
+#include <fstream>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CAN_MAP 1
+#else
+#define CAN_MAP 0
+#endif
+
+// Maps filename. getData is nullptr if it could not be opened,
+// and may be for an empty file too.
+MappedFile::MappedFile(string filename) {
+    myData = nullptr;
+    mySize = 0;
+    myOpen = false;
+    myMapped = false;
+
+#if CAN_MAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || S_ISDIR(info.st_mode)) {
+        close(fd);
+        return;
+    }
+    if (info.st_size > 0) {
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            myData = (const uint8_t*)data;
+            mySize = info.st_size;
+            myMapped = true;
+        }
+    }
+    close(fd);
+    if (myMapped) {
+        myOpen = true;
+        return;
+    }
+#endif
+
+    // Empty files cannot be mapped, and some systems cannot map at all
+    ifstream in(filename.c_str(), ios::binary);
+    if (!in)
+        return;
+    myCopy.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    if (in.bad())
+        return;
+    myOpen = true;
+    myData = myCopy.data();
+    mySize = myCopy.size();
+}
+
+// Unmaps the file
+MappedFile::~MappedFile() {
+#if CAN_MAP
+    if (myMapped)
+        munmap((void*)myData, mySize);
+#endif
+}
@@ -0,0 +1,45 @@
+// Palmer Robins
+
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * MappedFile maps a whole file read only, falling back to reading it
+ * into memory where mapping is not available.
+ */
+class MappedFile {
+
+    public:
+
+        // Maps filename. getData is nullptr if it could not be opened,
+        // and may be for an empty file too.
+        MappedFile(string filename);
+
+        // Unmaps the file
+        ~MappedFile();
+
+        // Returns true if the file could be opened and read
+        bool isOpen() { return myOpen; }
+
+        const uint8_t* getData() { return myData; }
+        size_t getSize() { return mySize; }
+
+    private:
+
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        const uint8_t* myData;
+        size_t mySize;
+        bool myOpen;
+        bool myMapped; // true if myData is a mapping, false if it is myCopy
+        vector<uint8_t> myCopy;
+};
+
+#endif
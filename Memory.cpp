@@ -0,0 +1,47 @@
+// Palmer Robins
+
+#include "Memory.h"
+
+// Creates an empty memory where every byte is zero
+SparseMemory::SparseMemory() {
+    myLastPageNumber = 0;
+    myLastPage = nullptr;
+}
+
+// Given an address, returns the byte stored there
+uint8_t SparseMemory::readByte(uint32_t address) {
+    uint8_t* page = findPage(address >> PAGE_BITS, false);
+    if (page == nullptr)
+        return 0;
+    return page[address & (PAGE_SIZE - 1)];
+}
+
+// Stores value at the given address
+void SparseMemory::writeByte(uint32_t address, uint8_t value) {
+    uint8_t* page = findPage(address >> PAGE_BITS, true);
+    page[address & (PAGE_SIZE - 1)] = value;
+}
+
+// Releases every page, so the whole memory reads as zero again
+void SparseMemory::clear() {
+    myPages.clear();
+    myLastPage = nullptr;
+}
+
+// Given a page number, returns its storage, allocating it if requested.
+// Returns nullptr for a page that was never written.
+uint8_t* SparseMemory::findPage(uint32_t pageNumber, bool allocate) {
+    if (myLastPage != nullptr && myLastPageNumber == pageNumber)
+        return myLastPage;
+
+    unordered_map<uint32_t, vector<uint8_t> >::iterator it = myPages.find(pageNumber);
+    if (it == myPages.end()) {
+        if (!allocate)
+            return nullptr;
+        it = myPages.insert(make_pair(pageNumber, vector<uint8_t>(PAGE_SIZE, 0))).first;
+    }
+
+    myLastPageNumber = pageNumber;
+    myLastPage = &it->second[0];
+    return myLastPage;
+}
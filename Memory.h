@@ -0,0 +1,48 @@
+// Palmer Robins
+
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * SparseMemory models a byte addressable 32 bit address space. Only pages
+ * that have been written take up space; every other byte reads as zero.
+ */
+class SparseMemory {
+
+    public:
+
+        // Creates an empty memory where every byte is zero
+        SparseMemory();
+
+        // Given an address, returns the byte stored there
+        uint8_t readByte(uint32_t address);
+
+        // Stores value at the given address
+        void writeByte(uint32_t address, uint8_t value);
+
+        // Releases every page, so the whole memory reads as zero again
+        void clear();
+
+    private:
+
+        static const int PAGE_BITS = 12; // 4KB pages
+        static const uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+
+        // Given a page number, returns its storage, allocating it if requested.
+        // Returns nullptr for a page that was never written.
+        uint8_t* findPage(uint32_t pageNumber, bool allocate);
+
+        unordered_map<uint32_t, vector<uint8_t> > myPages;
+
+        // The most recently used page, checked before the hash map
+        uint32_t myLastPageNumber;
+        uint8_t* myLastPage;
+};
+
+#endif
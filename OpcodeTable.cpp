@@ -11,6 +11,7 @@ OpcodeTable::OpcodeTable() {
     myArray[ADD].rsPos = 1;
     myArray[ADD].rtPos = 2;
     myArray[ADD].immPos = -1;
+    myArray[ADD].writesDestination = true;
     myArray[ADD].instType = RTYPE;
     myArray[ADD].op_field = "000000";
     myArray[ADD].funct_field = "100000";
@@ -21,6 +22,7 @@ OpcodeTable::OpcodeTable() {
     myArray[ADDI].rsPos = 1;
     myArray[ADDI].rtPos = 0;
     myArray[ADDI].immPos = 2;
+    myArray[ADDI].writesDestination = true;
     myArray[ADDI].instType = ITYPE;
     myArray[ADDI].op_field = "001000";
 
@@ -30,6 +32,7 @@ OpcodeTable::OpcodeTable() {
     myArray[XOR].rsPos = 1;
     myArray[XOR].rtPos = 2;
     myArray[XOR].immPos = -1;
+    myArray[XOR].writesDestination = true;
     myArray[XOR].instType = RTYPE;
     myArray[XOR].op_field = "000000";
     myArray[XOR].funct_field = "100110";
@@ -41,6 +44,9 @@ OpcodeTable::OpcodeTable() {
     myArray[MULT].rtPos = 1;
     myArray[MULT].immPos = -1;
     myArray[MULT].instType = RTYPE;
+    myArray[MULT].latency = 4;
+    myArray[MULT].initiationInterval = 4;
+    myArray[MULT].writesHILO = true;
     myArray[MULT].op_field = "000000";
     myArray[MULT].funct_field = "011000";
 
@@ -50,7 +56,9 @@ OpcodeTable::OpcodeTable() {
     myArray[MFLO].rsPos = -1;
     myArray[MFLO].rtPos = -1;
     myArray[MFLO].immPos = -1;
+    myArray[MFLO].writesDestination = true;
     myArray[MFLO].instType = RTYPE;
+    myArray[MFLO].readsLO = true;
     myArray[MFLO].op_field = "000000";
     myArray[MFLO].funct_field = "010010";
 
@@ -60,6 +68,7 @@ OpcodeTable::OpcodeTable() {
     myArray[SLL].rsPos = -1;
     myArray[SLL].rtPos = 1;
     myArray[SLL].immPos = 2;
+    myArray[SLL].writesDestination = true;
     myArray[SLL].instType = RTYPE;
     myArray[SLL].op_field = "000000";
     myArray[SLL].funct_field = "000000";
@@ -70,6 +79,7 @@ OpcodeTable::OpcodeTable() {
     myArray[SLT].rsPos = 1;
     myArray[SLT].rtPos = 2;
     myArray[SLT].immPos = -1;
+    myArray[SLT].writesDestination = true;
     myArray[SLT].instType = RTYPE;
     myArray[SLT].op_field = "000000";
     myArray[SLT].funct_field = "101010";
@@ -80,6 +90,7 @@ OpcodeTable::OpcodeTable() {
     myArray[SLTI].rsPos = 1;
     myArray[SLTI].rtPos = 0;
     myArray[SLTI].immPos = 2;
+    myArray[SLTI].writesDestination = true;
     myArray[SLTI].instType = ITYPE;
     myArray[SLTI].op_field = "001010";
 
@@ -89,6 +100,7 @@ OpcodeTable::OpcodeTable() {
     myArray[LB].rsPos = 2;
     myArray[LB].rtPos = 0;
     myArray[LB].immPos = 1;
+    myArray[LB].writesDestination = true;
     myArray[LB].instType = ITYPE;
     myArray[LB].isMemoryInstr = true;
     myArray[LB].op_field = "100000";
@@ -104,6 +116,7 @@ OpcodeTable::OpcodeTable() {
     myArray[J].op_field = "000010";
 
     myArray[BEQ].name = "beq";
+    myArray[BEQ].numOps = 3;
     myArray[BEQ].rdPos = -1;
     myArray[BEQ].rsPos = 0;
     myArray[BEQ].rtPos = 1;
@@ -242,4 +255,52 @@ bool OpcodeTable::isMemoryInstr(Opcode o) {
         return false;
 
     return myArray[o].isMemoryInstr;
+}
+
+// Given an Opcode, returns how many cycles the instruction spends in its
+// functional unit before the result can be forwarded.
+// Example: "mult" takes 4
+int OpcodeTable::getLatency(Opcode o) {
+    if (o < 0 || o >= UNDEFINED)
+        return 1;
+
+    return myArray[o].latency;
+}
+
+// Given an Opcode, returns how many cycles after the instruction starts
+// its functional unit can start another. A unit that is not pipelined
+// has the same initiation interval as latency.
+int OpcodeTable::getInitiationInterval(Opcode o) {
+    if (o < 0 || o >= UNDEFINED)
+        return 1;
+
+    return myArray[o].initiationInterval;
+}
+
+// Given an Opcode, returns true if the instruction writes a register
+// field: RD if it has one, otherwise RT. Every other field it names is
+// read. Example: "addi" writes RT, "beq" writes nothing
+bool OpcodeTable::writesDestination(Opcode o) {
+    if (o < 0 || o >= UNDEFINED)
+        return false;
+
+    return myArray[o].writesDestination;
+}
+
+// Given an Opcode, returns true if the instruction writes HI and LO
+// Example: "mult"
+bool OpcodeTable::writesHILO(Opcode o) {
+    if (o < 0 || o >= UNDEFINED)
+        return false;
+
+    return myArray[o].writesHILO;
+}
+
+// Given an Opcode, returns true if the instruction reads LO
+// Example: "mflo"
+bool OpcodeTable::readsLO(Opcode o) {
+    if (o < 0 || o >= UNDEFINED)
+        return false;
+
+    return myArray[o].readsLO;
 }
\ No newline at end of file
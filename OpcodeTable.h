@@ -84,6 +84,29 @@ public:
     // Given an Opcode, returns instruction type.
     InstType getInstType(Opcode o);
 
+    // Given an Opcode, returns how many cycles the instruction spends in its
+    // functional unit before the result can be forwarded.
+    // Example: "mult" takes 4
+    int getLatency(Opcode o);
+
+    // Given an Opcode, returns how many cycles after the instruction starts
+    // its functional unit can start another. A unit that is not pipelined
+    // has the same initiation interval as latency.
+    int getInitiationInterval(Opcode o);
+
+    // Given an Opcode, returns true if the instruction writes a register
+    // field: RD if it has one, otherwise RT. Every other field it names is
+    // read. Example: "addi" writes RT, "beq" writes nothing
+    bool writesDestination(Opcode o);
+
+    // Given an Opcode, returns true if the instruction writes HI and LO
+    // Example: "mult"
+    bool writesHILO(Opcode o);
+
+    // Given an Opcode, returns true if the instruction reads LO
+    // Example: "mflo"
+    bool readsLO(Opcode o);
+
     // Given an Opcode, returns a string representing the binary encoding of the opcode
     // field.
     string getOpcodeField(Opcode o);
@@ -106,6 +129,11 @@ private:
         bool immLabel;
         bool isMemoryInstr;
         int numOperands;
+        int latency; // cycles in the functional unit
+        int initiationInterval; // cycles before the unit takes another
+        bool writesDestination;
+        bool writesHILO;
+        bool readsLO;
 
         InstType instType;
         string op_field;
@@ -117,6 +145,8 @@ private:
             rdPos = rsPos = rtPos = immPos = -1;
             immLabel = false;
             isMemoryInstr = false;
+            latency = initiationInterval = 1;
+            writesDestination = writesHILO = readsLO = false;
         };
     };
 
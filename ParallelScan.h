@@ -0,0 +1,52 @@
+// Palmer Robins
+
+#ifndef __PARALLELSCAN_H__
+#define __PARALLELSCAN_H__
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Splits [0, n) into numChunks contiguous chunks and calls body(chunk, begin, end)
+// for each one on its own thread. Returns once every chunk is finished.
+template <class Body>
+void parallelForChunks(int n, int numChunks, Body body) {
+    if (numChunks < 1)
+        numChunks = 1;
+    if (numChunks > n)
+        numChunks = (n > 0) ? n : 1;
+
+    vector<thread> workers;
+    int chunkSize = n / numChunks;
+    int extra = n % numChunks;
+    int begin = 0;
+
+    for (int c = 0; c < numChunks; c++) {
+        int end = begin + chunkSize + (c < extra ? 1 : 0);
+        // Run the last chunk on the calling thread
+        if (c == numChunks - 1)
+            body(c, begin, end);
+        else
+            workers.push_back(thread(body, c, begin, end));
+        begin = end;
+    }
+
+    for (unsigned int w = 0; w < workers.size(); w++)
+        workers[w].join();
+}
+
+// Replaces each chunk's cycles with the cycles of every chunk before
+// it, so cycles[c] becomes the cycle chunk c starts on.
+// Returns the cycles of the whole sequence.
+inline long long exclusiveScan(vector<long long>& cycles) {
+    long long running = 0;
+    for (unsigned int c = 0; c < cycles.size(); c++) {
+        long long chunk = cycles[c];
+        cycles[c] = running;
+        running += chunk;
+    }
+    return running;
+}
+
+#endif
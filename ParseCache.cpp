@@ -0,0 +1,179 @@
+// Palmer Robins
+
+#include "ParseCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static const char CACHE_MAGIC[8] = "PIPEPC";
+
+// The fixed part at the front of a sidecar. It is followed by the
+// instructions, the dependence records and the assembly strings.
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSizes; // sizes of the two record types, to catch other layouts
+    uint64_t inputHash;
+    uint64_t inputSize;
+    uint64_t numInstructions;
+    uint64_t numDependences;
+    uint64_t assemblyBytes;
+};
+
+// One predecoded instruction; its assembly string is the next
+// assemblyLength bytes of the string area
+struct CachedInstruction {
+    int32_t immediate;
+    int8_t opcode;
+    int8_t rs;
+    int8_t rt;
+    int8_t rd;
+    uint32_t assemblyLength;
+};
+
+static const uint32_t RECORD_SIZES = sizeof(CachedInstruction) << 16 | sizeof(DependenceRecord);
+
+// Multiplies used by the hash, from xxHash
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+
+// Mixes one 64 bit word into a hash lane
+static inline uint64_t hashRound(uint64_t lane, uint64_t word) {
+    lane += word * PRIME2;
+    lane = (lane << 31) | (lane >> 33);
+    return lane * PRIME1;
+}
+
+// Returns a 64 bit hash of size bytes at data. Four independent lanes
+// keep the multiplier busy, so large inputs hash at memory speed.
+static uint64_t hashBytes(const uint8_t* data, size_t size) {
+    uint64_t lanes[4] = { PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1 };
+    size_t k = 0;
+    for (; k + 32 <= size; k += 32)
+        for (int l = 0; l < 4; l++) {
+            uint64_t word;
+            memcpy(&word, data + k + 8 * l, 8);
+            lanes[l] = hashRound(lanes[l], word);
+        }
+
+    uint64_t hash = size;
+    for (int l = 0; l < 4; l++)
+        hash = hashRound(hash ^ lanes[l], (uint64_t)l);
+    for (; k < size; k++)
+        hash = hashRound(hash, data[k]);
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+// Hashes the contents of the input file filename
+ParseCache::ParseCache(string filename) {
+    myCacheName = filename + ".pcache";
+    MappedFile input(filename);
+    myReadable = input.getData() != nullptr;
+    mySize = input.getSize();
+    myHash = myReadable ? hashBytes(input.getData(), mySize) : 0;
+}
+
+// Fills program and dependences from the sidecar. Returns false,
+// leaving both empty, if there is no sidecar for this input.
+bool ParseCache::load(vector<Instruction>& program, vector<DependenceRecord>& dependences) {
+    program.clear();
+    dependences.clear();
+    if (!myReadable)
+        return false;
+
+    MappedFile cache(myCacheName);
+    const uint8_t* data = cache.getData();
+    if (!data || cache.getSize() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != VERSION || header.recordSizes != RECORD_SIZES)
+        return false;
+    if (header.inputHash != myHash || header.inputSize != mySize)
+        return false;
+
+    // Every part has to fit exactly, so a cut off sidecar is never used
+    uint64_t size = cache.getSize() - sizeof(CacheHeader);
+    if (header.numInstructions > size / sizeof(CachedInstruction))
+        return false;
+    size -= header.numInstructions * sizeof(CachedInstruction);
+    if (header.numDependences > size / sizeof(DependenceRecord))
+        return false;
+    size -= header.numDependences * sizeof(DependenceRecord);
+    if (header.assemblyBytes != size)
+        return false;
+
+    const CachedInstruction* instructions = (const CachedInstruction*)(data + sizeof(CacheHeader));
+    const DependenceRecord* records = (const DependenceRecord*)(instructions + header.numInstructions);
+    const char* assembly = (const char*)(records + header.numDependences);
+    const char* assemblyEnd = assembly + header.assemblyBytes;
+
+    program.resize(header.numInstructions);
+    for (uint64_t k = 0; k < header.numInstructions; k++) {
+        const CachedInstruction& c = instructions[k];
+        if (c.assemblyLength > (uint64_t)(assemblyEnd - assembly) || c.opcode < 0 || c.opcode >= UNDEFINED) {
+            program.clear();
+            return false;
+        }
+        program[k].setValues((Opcode)c.opcode, c.rs, c.rt, c.rd, c.immediate);
+        program[k].setAssembly(string(assembly, c.assemblyLength));
+        assembly += c.assemblyLength;
+    }
+    dependences.assign(records, records + header.numDependences);
+    return true;
+}
+
+// Writes the sidecar for program and its dependences. Returns false
+// if it could not be written; the input is still simulated.
+bool ParseCache::save(vector<Instruction>& program, vector<DependenceRecord>& dependences) {
+    if (!myReadable)
+        return false;
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.recordSizes = RECORD_SIZES;
+    header.inputHash = myHash;
+    header.inputSize = mySize;
+    header.numInstructions = program.size();
+    header.numDependences = dependences.size();
+
+    vector<CachedInstruction> instructions(program.size());
+    string assembly;
+    for (unsigned int k = 0; k < program.size(); k++) {
+        CachedInstruction& c = instructions[k];
+        memset(&c, 0, sizeof(c));
+        c.opcode = program[k].getOpcode();
+        c.rs = program[k].getRS();
+        c.rt = program[k].getRT();
+        c.rd = program[k].getRD();
+        c.immediate = program[k].getImmediate();
+        string text = program[k].getAssembly();
+        c.assemblyLength = text.length();
+        assembly += text;
+    }
+    header.assemblyBytes = assembly.length();
+
+    // Write somewhere else first, so a run that reads the sidecar
+    // meanwhile never sees half of it
+    string temporary = myCacheName + ".tmp";
+    ofstream out(temporary.c_str(), ios::binary | ios::trunc);
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)instructions.data(), instructions.size() * sizeof(CachedInstruction));
+    out.write((const char*)dependences.data(), dependences.size() * sizeof(DependenceRecord));
+    out.write(assembly.data(), assembly.length());
+    out.close();
+
+    if (out.fail() || rename(temporary.c_str(), myCacheName.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
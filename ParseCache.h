@@ -0,0 +1,55 @@
+// Palmer Robins
+
+#ifndef __PARSECACHE_H__
+#define __PARSECACHE_H__
+
+#include "DependencyChecker.h"
+#include "Instruction.h"
+#include "MappedFile.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * ParseCache keeps the parsed form of an input file in a sidecar file
+ * next to it, named after it with ".pcache" added. The sidecar holds the
+ * predecoded instructions, their assembly strings and every dependence
+ * between them, and is keyed by a hash of the input's contents and the
+ * cache format version, so an edited input or a newer PIPESIM simply
+ * writes it again. Only runs given --parse-cache use it, since the sidecar
+ * is written wherever the input is.
+ */
+class ParseCache {
+
+    public:
+
+        // Bump whenever the parsers, the dependence checker or the layout
+        // below change what a cache would hold
+        static const uint32_t VERSION = 6;
+
+        // Hashes the contents of the input file filename
+        ParseCache(string filename);
+
+        // Returns true if the input file could be read
+        bool isReadable() { return myReadable; }
+
+        // Fills program and dependences from the sidecar. Returns false,
+        // leaving both empty, if there is no sidecar for this input.
+        bool load(vector<Instruction>& program, vector<DependenceRecord>& dependences);
+
+        // Writes the sidecar for program and its dependences. Returns false
+        // if it could not be written; the input is still simulated.
+        bool save(vector<Instruction>& program, vector<DependenceRecord>& dependences);
+
+    private:
+
+        string myCacheName;
+        uint64_t myHash; // of the input's contents
+        uint64_t mySize; // of the input
+        bool myReadable;
+};
+
+#endif
@@ -0,0 +1,38 @@
+// Palmer Robins
+
+#ifndef __PARSEERROR_H__
+#define __PARSEERROR_H__
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A line of an input file that could not be parsed
+struct ParseError {
+    long long line; // counting from 1
+    string message;
+};
+
+// Splits the size bytes at data into at most numChunks pieces of whole
+// lines. Returns where each piece starts, followed by size, so piece c
+// is data[bounds[c]] up to data[bounds[c + 1]].
+inline vector<size_t> splitAtLines(const char* data, size_t size, int numChunks) {
+    vector<size_t> bounds(1, 0);
+    for (int c = 1; c < numChunks; c++) {
+        size_t guess = size / numChunks * c;
+        if (guess <= bounds.back())
+            continue;
+        const char* newline = (const char*)memchr(data + guess, '\n', size - guess);
+        if (newline == nullptr)
+            break;
+        size_t start = newline - data + 1;
+        if (start > bounds.back() && start < size)
+            bounds.push_back(start);
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+#endif
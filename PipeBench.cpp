@@ -0,0 +1,273 @@
+// Palmer Robins
+
+#include "Arena.h"
+#include "ASMParser.h"
+#include "BinaryParser.h"
+#include "DependencyChecker.h"
+#include "OpcodeTable.h"
+#include "Pipeline.h"
+#include "RegisterTable.h"
+#include "TraceFile.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+using namespace std;
+
+/**
+ * This file times the components of PIPESIM one at a time, so a slower
+ * run can be traced to the part that got slower. Each benchmark repeats
+ * one operation for a fraction of a second and reports the nanoseconds
+ * and heap allocations it takes per operation. Name part of a benchmark
+ * on the command line to run only the ones whose names contain it.
+ */
+
+// Heap allocations made while a benchmark is being timed
+static atomic<long long> allocations(0);
+static atomic<bool> counting(false);
+
+void* operator new(size_t size) {
+    if (counting.load(memory_order_relaxed))
+        allocations.fetch_add(1, memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+// Calls the private parts of the parsers that are timed on their own
+struct BenchmarkAccess {
+    static void getTokens(ASMParser& parser, string& line, string& opcode, string* operand, int& numOperands) {
+        parser.getTokens(line, opcode, operand, numOperands);
+    }
+    static bool decode(BinaryParser& parser, Instruction& i, Opcode opcode, string& line) {
+        return parser.decode(i, opcode, line);
+    }
+};
+
+/**
+ * BenchTimer measures one benchmark. Setup that should not count is
+ * wrapped in pause and resume.
+ */
+class BenchTimer {
+
+    public:
+
+        BenchTimer() { myElapsed = 0; myRunning = false; }
+
+        // Starts or restarts the clock and the allocation count
+        void resume() {
+            myStart = chrono::steady_clock::now();
+            myRunning = true;
+            counting.store(true);
+        }
+
+        // Stops the clock and the allocation count
+        void pause() {
+            counting.store(false);
+            myElapsed += chrono::duration<double>(chrono::steady_clock::now() - myStart).count();
+            myRunning = false;
+        }
+
+        // Returns the seconds timed so far
+        double elapsed() {
+            if (!myRunning)
+                return myElapsed;
+            return myElapsed + chrono::duration<double>(chrono::steady_clock::now() - myStart).count();
+        }
+
+    private:
+
+        chrono::steady_clock::time_point myStart;
+        double myElapsed;
+        bool myRunning;
+};
+
+// Seconds each benchmark runs for
+static const double BENCH_SECONDS = 0.25;
+
+// Only benchmarks whose names contain this run
+static string filter;
+
+// Runs body, which performs opsPerCall operations each call, until it has
+// been timed for BENCH_SECONDS, then prints the cost of one operation
+template <class Body>
+static void measure(string name, long long opsPerCall, Body body) {
+    if (name.find(filter) == string::npos)
+        return;
+
+    BenchTimer timer;
+    allocations.store(0);
+    long long calls = 0;
+    while (timer.elapsed() < BENCH_SECONDS) {
+        timer.resume();
+        body(timer);
+        timer.pause();
+        calls++;
+    }
+
+    double ops = (double)calls * opsPerCall;
+    cout << left << setw(36) << name << right << fixed << setprecision(1);
+    cout << setw(12) << 1e9 * timer.elapsed() / ops << " ns/op";
+    cout << setw(10) << setprecision(2) << allocations.load() / ops << " allocs/op" << endl;
+}
+
+// Keeps the compiler from dropping work whose result is never used
+static volatile long long sink;
+
+// Returns a program of count random instructions, the same mix the
+// simulator is usually given, as assembly text
+static string makeProgram(int count) {
+    srand(1);
+    ostringstream text;
+    for (int k = 0; k < count; k++) {
+        int a = rand() % 8, b = rand() % 8, c = rand() % 8;
+        switch (rand() % 10) {
+        case 0: text << "add $" << a << ", $" << b << ", $" << c; break;
+        case 1: text << "addi $" << a << ", $" << b << ", " << rand() % 50; break;
+        case 2: text << "xor $" << a << ", $" << b << ", $" << c; break;
+        case 3: text << "mult $" << a << ", $" << b; break;
+        case 4: text << "mflo $" << a; break;
+        case 5: text << "sll $" << a << ", $" << b << ", " << rand() % 32; break;
+        case 6: text << "slt $" << a << ", $" << b << ", $" << c; break;
+        case 7: text << "slti $" << a << ", $" << b << ", " << rand() % 50; break;
+        case 8: text << "lb $" << a << ", " << rand() % 100 << "($" << b << ")"; break;
+        default: text << "beq $" << a << ", $" << b << ", 2"; break;
+        }
+        text << "\n";
+    }
+    return text.str();
+}
+
+// Returns the 32 '0' and '1' characters encoding i
+static string encodeLine(Instruction& i) {
+    uint32_t word = encodeInstruction(i);
+    string line(32, '0');
+    for (int bit = 0; bit < 32; bit++)
+        if (word & (1u << (31 - bit)))
+            line[bit] = '1';
+    return line;
+}
+
+// Times runPipeline on model, built fresh each call from program in an
+// arena that is reused from call to call, as the simulator does
+template <class PipelineType>
+static void measurePipeline(string name, vector<Instruction>& program, PipelineType* (*create)()) {
+    ostringstream discard;
+    Arena arena;
+    measure(name, program.size(), [&](BenchTimer& timer) {
+        timer.pause();
+        arena.reset();
+        ArenaScope scope(&arena);
+        PipelineType* model = create();
+        for (unsigned int k = 0; k < program.size(); k++)
+            model->addInstruction(program[k]);
+        streambuf* console = cout.rdbuf(discard.rdbuf());
+        timer.resume();
+        model->runPipeline();
+        timer.pause();
+        cout.rdbuf(console);
+        discard.str("");
+        delete model;
+        timer.resume();
+    });
+}
+
+static Pipeline* createIdeal() { return new Pipeline(); }
+static StallPipeline* createStall() { return new StallPipeline(); }
+static ForwardPipeline* createForward() { return new ForwardPipeline(); }
+static SuperscalarPipeline* createSuperscalar() { return new SuperscalarPipeline(4); }
+static OutOfOrderPipeline* createOutOfOrder() { return new OutOfOrderPipeline(32, 16, 4); }
+
+int main(int argc, char* argv[]) {
+    if (argc > 1)
+        filter = argv[1];
+
+    const int PROGRAM_SIZE = 4096;
+    istringstream text(makeProgram(PROGRAM_SIZE));
+    ASMParser parser(text);
+    vector<Instruction> program;
+    for (Instruction i = parser.getNextInstruction(); i.getOpcode() != UNDEFINED; i = parser.getNextInstruction())
+        program.push_back(i);
+
+    vector<string> lines, encodings, mnemonics;
+    for (unsigned int k = 0; k < program.size(); k++) {
+        lines.push_back(program[k].getAssembly());
+        encodings.push_back(encodeLine(program[k]));
+        mnemonics.push_back(lines.back().substr(0, lines.back().find(' ')));
+    }
+    vector<string> registers;
+    for (int r = 0; r < NumRegisters; r++)
+        registers.push_back("$" + to_string(r));
+
+    RegisterTable registerTable;
+    measure("RegisterTable::getNum", registers.size(), [&](BenchTimer& timer) {
+        for (unsigned int r = 0; r < registers.size(); r++)
+            sink = sink + registerTable.getNum(registers[r]);
+    });
+
+    OpcodeTable opcodes;
+    measure("OpcodeTable::getOpcode", mnemonics.size(), [&](BenchTimer& timer) {
+        for (unsigned int k = 0; k < mnemonics.size(); k++)
+            sink = sink + opcodes.getOpcode(mnemonics[k]);
+    });
+
+    measure("OpcodeTable::getOpcode_fromBinary", encodings.size(), [&](BenchTimer& timer) {
+        for (unsigned int k = 0; k < encodings.size(); k++)
+            sink = sink + opcodes.getOpcode_fromBinary(encodings[k].substr(0, 6), encodings[k].substr(26));
+    });
+
+    istringstream empty("");
+    ASMParser tokenizer(empty);
+    measure("ASMParser::getTokens", lines.size(), [&](BenchTimer& timer) {
+        for (unsigned int k = 0; k < lines.size(); k++) {
+            string opcode;
+            string operand[80];
+            int numOperands = 0;
+            BenchmarkAccess::getTokens(tokenizer, lines[k], opcode, operand, numOperands);
+            sink = sink + numOperands;
+        }
+    });
+
+    BinaryParser decoder;
+    vector<Opcode> decodedOpcodes;
+    for (unsigned int k = 0; k < program.size(); k++)
+        decodedOpcodes.push_back(program[k].getOpcode());
+    measure("BinaryParser::decode", encodings.size(), [&](BenchTimer& timer) {
+        for (unsigned int k = 0; k < encodings.size(); k++) {
+            Instruction i;
+            sink = sink + BenchmarkAccess::decode(decoder, i, decodedOpcodes[k], encodings[k]);
+        }
+    });
+
+    Arena arena;
+    measure("DependencyChecker::addInstruction", program.size(), [&](BenchTimer& timer) {
+        timer.pause();
+        arena.reset();
+        ArenaScope scope(&arena);
+        DependencyChecker* checker = new DependencyChecker();
+        timer.resume();
+        for (unsigned int k = 0; k < program.size(); k++)
+            checker->addInstruction(program[k]);
+        timer.pause();
+        delete checker;
+        timer.resume();
+    });
+
+    measurePipeline<Pipeline>("Pipeline::runPipeline", program, createIdeal);
+    measurePipeline<StallPipeline>("StallPipeline::runPipeline", program, createStall);
+    measurePipeline<ForwardPipeline>("ForwardPipeline::runPipeline", program, createForward);
+    measurePipeline<SuperscalarPipeline>("SuperscalarPipeline::runPipeline", program, createSuperscalar);
+    measurePipeline<OutOfOrderPipeline>("OutOfOrderPipeline::runPipeline", program, createOutOfOrder);
+
+    return 0;
+}
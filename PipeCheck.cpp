@@ -0,0 +1,172 @@
+// Palmer Robins
+
+#include "ASMParser.h"
+#include "Executor.h"
+#include "OpcodeTable.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+/**
+ * This file checks the parts of PIPESIM that have two implementations
+ * of the same thing against each other on random programs. The
+ * translated executor must commit the same instructions and leave the
+ * same registers as the interpreter. Give the number of programs to
+ * try on the command line; the default is PROGRAMS.
+ *
+ * "PIPECHECK --generate count seed" prints a random listing of count
+ * instructions instead, for "make check" to run every timing engine on.
+ */
+
+// Programs tried when none is given
+static const int PROGRAMS = 500;
+
+// Step limits each program is run to, so budgets that run out inside a
+// block, at a block's end and after many loop trips are all covered
+static const long long STEP_LIMITS[] = { 5, 63, 1000, 50000 };
+
+// Returns a random program of 5 to 40 instructions as assembly text.
+// Branches and jumps go anywhere in or just past the program, so many
+// of them loop until the step limit stops them.
+static string makeLoopingProgram(unsigned int seed) {
+    srand(seed);
+    int count = 5 + rand() % 36;
+    ostringstream text;
+    for (int k = 0; k < count; k++) {
+        int a = rand() % 8, b = rand() % 8, c = rand() % 8;
+        switch (rand() % 12) {
+        case 0: text << "add $" << a << ", $" << b << ", $" << c; break;
+        case 1: text << "addi $" << a << ", $" << b << ", " << rand() % 601 - 300; break;
+        case 2: text << "xor $" << a << ", $" << b << ", $" << c; break;
+        case 3: text << "mult $" << a << ", $" << b; break;
+        case 4: text << "mflo $" << a; break;
+        case 5: text << "sll $" << a << ", $" << b << ", " << rand() % 32; break;
+        case 6: text << "slt $" << a << ", $" << b << ", $" << c; break;
+        case 7: text << "slti $" << a << ", $" << b << ", " << rand() % 601 - 300; break;
+        case 8: text << "lb $" << a << ", " << rand() % 201 << "($" << b << ")"; break;
+        case 9: text << "j " << rand() % (count + 2); break;
+        default: text << "beq $" << a << ", $" << b << ", " << rand() % (count + 3) - k - 2; break;
+        }
+        text << "\n";
+    }
+    return text.str();
+}
+
+// Returns a random listing of count instructions as assembly text, with
+// forward branches only, so it can also be executed to its end
+static string makeListing(int count, unsigned int seed) {
+    srand(seed);
+    ostringstream text;
+    for (int k = 0; k < count; k++) {
+        int a = rand() % 8, b = rand() % 8, c = rand() % 8;
+        switch (rand() % 10) {
+        case 0: text << "add $" << a << ", $" << b << ", $" << c; break;
+        case 1: text << "addi $" << a << ", $" << b << ", " << rand() % 50; break;
+        case 2: text << "xor $" << a << ", $" << b << ", $" << c; break;
+        case 3: text << "mult $" << a << ", $" << b; break;
+        case 4: text << "mflo $" << a; break;
+        case 5: text << "sll $" << a << ", $" << b << ", " << rand() % 32; break;
+        case 6: text << "slt $" << a << ", $" << b << ", $" << c; break;
+        case 7: text << "slti $" << a << ", $" << b << ", " << rand() % 50; break;
+        case 8: text << "lb $" << a << ", " << rand() % 100 << "($" << b << ")"; break;
+        default: text << "beq $" << a << ", $" << b << ", " << 1 + rand() % 4; break;
+        }
+        text << "\n";
+    }
+    return text.str();
+}
+
+// Loads program into executor over the same memory contents every run
+static void prepare(Executor& executor, vector<Instruction>& program) {
+    executor.loadProgram(program);
+    for (int k = 0; k < 4096; k++)
+        executor.getMemory().writeByte(k * 7, k * 13);
+}
+
+// Returns true if the two executors stopped in the same state
+static bool sameState(Executor& a, Executor& b) {
+    if (a.getPC() != b.getPC() || a.getHI() != b.getHI() || a.getLO() != b.getLO())
+        return false;
+    for (int r = 0; r < NumRegisters; r++)
+        if (a.getRegister((Register)r) != b.getRegister((Register)r))
+            return false;
+    return true;
+}
+
+// Runs program to each step limit interpreted, translated with block
+// logging and translated without it. Returns false and says why if any
+// two runs disagree.
+static bool checkTranslator(vector<Instruction>& program, string& failure) {
+    for (unsigned int s = 0; s < sizeof(STEP_LIMITS) / sizeof(STEP_LIMITS[0]); s++) {
+        long long limit = STEP_LIMITS[s];
+        Executor interpreted, logged, unlogged;
+        prepare(interpreted, program);
+        prepare(logged, program);
+        prepare(unlogged, program);
+
+        vector<int> committed;
+        long long steps = interpreted.run(limit, &committed);
+
+        vector<BlockRecord> blocks;
+        long long loggedSteps = logged.runTranslated(limit, &blocks);
+        vector<int> loggedCommitted;
+        for (unsigned int b = 0; b < blocks.size(); b++)
+            for (uint32_t k = 0; k < blocks[b].length; k++)
+                loggedCommitted.push_back(blocks[b].startPC + k);
+
+        long long unloggedSteps = unlogged.runTranslated(limit, nullptr);
+
+        ostringstream where;
+        where << " after at most " << limit << " steps";
+        if (loggedSteps != steps || unloggedSteps != steps)
+            failure = "committed a different number of instructions" + where.str();
+        else if (loggedCommitted != committed)
+            failure = "committed different instructions" + where.str();
+        else if (!sameState(interpreted, logged) || !sameState(interpreted, unlogged))
+            failure = "stopped in a different state" + where.str();
+        else
+            continue;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--generate") {
+        if (argc != 4 || atoi(argv[2]) < 1) {
+            cerr << "--generate needs a number of instructions and a seed." << endl;
+            return 1;
+        }
+        cout << makeListing(atoi(argv[2]), strtoul(argv[3], nullptr, 10));
+        return 0;
+    }
+
+    int programs = (argc > 1) ? atoi(argv[1]) : PROGRAMS;
+
+    int failures = 0;
+    for (int p = 0; p < programs; p++) {
+        string text = makeLoopingProgram(p + 1);
+        istringstream in(text);
+        ASMParser parser(in);
+        vector<Instruction> program;
+        for (Instruction i = parser.getNextInstruction(); i.getOpcode() != UNDEFINED; i = parser.getNextInstruction())
+            program.push_back(i);
+
+        string failure;
+        if (!parser.isFormatCorrect() || program.empty())
+            failure = "could not be parsed";
+        else if (!checkTranslator(program, failure))
+            failure = "translated " + failure;
+        else
+            continue;
+
+        cerr << "Random program " << p + 1 << " " << failure << ":" << endl << text;
+        failures++;
+    }
+
+    cout << "Translator: " << programs - failures << " of " << programs << " random programs match the interpreter" << endl;
+    return failures ? 1 : 0;
+}
@@ -1,16 +1,67 @@
 // Name: Palmer Robins
 
 #include "Pipeline.h"
+#include "ParallelScan.h"
+#include "SteadyState.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_DISPATCH 1
+#else
+#define HAVE_AVX2_DISPATCH 0
+#endif
 
 // The "ideal" pipeline constructor
 Pipeline::Pipeline() {
 
+    // Table lines and dependences go in the caller's arena, or in one of our own
+    myArena = Arena::current();
+    myOwnArena = nullptr;
+    if (myArena == nullptr) {
+        myOwnArena = new Arena();
+        myArena = myOwnArena;
+    }
+
     // Initialize the dependency checker
+    ArenaScope scope(myArena);
     checker = new DependencyChecker();
 
     cycleCounter = 0;
     instructionCounter = 0;
 
+    myPredictor = nullptr;
+    myWarmPredictor = nullptr;
+    myFlushPenalty = 0;
+
+    myCache = nullptr;
+    myWarmCache = nullptr;
+    myMisses = nullptr;
+
+    myReportIPC = false;
+    myExtrapolate = true;
+    myBlockCache = nullptr;
+    myTimeline = nullptr;
+
+    mySkipped = 0;
+    myLoadsSkipped = 0;
+    myWarmup = 0;
+    myWarmupEnd = 0;
+
+    // A reader waits at most two cycles plus the longest latency for a
+    // result, and an instruction for its unit at most the longest interval
+    myHazardWindow = 2;
+    for (int u = 0; u < NUM_UNITS; u++)
+        myUnitInterval[u] = 1;
+    for (int op = 0; op < UNDEFINED; op++) {
+        int interval = myOpcodes.getInitiationInterval((Opcode)op);
+        FunctionalUnit unit = unitOf((Opcode)op);
+        myUnitInterval[unit] = max(myUnitInterval[unit], interval);
+        myHazardWindow = max(myHazardWindow, max(1 + myOpcodes.getLatency((Opcode)op), interval - 1));
+    }
+
     // Each stage begins as empty
     initializeStages();
 }
@@ -18,42 +69,276 @@ Pipeline::Pipeline() {
 // Pipeline deconstructor
 Pipeline::~Pipeline() {
     delete checker;
+    delete myPredictor;
+    delete myWarmPredictor;
+    delete myCache;
+    delete myWarmCache;
+    delete myMisses;
+    delete myOwnArena;
 }
 
 // Add a given instruction to the list of instructions
 // @param i - The instruction to add to myInstructions
 void Pipeline::addInstruction(Instruction i) {
+    // Listed instructions follow one another, so only jumps redirect fetch
+    addInstruction(i, myInstructions.size(), i.getOpcode() == J);
+}
+
+// Add an instruction that was fetched from instruction number pc.
+// taken is true if the instruction redirected fetch.
+void Pipeline::addInstruction(Instruction i, int pc, bool taken) {
     //Add an instruction to our instr vector
     myInstructions.push_back(i);
+    myAddresses.push_back(pc);
+    myTaken.push_back(taken);
     //And to our dependency checker
     checker->addInstruction(i);
+
+    //And the registers it reads and writes, for the hazard checks
+    if (modelsDataHazards()) {
+        uint64_t readMask = 0, writeMask = 0;
+        unsigned int reads[2];
+        int numReads = checker->getReadRegisters(i, reads);
+        for (int r = 0; r < numReads; r++)
+            readMask |= 1ULL << reads[r];
+        unsigned int written = checker->getWriteRegister(i);
+        if (written < (unsigned int)NumDependenceRegisters)
+            writeMask = 1ULL << written;
+        myReadMasks.push_back(readMask);
+        myWriteMasks.push_back(writeMask);
+    }
+}
+
+// Fast forward past an instruction fetched from instruction number pc
+// without timing it. Only the predictor, the data cache and the
+// dependence checker see it.
+void Pipeline::skipInstruction(Instruction& i, int pc, bool taken) {
+    mySkipped++;
+    Opcode op = i.getOpcode();
+
+    // Timed instructions can depend on skipped ones
+    checker->addInstruction(i);
+
+    if (myWarmPredictor && modelsControlHazards() && (op == J || op == BEQ))
+        myWarmPredictor->resolve(pc, op, taken, branchTarget(i, pc), myFlushPenalty);
+
+    if (myCache && loadUseLag() > 0 && op == LB) {
+        uint32_t address = (myLoadsSkipped < myLoadAddresses.size()) ? myLoadAddresses[myLoadsSkipped] : i.getImmediate();
+        bool missed;
+        myWarmCache->access(address, false, missed);
+    }
+    if (op == LB)
+        myLoadsSkipped++;
+}
+
+// Charge BEQ and J with the cycles predictor loses on them, where a
+// mispredicted BEQ costs flushPenalty cycles. The pipeline takes
+// ownership of the predictor.
+void Pipeline::setPredictor(BranchPredictor* predictor, int flushPenalty) {
+    delete myPredictor;
+    delete myWarmPredictor;
+    myPredictor = nullptr;
+    myWarmPredictor = predictor;
+    myFlushPenalty = flushPenalty;
+}
+
+// Send each LB through cache, with numMSHRs misses allowed in flight.
+// A miss delays the instructions that use the loaded value. The
+// pipeline takes ownership of the cache.
+void Pipeline::setDataCache(DataCache* cache, int numMSHRs) {
+    delete myCache;
+    delete myWarmCache;
+    delete myMisses;
+    myWarmCache = cache;
+    myCache = cache->clone();
+    myMisses = new MissTracker(numMSHRs);
+}
+
+// Run every LB through the data cache in order, filling in the extra
+// cycles each one takes, and reset the miss timing state. Each run
+// starts from a copy of the cache as the skipped instructions left it.
+void Pipeline::computeMemoryCycles() {
+    myMemoryCycles.assign(myInstructions.size(), 0);
+    myMemoryLines.assign(myInstructions.size(), 0);
+    myMemoryMissed.assign(myInstructions.size(), false);
+    for (int r = 0; r < NumDependenceRegisters; r++)
+        myRegisterReady[r] = 0;
+    if (!myCache || loadUseLag() == 0)
+        return;
+
+    delete myCache;
+    myCache = myWarmCache->clone();
+    myMisses->clear();
+    unsigned int loads = myLoadsSkipped;
+    for (unsigned int k = 0; k < myInstructions.size(); k++) {
+        if (myInstructions[k].getOpcode() != LB)
+            continue;
+        uint32_t address = (loads < myLoadAddresses.size()) ? myLoadAddresses[loads] : myInstructions[k].getImmediate();
+        loads++;
+        bool missed;
+        myMemoryCycles[k] = myCache->access(address, false, missed);
+        myMemoryMissed[k] = missed;
+        myMemoryLines[k] = myCache->lineOf(address);
+    }
+}
+
+// Given an instruction number and the cycle it would leave the pipeline,
+// returns the cycle it actually leaves once cache misses are accounted for
+long long Pipeline::applyMemoryTiming(int instrNumber, long long cycle) {
+    if (!myCache || loadUseLag() == 0)
+        return cycle;
+    Instruction& i = myInstructions[instrNumber];
+
+    // Wait for any loaded value this instruction reads
+    unsigned int reads[2];
+    int numReads = checker->getReadRegisters(i, reads);
+    for (int r = 0; r < numReads; r++)
+        if (myRegisterReady[reads[r]] > cycle)
+            cycle = myRegisterReady[reads[r]];
+
+    // BEQ does not really write a register, so it leaves the timing alone
+    unsigned int written = checker->getWriteRegister(i);
+    if (i.getOpcode() == BEQ || written >= (unsigned int)NumDependenceRegisters)
+        return cycle;
+
+    if (i.getOpcode() != LB) {
+        myRegisterReady[written] = 0;
+        return cycle;
+    }
+
+    // The load reads the cache the cycle before it leaves. A miss needs a
+    // free MSHR, unless its line is already on the way.
+    long long start = cycle - 1;
+    long long arrival = start + myMemoryCycles[instrNumber];
+    if (myMemoryMissed[instrNumber])
+        arrival = myMisses->issue(myMemoryLines[instrNumber], start, myMemoryCycles[instrNumber]);
+    cycle = start + 1;
+    myRegisterReady[written] = arrival + 1 + loadUseLag();
+    return cycle;
+}
+
+// Fill in the cycles lost after each instruction to resolve branches
+// and jumps. Without a predictor every jump costs one cycle. Each run
+// starts from a copy of the predictor as the skipped instructions left it,
+// and its statistics cover only the instructions after the warm up.
+void Pipeline::computeControlCycles() {
+    myControlCycles.assign(myInstructions.size(), 0);
+    if (!modelsControlHazards())
+        return;
+    if (myWarmPredictor) {
+        delete myPredictor;
+        myPredictor = myWarmPredictor->clone();
+    }
+
+    for (unsigned int k = 0; k < myInstructions.size(); k++) {
+        if (myPredictor && k == (unsigned int)myWarmup)
+            myPredictor->clearStats();
+
+        Opcode op = myInstructions[k].getOpcode();
+        if (op != J && op != BEQ)
+            continue;
+
+        if (myPredictor == nullptr) {
+            if (op == J)
+                myControlCycles[k] = 1;
+            continue;
+        }
+
+        int pc = myAddresses[k];
+        myControlCycles[k] = myPredictor->resolve(pc, op, myTaken[k], branchTarget(myInstructions[k], pc), myFlushPenalty);
+    }
+}
+
+// Given a BEQ or J fetched from instruction number pc, returns the
+// instruction number it goes to when taken
+uint32_t Pipeline::branchTarget(Instruction& i, int pc) {
+    if (i.getOpcode() == J)
+        return i.getImmediate();
+    return pc + 1 + i.getImmediate();
 }
 
 // Print the pipeline, given the type of pipeline
 void Pipeline::printPipeline(string pipelineType) {
     cout << pipelineType << endl;
-    checker->printRAWDependences();
+    checker->printRAWDependences(mySkipped + myWarmup, 0);
     cout << "Instr#\tCompletionTime\tMnemonic" << endl;
     
-    for (unsigned int i = 0; i < instStrings.size(); i++)
+    // Warm up instructions have no line
+    for (unsigned int i = myWarmup; i < instStrings.size(); i++)
         cout << instStrings.at(i) << endl;
 
     // Print the total time taken in the pipeline
-    cout << "Total time is " << to_string(cycleCounter) << endl;
+    long long timed = cycleCounter - myWarmupEnd;
+    long long timedInstructions = max(0LL, (long long)instStrings.size() - myWarmup);
+    cout << "Total time is " << to_string(timed) << endl;
+    if (myReportIPC)
+        cout << "IPC is " << (double)timedInstructions / timed << endl;
+
+    // Report how well branches after the warm up were predicted
+    if (myPredictor && modelsControlHazards()) {
+        long long branches = myPredictor->getBranches();
+        long long misses = myPredictor->getMispredictions();
+        double accuracy = branches ? 100.0 * (branches - misses) / branches : 100.0;
+        double mpki = timedInstructions ? 1000.0 * misses / timedInstructions : 0.0;
+        cout << "Branch predictor " << myPredictor->getName() << ": " << branches << " branches, ";
+        cout << misses << " mispredicted, " << accuracy << "% accuracy, " << mpki << " MPKI" << endl;
+    }
+
+    // Report how the data cache did
+    if (myCache && loadUseLag() > 0)
+        myCache->printStats();
+
+    printReport();
     cout << endl;
 }
 
 // As an instruction leaves the pipeline,
 // construct the string to print
 void Pipeline::constructLine() {
-    Instruction complete = getWriteBack();
-    string line = to_string(instructionCounter);
-    line += "\t";
-    line += to_string(cycleCounter);
-    line += "\t|";
-    line += complete.getAssembly();
+    if (instructionCounter == myWarmup - 1)
+        myWarmupEnd = cycleCounter;
+    instStrings.push_back(formatLine(instructionCounter, cycleCounter));
+    if (myTimeline)
+        myTimeline->addInstruction(mySkipped + instructionCounter, myInstructions[instructionCounter].getAssembly(), cycleCounter);
     instructionCounter += 1;
-    instStrings.push_back(line);
+}
+
+// Writes value in decimal at out and returns how many characters it took.
+// Every line of the table goes through here, and snprintf took longer
+// than the in-order loops themselves.
+static int writeNumber(char* out, long long value) {
+    char digits[24];
+    int end = sizeof(digits);
+    bool negative = value < 0;
+    unsigned long long magnitude = negative ? -(unsigned long long)value : value;
+    do {
+        digits[--end] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (negative)
+        digits[--end] = '-';
+    memcpy(out, digits + end, sizeof(digits) - end);
+    return sizeof(digits) - end;
+}
+
+// Given an instruction number and its completion time,
+// construct the string to print
+const char* Pipeline::formatLine(int instrNumber, int completionTime) {
+    if (instrNumber < myWarmup)
+        return "";
+
+    // Times count from the end of warm up, and numbers from the start of the trace
+    char times[48];
+    int length = writeNumber(times, mySkipped + instrNumber);
+    times[length++] = '\t';
+    length += writeNumber(times + length, completionTime - myWarmupEnd);
+    times[length++] = '\t';
+    times[length++] = '|';
+    const string& assembly = myInstructions[instrNumber].getAssembly();
+    char* line = (char*)myArena->allocate(length + assembly.size() + 1, 1);
+    memcpy(line, times, length);
+    memcpy(line + length, assembly.c_str(), assembly.size() + 1);
+    return line;
 }
 
 // Set the stages of the pipeline to null
@@ -66,151 +351,993 @@ void Pipeline::initializeStages() {
     inWriteBack = nullptr;
 }
 
-// Execute the pipeline simulation
-void Pipeline::runPipeline() {
-
-    numInstructions = myInstructions.size();
-
-    // Put the first instruction into the fetch stage
-    if (myInstructions.size() >0)
-        setFetch(&myInstructions.at(cycleCounter));
-    else {
-        cerr << "Instructions didn't read correctly. Check input file." << endl;
-        exit(1);
+#if HAVE_AVX2_DISPATCH
+// Finds the RAW dependences on the previous two instructions for
+// instructions begin to end - 1, four at a time
+__attribute__((target("avx2")))
+static int nearDependencesAVX2(const uint64_t* reads, const uint64_t* writes, uint8_t* near, int begin, int end) {
+    const __m256i zero = _mm256_setzero_si256();
+    int k = begin;
+    for (; k + 4 <= end; k += 4) {
+        __m256i r = _mm256_loadu_si256((const __m256i*)(reads + k));
+        __m256i r1 = _mm256_loadu_si256((const __m256i*)(reads + k - 1));
+        __m256i w1 = _mm256_loadu_si256((const __m256i*)(writes + k - 1));
+        __m256i w2 = _mm256_loadu_si256((const __m256i*)(writes + k - 2));
+        __m256i oneBack = _mm256_and_si256(r, w1);
+        __m256i twoBack = _mm256_andnot_si256(_mm256_or_si256(r1, w1), _mm256_and_si256(r, w2));
+        int ones = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(oneBack, zero))) & 0xF;
+        int twos = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(twoBack, zero))) & 0xF;
+        for (int j = 0; j < 4; j++)
+            near[k + j] = (uint8_t)(((ones >> j) & 1) | ((twos >> j) & 1) << 1);
     }
+    return k;
+}
 
-    // Simulate the pipeline
-    while (instructionCounter < numInstructions) {
-        
-        // Each loop iteration serves as a cycle
-        cycleCounter += 1;
+static bool haveAVX2() {
+    static const bool have = __builtin_cpu_supports("avx2");
+    return have;
+}
+#endif
 
-        // Not counting dependences, just move each instruction
-        // through the five cycles
-        if (inWriteBack)
-            constructLine(); // instr is leaving pipeline
-        if (inMemory)
-            setWriteBack(inMemory);
-        if (inExecute)
-            setMemory(inExecute);
-        if (inDecode)
-            setExecute(inDecode);
-        if (inFetch)
-            setDecode(inFetch);
+// Find the RAW dependences on the previous two instructions for the
+// whole trace in one pass over the register masks addInstruction made
+void Pipeline::computeRegisterMasks() {
+    int count = myReadMasks.size();
+    myNearRAW.assign(count, 0);
+    if (count < 2)
+        return;
 
-        // If the cycle counter is less than the total instr count,
-        // Keep inserting an instruction to fetch
-        if (cycleCounter < numInstructions)
-            setFetch(&myInstructions.at(cycleCounter));
+    // The checker only links a read to the last access of its register, so
+    // a write two back counts unless the instruction between touched the
+    // register too
+    const uint64_t* reads = myReadMasks.data();
+    const uint64_t* writes = myWriteMasks.data();
+    uint8_t* near = myNearRAW.data();
+    near[1] = (reads[1] & writes[0]) != 0;
+    int k = 2;
+#if HAVE_AVX2_DISPATCH
+    if (haveAVX2())
+        k = nearDependencesAVX2(reads, writes, near, k, count);
+#endif
+    for (; k < count; k++) {
+        uint64_t oneBack = reads[k] & writes[k - 1];
+        uint64_t twoBack = reads[k] & writes[k - 2] & ~(reads[k - 1] | writes[k - 1]);
+        near[k] = (uint8_t)((oneBack != 0) | (twoBack != 0) << 1);
     }
-    printPipeline("IDEAL:");
 }
 
-// Override the runPipeline method
-void StallPipeline::runPipeline() {
+// Given an instruction number, returns the cycles it stalls for RAW
+// dependences on recent instructions, as long as ForwardingPolicy
+// says. computeRegisterMasks must have run.
+template <class ForwardingPolicy>
+int Pipeline::rawCycles(int instrNumber) {
+    const uint64_t* reads = myReadMasks.data();
+    const uint64_t* writes = myWriteMasks.data();
+    uint64_t pending = reads[instrNumber]; // registers read that no closer instruction touched
+    if (pending == 0)
+        return 0;
+    int stalls = 0;
+    int near = myNearRAW[instrNumber];
+    for (int distance = 1; distance <= myHazardWindow && distance <= instrNumber && pending; distance++) {
+        int prevNumber = instrNumber - distance;
+        bool raw = (distance <= 2) ? (near >> (distance - 1)) & 1 : (pending & writes[prevNumber]) != 0;
+        if (raw) {
+            Opcode op = myInstructions[prevNumber].getOpcode();
+            stalls += ForwardingPolicy::dependenceCycles(myOpcodes.getLatency(op), op == LB, distance);
+        }
+        pending &= ~(reads[prevNumber] | writes[prevNumber]);
+    }
+    return stalls;
+}
+
+// Move each instruction through the five stages a cycle at a time,
+// charging the stalls HazardPolicy detects for as long as
+// ForwardingPolicy says, and print the table. Every scalar model
+// runs a copy of this loop specialized to its policies.
+template <class HazardPolicy, class ForwardingPolicy>
+void Pipeline::runInOrder() {
 
     numInstructions = myInstructions.size();
-    instrCycled = cycleCounter;
+    if (numInstructions == 0) {
+        cerr << "Instructions didn't read correctly. Check input file." << endl;
+        exit(1);
+    }
+    if (HazardPolicy::DETECTS_HAZARDS) {
+        computeControlCycles();
+        computeMemoryCycles();
+        computeRegisterMasks();
+    }
+    Instruction* instructions = myInstructions.data();
+    const int* controlCycles = myControlCycles.data();
+
+    bool timesMemory = HazardPolicy::DETECTS_HAZARDS && myCache && loadUseLag() > 0;
+    instStrings.reserve(numInstructions);
+
+    // What the loop asks of each opcode, looked up once
+    int interval[UNDEFINED];
+    FunctionalUnit unitFor[UNDEFINED];
+    for (int op = 0; op < UNDEFINED; op++) {
+        interval[op] = myOpcodes.getInitiationInterval((Opcode)op);
+        unitFor[op] = unitOf((Opcode)op);
+    }
+
+    // The cycle each functional unit that is not pipelined can take
+    // another instruction, on a clock that leaves out waits for cache
+    // misses so every engine charges the same unit stalls
+    long long unitFreeCycle[NUM_UNITS] = { 0, 0, 0, 0 };
+    long long memoryWait = 0;
 
-    list<Dependence> dependences = checker->getDependencies();
-    list<Dependence>::iterator it;
-    
     // Put the first instruction into the fetch stage
-    setFetch(&myInstructions.at(instrCycled));
+    int fetched = cycleCounter;
+    inFetch = &instructions[fetched];
 
     // Simulate the pipeline
     while (instructionCounter < numInstructions) {
+
+        // Each loop iteration serves as a cycle
         cycleCounter += 1;
-        instrCycled += 1;
+        fetched += 1;
 
         // Determine the stall length as we leave the pipeline
         if (inWriteBack) {
-            for (it = dependences.begin(); it != dependences.end(); it++) {
-                // There is a dependence where the instr in write back is the currInstr
-                if (it->currInstruction == getWriteBack().getAssembly()) {
-                    int currInstNumber = it->currentInstructionNumber;
-                    int prevInstNumber = it->previousInstructionNumber;
-                    // If the instructions are separated
-                    if (currInstNumber - prevInstNumber == 2)
-                        cycleCounter += 1;
-                    // The instructions are back to back
-                    else if (currInstNumber - prevInstNumber == 1)
-                        cycleCounter += 2;
+            if (HazardPolicy::DETECTS_HAZARDS) {
+                // Stall for results of recent instructions not ready yet
+                cycleCounter += rawCycles<ForwardingPolicy>(instructionCounter);
+
+                // Wait for the functional unit if it is still busy
+                FunctionalUnit unit = unitFor[inWriteBack->getOpcode()];
+                if (myUnitInterval[unit] > 1) {
+                    cycleCounter += max(0LL, unitFreeCycle[unit] - (cycleCounter - memoryWait));
+                    unitFreeCycle[unit] = cycleCounter - memoryWait + interval[inWriteBack->getOpcode()];
+                }
+
+                // Wait for loaded values that missed in the cache
+                if (timesMemory) {
+                    long long ready = cycleCounter;
+                    cycleCounter = applyMemoryTiming(instructionCounter, cycleCounter);
+                    memoryWait += cycleCounter - ready;
                 }
             }
             constructLine(); // instr is leaving pipeline
-            // Account for time taken to determine jump location
-            if (getWriteBack().getInstType() == JTYPE)
-                cycleCounter += 1;
+
+            // Account for time taken to determine branch and jump locations
+            if (HazardPolicy::DETECTS_HAZARDS)
+                cycleCounter += controlCycles[instructionCounter - 1];
         }
 
         // Advance stages
-        if (inMemory)
-            setWriteBack(inMemory);
-        if (inExecute)
-            setMemory(inExecute);
-        if (inDecode)
-            setExecute(inDecode);
-        if (inFetch)
-            setDecode(inFetch);
+        inWriteBack = inMemory;
+        inMemory = inExecute;
+        inExecute = inDecode;
+        inDecode = inFetch;
 
         // Insert next instruction, if necessary
-        if (instrCycled < numInstructions)
-            setFetch(&myInstructions.at(instrCycled));
+        inFetch = (fetched < numInstructions) ? &instructions[fetched] : nullptr;
     }
-    printPipeline("STALL:");
+    printPipeline(pipelineName());
+}
+
+// Execute the pipeline simulation
+void Pipeline::runPipeline() {
+    runInOrder<IgnoreHazards, FullForwarding>();
+}
+
+// Override the runPipeline method
+void StallPipeline::runPipeline() {
+    runInOrder<DetectHazards, NoForwarding>();
 }
 
 // Override the runPipeline method
 void ForwardPipeline::runPipeline() {
+    runInOrder<DetectHazards, FullForwarding>();
+}
+
+// Superscalar pipeline constructor. Every unit kind but the ALU
+// starts with one unit, and there are width ALUs.
+SuperscalarPipeline::SuperscalarPipeline(int width) : Pipeline() {
+    myWidth = width;
+    myReportIPC = true;
+    setUnits(width, 1, 1, 1);
+}
+
+// Set how many of each functional unit a cycle can use
+void SuperscalarPipeline::setUnits(int alus, int multipliers, int memoryPorts, int branchUnits) {
+    myUnits[ALU_UNIT] = alus;
+    myUnits[MULT_UNIT] = multipliers;
+    myUnits[MEMORY_UNIT] = memoryPorts;
+    myUnits[BRANCH_UNIT] = branchUnits;
+}
+
+// Given an opcode, returns the functional unit it issues to
+FunctionalUnit Pipeline::unitOf(Opcode op) {
+    if (op == MULT)
+        return MULT_UNIT;
+    if (op == LB)
+        return MEMORY_UNIT;
+    if (op == J || op == BEQ)
+        return BRANCH_UNIT;
+    return ALU_UNIT;
+}
+
+// Override the runPipeline method
+void SuperscalarPipeline::runPipeline() {
 
     numInstructions = myInstructions.size();
-    instrCycled = cycleCounter;
+    if (numInstructions == 0) {
+        cerr << "Instructions didn't read correctly. Check input file." << endl;
+        exit(1);
+    }
+    computeControlCycles();
 
-    list<Dependence> dependences = checker->getDependencies();
-    list<Dependence>::iterator it;
+    // Registers are tracked as bitmasks, so checking an instruction against
+    // a whole bundle costs the same no matter how wide the bundle is
+    uint64_t bundleWrites = 0; // registers written by the bundle being formed
+    uint64_t bundleLoads = 0; // registers loaded by the bundle being formed
+    uint64_t lateLoads = 0; // registers loaded by the previous bundle, not ready yet
+    int bundleSize = 0;
+    long long unitFree[NUM_UNITS][MAX_WIDTH] = { { 0 } }; // cycle each unit can start another instruction
+    long long resultReady[NumDependenceRegisters] = { 0 }; // cycle a multi-cycle result can be read
+    long long issueCycle = 1; // the first instruction is fetched on cycle 1
+    long long redirect = -1; // extra cycles before the next bundle after a jump, or -1
 
-    // Put the first instruction into the fetch stage
-    setFetch(&myInstructions.at(instrCycled));
+    // Completion times so far, which repeat once a loop reaches a steady state
+    vector<long long> completion(numInstructions);
+    SteadyStateDetector steadyState(myAddresses, myTaken, myControlCycles);
 
-    // Simulate the pipeline
-    while (instructionCounter < numInstructions) {
-        cycleCounter += 1;
-        instrCycled += 1;
+    for (int k = 0; k < numInstructions; k++) {
+        if (myExtrapolate && steadyState.startsIteration(k)) {
+            // Everything but the bundle's cycle is already relative
+            vector<long long> state;
+            state.push_back(bundleWrites);
+            state.push_back(bundleLoads);
+            state.push_back(lateLoads);
+            state.push_back(bundleSize);
+            for (int u = 0; u < NUM_UNITS; u++)
+                for (int n = 0; n < numUnits(u); n++)
+                    state.push_back(max(unitFree[u][n] - issueCycle, 0LL));
+            for (int r = 0; r < NumDependenceRegisters; r++)
+                state.push_back(max(resultReady[r] - issueCycle, 0LL));
+            state.push_back(redirect);
 
-        // Determine any stalls here
-        if (inWriteBack) {
-            for (it = dependences.begin(); it != dependences.end(); it++) {
-                // There is a dependence where the instr in write back is the currInstr
-                if (it->currInstruction == getWriteBack().getAssembly()) {
-                    int currInstNumber = it->currentInstructionNumber;
-                    int prevInstNumber = it->previousInstructionNumber;
-                    // If the instructions are back to back
-                    // Memory instructions still require a stall
-                    if (currInstNumber - prevInstNumber == 1 && myInstructions[prevInstNumber].getOpcode() == LB) {
-                        cycleCounter += 1;
+            int period;
+            long long periodCycles;
+            int skip = steadyState.check(k, k, issueCycle, state, period, periodCycles);
+            for (int j = k; j < k + skip; j++) {
+                completion[j] = completion[j - period] + periodCycles;
+                cycleCounter = completion[j];
+                instructionCounter = j;
+                constructLine();
+            }
+            // period is only set when there is something to skip
+            long long shift = (skip > 0) ? skip / period * periodCycles : 0;
+            issueCycle += shift;
+            for (int u = 0; u < NUM_UNITS; u++)
+                for (int n = 0; n < numUnits(u); n++)
+                    unitFree[u][n] += shift;
+            for (int r = 0; r < NumDependenceRegisters; r++)
+                resultReady[r] += shift;
+            k += skip;
+            if (k == numInstructions)
+                break;
+        }
+
+        Instruction& i = myInstructions[k];
+        FunctionalUnit unit = unitOf(i.getOpcode());
+
+        unsigned int regs[2];
+        int numReads = checker->getReadRegisters(i, regs);
+        uint64_t reads = 0;
+        long long operandsReady = 0; // when the multi-cycle results it reads are done
+        for (int r = 0; r < numReads; r++) {
+            reads |= 1ULL << regs[r];
+            operandsReady = max(operandsReady, resultReady[regs[r]]);
+        }
+        unsigned int written = checker->getWriteRegister(i);
+        uint64_t writes = (written < (unsigned int)NumDependenceRegisters) ? 1ULL << written : 0;
+
+        // Find a unit of the kind needed that is free this cycle
+        int free = -1;
+        long long firstFree = unitFree[unit][0];
+        for (int n = 0; n < numUnits(unit) && free < 0; n++) {
+            if (unitFree[unit][n] <= issueCycle)
+                free = n;
+            firstFree = min(firstFree, unitFree[unit][n]);
+        }
+
+        bool fits = redirect < 0 && bundleSize < myWidth && free >= 0 && operandsReady <= issueCycle
+            && ((reads | writes) & bundleWrites) == 0 && (reads & lateLoads) == 0;
+
+        // Start the next bundle
+        if (!fits) {
+            lateLoads = (redirect > 0) ? 0 : bundleLoads;
+            issueCycle += 1 + ((redirect > 0) ? redirect : 0);
+            // A loaded value is forwarded a cycle later than an ALU result
+            if (reads & lateLoads) {
+                issueCycle += 1;
+                lateLoads = 0;
+            }
+            // Wait out a busy unit and results still being computed
+            long long start = max(operandsReady, firstFree);
+            if (start > issueCycle) {
+                issueCycle = start;
+                lateLoads = 0;
+            }
+            bundleWrites = bundleLoads = 0;
+            bundleSize = 0;
+            redirect = -1;
+            for (free = 0; unitFree[unit][free] > issueCycle; free++)
+                ;
+        }
+
+        bundleSize++;
+        unitFree[unit][free] = issueCycle + myOpcodes.getInitiationInterval(i.getOpcode());
+        if (writes) {
+            int latency = myOpcodes.getLatency(i.getOpcode());
+            resultReady[written] = (latency > 1) ? issueCycle + latency : 0;
+        }
+        bundleWrites |= writes;
+        if (i.getOpcode() == LB)
+            bundleLoads |= writes;
+
+        // The instruction leaves write back four cycles after it is fetched
+        cycleCounter = issueCycle + 4;
+        completion[k] = cycleCounter;
+        instructionCounter = k;
+        constructLine();
+
+        // Fetch only continues past a taken branch or jump with a new bundle
+        if (myTaken[k] || myControlCycles[k] > 0)
+            redirect = myControlCycles[k];
+    }
+
+    cycleCounter += myControlCycles[numInstructions - 1];
+    printPipeline(pipelineName());
+}
+
+// Execute the pipeline simulation with the parallel engine. Each of
+// numThreads chunks of instructions is summarized by the cycles it takes,
+// the sums are scanned, and completion times are filled in per chunk.
+// Produces the same table as runPipeline.
+void Pipeline::runPipelineParallel(int numThreads) {
+
+    numInstructions = myInstructions.size();
+    if (numInstructions == 0) {
+        cerr << "Instructions didn't read correctly. Check input file." << endl;
+        exit(1);
+    }
+
+    // delta[k] is the number of cycles between instruction k-1 and
+    // instruction k leaving the pipeline
+    vector<int> delta(numInstructions);
+    vector<long long> chunkCycles(numThreads < 1 ? 1 : numThreads);
+
+    // Predictors and caches carry state from access to access, so these passes are serial
+    computeControlCycles();
+    computeMemoryCycles();
+    computeRegisterMasks();
+
+    // First pass: every chunk computes its own cycle deltas and summary.
+    // Hazards only look back a few instructions, so chunks need no entry state.
+    parallelForChunks(numInstructions, chunkCycles.size(), [&](int chunk, int begin, int end) {
+        computeDeltas(delta, begin, end);
+        long long cycles = 0;
+        for (int k = begin; k < end; k++)
+            cycles += delta[k];
+        chunkCycles[chunk] = cycles;
+    });
+
+    // Combine the chunk summaries so each chunk knows its entry cycle
+    long long total = exclusiveScan(chunkCycles);
+
+    // Second pass: fill in completion times and table lines per chunk
+    instStrings.assign(numInstructions, "");
+    if (myCache && loadUseLag() > 0) {
+        // Miss timing depends on the cycle each load issues and on the misses
+        // still in flight, so with a data cache the completion times come from
+        // one serial sweep and only the lines are built in parallel
+        vector<long long> completion(numInstructions);
+        long long cycle = 0;
+        for (int k = 0; k < numInstructions; k++) {
+            cycle = applyMemoryTiming(k, cycle + delta[k]);
+            completion[k] = cycle;
+        }
+        if (myWarmup > 0 && myWarmup <= numInstructions)
+            myWarmupEnd = completion[myWarmup - 1];
+        if (myTimeline)
+            for (int k = 0; k < numInstructions; k++)
+                myTimeline->addInstruction(mySkipped + k, myInstructions[k].getAssembly(), completion[k]);
+        parallelForChunks(numInstructions, chunkCycles.size(), [&](int chunk, int begin, int end) {
+            for (int k = begin; k < end; k++)
+                instStrings[k] = formatLine(k, completion[k]);
+        });
+        total = cycle;
+    }
+    else {
+        // Lines count time from the end of warm up
+        myWarmupEnd = 0;
+        for (int k = 0; k < myWarmup && k < numInstructions; k++)
+            myWarmupEnd += delta[k];
+
+        // The timeline is written in order, so it takes a serial sweep
+        if (myTimeline) {
+            long long cycle = 0;
+            for (int k = 0; k < numInstructions; k++) {
+                cycle += delta[k];
+                myTimeline->addInstruction(mySkipped + k, myInstructions[k].getAssembly(), cycle);
+            }
+        }
+
+        parallelForChunks(numInstructions, chunkCycles.size(), [&](int chunk, int begin, int end) {
+            long long cycle = chunkCycles[chunk];
+            for (int k = begin; k < end; k++) {
+                cycle += delta[k];
+                instStrings[k] = formatLine(k, cycle);
+            }
+        });
+    }
+
+    cycleCounter = total;
+    cycleCounter += myControlCycles[numInstructions - 1];
+    instructionCounter = numInstructions;
+
+    printPipeline(pipelineName());
+}
+
+// Time every instruction without building the table, warming up the
+// predictor and data cache as it goes. Returns the cycles from
+// instruction begin - 1 leaving the pipeline to the last one leaving.
+long long Pipeline::measureCycles(int begin) {
+    numInstructions = myInstructions.size();
+    computeControlCycles();
+    computeMemoryCycles();
+    computeRegisterMasks();
+
+    vector<int> delta(numInstructions);
+    computeDeltas(delta, 0, numInstructions);
+
+    long long cycle = 0;
+    long long start = 0;
+    for (int k = 0; k < numInstructions; k++) {
+        cycle = applyMemoryTiming(k, cycle + delta[k]);
+        if (k == begin - 1)
+            start = cycle;
+    }
+    return cycle - start;
+}
+
+// Mixes value into a block key
+static inline uint64_t mixBlockKey(uint64_t key, uint64_t value) {
+    key ^= value * 0xC2B2AE3D27D4EB4FULL;
+    key = (key << 31) | (key >> 33);
+    return key * 0x9E3779B185EBCA87ULL;
+}
+
+// Returns what the hazard checks see of instruction k, or a value no
+// instruction has if there is no instruction k
+uint64_t Pipeline::hazardFields(int k) {
+    if (k < 0)
+        return ~0ULL;
+    Instruction& i = myInstructions[k];
+    return (uint64_t)(uint8_t)i.getOpcode() | (uint64_t)(uint8_t)i.getRS() << 8
+        | (uint64_t)(uint8_t)i.getRT() << 16 | (uint64_t)(uint8_t)i.getRD() << 24;
+}
+
+// Fill in delta[k] for instructions begin to end - 1, the cycles
+// between instruction k-1 and instruction k leaving the pipeline
+// before cache misses, a basic block at a time through the block cache
+void Pipeline::computeDeltas(vector<int>& delta, int begin, int end) {
+    if (!myBlockCache) {
+        for (int k = begin; k < end; k++) {
+            // The first instruction needs five cycles to fill the pipeline
+            int d = (k == 0) ? 5 : 1;
+            d += hazardCycles(k);
+            if (k > 0)
+                d += myControlCycles[k - 1];
+            delta[k] = d;
+        }
+        return;
+    }
+
+    // The model's name starts every block's encoding, eight letters a word
+    vector<uint64_t> model;
+    string name = pipelineName();
+    for (unsigned int c = 0; c < name.length(); c += 8) {
+        uint64_t word = 0;
+        for (unsigned int b = c; b < name.length() && b < c + 8; b++)
+            word |= (uint64_t)(uint8_t)name[b] << (8 * (b - c));
+        model.push_back(word);
+    }
+
+    int cycles[BlockTimingCache::MAX_BLOCK_LENGTH];
+    vector<uint64_t> encoding;
+    int first = begin;
+    while (first < end) {
+        // A block runs to its branch or jump, so loops reuse their entries
+        int last = first;
+        while (last + 1 < end && last + 1 - first < BlockTimingCache::MAX_BLOCK_LENGTH) {
+            Opcode op = myInstructions[last].getOpcode();
+            if (op == BEQ || op == J)
+                break;
+            last++;
+        }
+        int length = last - first + 1;
+
+        // Hazards look back two instructions, or further past a multi-cycle
+        // one or a busy unit, and every instruction they reach brings the
+        // branch stall after it
+        int reach = 0;
+        for (int k = first; k <= last; k++)
+            reach = max(reach, hazardWindow(k) - (k - first));
+        encoding.assign(model.begin(), model.end());
+        encoding.push_back(length);
+        encoding.push_back(reach);
+        for (int k = first - reach; k < first; k++) {
+            encoding.push_back(hazardFields(k));
+            encoding.push_back((k >= 0) ? myControlCycles[k] : -1);
+        }
+        for (int k = first; k <= last; k++) {
+            encoding.push_back(hazardFields(k));
+            if (k < last)
+                encoding.push_back(myControlCycles[k]);
+        }
+        uint64_t key = 0;
+        for (size_t w = 0; w < encoding.size(); w++)
+            key = mixBlockKey(key, encoding[w]);
+
+        if (!myBlockCache->lookup(key, encoding, cycles, length)) {
+            for (int k = first; k <= last; k++)
+                cycles[k - first] = hazardCycles(k) + ((k > 0) ? myControlCycles[k - 1] : 0);
+            myBlockCache->insert(key, encoding, cycles, length);
+        }
+        for (int k = first; k <= last; k++)
+            delta[k] = ((k == 0) ? 5 : 1) + cycles[k - first];
+        first = last + 1;
+    }
+}
+
+// Given an instruction number, returns how many instructions back its
+// hazards can reach: two, or further if a multi-cycle result is still
+// on its way or a unit is still busy
+int Pipeline::hazardWindow(int instrNumber) {
+    int window = 2;
+    for (int distance = 3; distance <= myHazardWindow && distance <= instrNumber; distance++) {
+        Opcode op = myInstructions[instrNumber - distance].getOpcode();
+        if (myOpcodes.getLatency(op) > 1 || myOpcodes.getInitiationInterval(op) > 1)
+            window = distance;
+    }
+
+    // Waiting for a unit depends on the stalls of everything since the
+    // instruction holding it
+    int holder = unitHolder(instrNumber);
+    for (int m = holder + 1; holder >= 0 && m < instrNumber; m++)
+        window = max(window, instrNumber - m + hazardWindow(m));
+    return window;
+}
+
+// Given an instruction number, returns the last instruction before it
+// on the same functional unit if that unit is not pipelined and may
+// still be busy, or -1
+int Pipeline::unitHolder(int instrNumber) {
+    FunctionalUnit unit = unitOf(myInstructions[instrNumber].getOpcode());
+    if (myUnitInterval[unit] == 1)
+        return -1;
+
+    // Every instruction takes at least a cycle, so ones further back
+    // have freed the unit
+    for (int distance = 1; distance < myUnitInterval[unit] && distance <= instrNumber; distance++)
+        if (unitOf(myInstructions[instrNumber - distance].getOpcode()) == unit)
+            return instrNumber - distance;
+    return -1;
+}
+
+// Given an instruction number and the cycles it has stalled for RAW
+// dependences, returns the cycles it waits for its functional unit to
+// finish the last instruction issued to it, when that one is not
+// pipelined. The unit frees up an initiation interval after that
+// instruction left, counting every cycle since, stalls included.
+int Pipeline::unitCycles(int instrNumber, int rawStall) {
+    int holder = unitHolder(instrNumber);
+    if (holder < 0)
+        return 0;
+
+    int elapsed = 1 + myControlCycles[instrNumber - 1] + rawStall;
+    for (int m = holder + 1; m < instrNumber; m++)
+        elapsed += 1 + myControlCycles[m - 1] + hazardCycles(m);
+    return max(0, myOpcodes.getInitiationInterval(myInstructions[holder].getOpcode()) - elapsed);
+}
+
+// Stall for each RAW dependence on a recent instruction, and for
+// a functional unit that is still busy
+int StallPipeline::hazardCycles(int instrNumber) {
+    int raw = rawCycles<NoForwarding>(instrNumber);
+    return raw + unitCycles(instrNumber, raw);
+}
+
+// Stall for each RAW dependence as long as forwarding allows, and for
+// a functional unit that is still busy
+int ForwardPipeline::hazardCycles(int instrNumber) {
+    int raw = rawCycles<FullForwarding>(instrNumber);
+    return raw + unitCycles(instrNumber, raw);
+}
+
+// One bit for each reservation station
+struct StationMask {
+    uint64_t words[OutOfOrderPipeline::MAX_STATIONS / 64];
+
+    StationMask() { clear(); }
+    void clear() {
+        for (int w = 0; w < OutOfOrderPipeline::MAX_STATIONS / 64; w++)
+            words[w] = 0;
+    }
+    void set(int s) { words[s >> 6] |= 1ULL << (s & 63); }
+    void reset(int s) { words[s >> 6] &= ~(1ULL << (s & 63)); }
+    bool test(int s) { return (words[s >> 6] >> (s & 63)) & 1; }
+};
+
+// A reorder buffer entry
+struct ROBEntry {
+    int instrNumber;
+    bool issued;
+    long long writeBack; // cycle the result is written back, once issued
+};
+
+// Out of order pipeline constructor. Up to width instructions are
+// dispatched, issued and committed each cycle.
+OutOfOrderPipeline::OutOfOrderPipeline(int robSize, int numStations, int width) : Pipeline() {
+    myROBSize = robSize;
+    myNumStations = (numStations < MAX_STATIONS) ? numStations : MAX_STATIONS;
+    myWidth = width;
+
+    // The wakeup schedule has to look further ahead than the longest wait
+    // from issue to wakeup, which is a latency plus a cycle for loads
+    myWakeupCycles = 2;
+    for (int op = 0; op < UNDEFINED; op++)
+        myWakeupCycles = max(myWakeupCycles, myOpcodes.getLatency((Opcode)op) + (op == LB ? 1 : 0) + 1);
+    myUnrenamedTime = 0;
+    myReportIPC = true;
+}
+
+// Returns the heading printed above this pipeline's table
+string OutOfOrderPipeline::pipelineName() {
+    return "OUT-OF-ORDER (ROB " + to_string(myROBSize) + ", RS " + to_string(myNumStations) + ", " + to_string(myWidth) + " wide):";
+}
+
+// Override the runPipeline method
+void OutOfOrderPipeline::runPipeline() {
+
+    numInstructions = myInstructions.size();
+    if (numInstructions == 0) {
+        cerr << "Instructions didn't read correctly. Check input file." << endl;
+        exit(1);
+    }
+    computeControlCycles();
+
+    vector<long long> commits(numInstructions);
+    cycleCounter = schedule(true, &commits);
+    myUnrenamedTime = schedule(false, nullptr);
+    if (myWarmup > 0 && myWarmup <= numInstructions)
+        myWarmupEnd = commits[myWarmup - 1];
+
+    for (int k = 0; k < numInstructions; k++)
+        instStrings.push_back(formatLine(k, commits[k]));
+    instructionCounter = numInstructions;
+
+    printPipeline(pipelineName());
+}
+
+// Print how many cycles WAR and WAW dependences cost without renaming
+void OutOfOrderPipeline::printReport() {
+    const DependenceList& falseDependences = checker->getFalseDependencies();
+    int numWAR = 0;
+    int numWAW = 0;
+    for (DependenceList::const_iterator it = falseDependences.begin(); it != falseDependences.end(); it++) {
+        if (it->currentInstructionNumber < mySkipped)
+            continue;
+        if (it->dependenceType == WAR)
+            numWAR++;
+        else if (it->dependenceType == WAW)
+            numWAW++;
+    }
+
+    cout << "Without renaming the total time is " << myUnrenamedTime - myWarmupEnd << ", so " << numWAR << " WAR and ";
+    cout << numWAW << " WAW dependences cost " << myUnrenamedTime - cycleCounter << " cycles" << endl;
+}
+
+// Schedule every instruction and return the cycle the last one commits.
+// If rename is false, instructions also wait out WAR and WAW dependences.
+// Each instruction's commit cycle is stored in commits, if it is given.
+long long OutOfOrderPipeline::schedule(bool rename, vector<long long>* commits) {
+
+    // The reorder buffer is a circular array. Tag s is the result of the
+    // instruction in slot s, and tag myROBSize + s fires once it has issued.
+    vector<ROBEntry> rob(myROBSize);
+    int robHead = 0;
+    int robCount = 0;
+    vector<char> tagFired(2 * myROBSize, true);
+    vector<StationMask> waiters(2 * myROBSize); // stations waiting on each tag
+
+    vector<int> stationSlot(myNumStations); // ROB slot of each station's instruction
+    vector<int> stationPending(myNumStations); // tags each station still waits on
+    StationMask freeStations;
+    StationMask readyStations;
+    for (int s = 0; s < myNumStations; s++)
+        freeStations.set(s);
+
+    // Latest writer of each register, and the readers since then
+    int lastWriter[NumDependenceRegisters];
+    int lastWriterSlot[NumDependenceRegisters];
+    vector< vector<int> > readerSlots(NumDependenceRegisters);
+    vector< vector<int> > readerNumbers(NumDependenceRegisters);
+    for (int r = 0; r < NumDependenceRegisters; r++)
+        lastWriter[r] = -1;
+
+    // Cycle each kind of unit can start another instruction, once one
+    // that is not pipelined has issued to it
+    long long unitBusyUntil[NUM_UNITS] = { 0 };
+
+    // Tags due to fire on each of the next few cycles
+    vector< vector<int> > wakeups(myWakeupCycles);
+
+    int nextDispatch = 0;
+    int numCommitted = 0;
+    long long frontEndReady = 2; // the first instruction is decoded on cycle 2
+    long long cycle = 0;
+    long long lastCommit = 0;
+
+    // Back edges dispatched since the last check mark a possible steady state
+    SteadyStateDetector steadyState(myAddresses, myTaken, myControlCycles);
+    int lastChecked = 0;
+
+    while (numCommitted < numInstructions) {
+        bool crossedBackEdge = false;
+        for (int k = lastChecked + 1; k <= nextDispatch && myExtrapolate && !crossedBackEdge; k++)
+            crossedBackEdge = steadyState.startsIteration(k);
+        lastChecked = nextDispatch;
+
+        if (crossedBackEdge) {
+            // The whole model, with cycles relative to this one, instruction
+            // numbers relative to the next to dispatch and ROB slots relative
+            // to the head, so a loop repeats each trip wherever it sits in the
+            // ROB. Stations are named by the slot of their instruction, since
+            // which one an instruction gets makes no difference to timing.
+            // Values that behave the same, like a write back already past, are
+            // folded together.
+            vector<long long> state;
+            int firstUsed = nextDispatch;
+            auto relativeSlot = [&](int slot) {
+                return (slot - robHead + myROBSize) % myROBSize;
+            };
+            auto relativeTag = [&](int tag) {
+                return (tag < myROBSize) ? relativeSlot(tag) : myROBSize + relativeSlot(tag - myROBSize);
+            };
+            vector<int> slotStation(myROBSize, -1);
+            for (int st = 0; st < myNumStations; st++)
+                if (!freeStations.test(st))
+                    slotStation[stationSlot[st]] = st;
+
+            state.push_back(robCount);
+            for (int n = 0; n < robCount; n++) {
+                int slot = (robHead + n) % myROBSize;
+                state.push_back(nextDispatch - rob[slot].instrNumber);
+                state.push_back(rob[slot].issued ? max(rob[slot].writeBack - cycle, 1LL) : 0);
+                state.push_back(tagFired[slot] + 2 * tagFired[myROBSize + slot]);
+                int st = slotStation[slot];
+                if (st >= 0) {
+                    state.push_back(stationPending[st]);
+                    state.push_back(readyStations.test(st));
+                }
+                for (int t = slot; t < 2 * myROBSize; t += myROBSize) {
+                    vector<long long> waiting;
+                    for (int w = 0; w < MAX_STATIONS / 64; w++)
+                        for (uint64_t bits = waiters[t].words[w]; bits; bits &= bits - 1)
+                            waiting.push_back(relativeSlot(stationSlot[64 * w + __builtin_ctzll(bits)]));
+                    sort(waiting.begin(), waiting.end());
+                    state.push_back(waiting.size());
+                    state.insert(state.end(), waiting.begin(), waiting.end());
+                }
+                firstUsed = min(firstUsed, rob[slot].instrNumber);
+            }
+            // Instructions that have committed can no longer be waited on
+            for (int r = 0; r < NumDependenceRegisters; r++) {
+                if (lastWriter[r] >= numCommitted) {
+                    state.push_back(nextDispatch - lastWriter[r]);
+                    state.push_back(relativeSlot(lastWriterSlot[r]));
+                }
+                else
+                    state.push_back(-1);
+                for (unsigned int q = 0; q < readerNumbers[r].size() && !rename; q++)
+                    if (readerNumbers[r][q] >= numCommitted) {
+                        state.push_back(nextDispatch - readerNumbers[r][q]);
+                        state.push_back(relativeSlot(readerSlots[r][q]));
                     }
+                state.push_back(-2);
+            }
+            for (int d = 1; d <= myWakeupCycles; d++) {
+                vector<int>& due = wakeups[(cycle + d) % myWakeupCycles];
+                state.push_back(due.size());
+                for (unsigned int t = 0; t < due.size(); t++)
+                    state.push_back(relativeTag(due[t]));
+            }
+            state.push_back(max(frontEndReady - cycle, 1LL));
+            for (int u = 0; u < NUM_UNITS; u++)
+                state.push_back(max(unitBusyUntil[u] - cycle, 0LL));
+
+            int period;
+            long long periodCycles;
+            int skip = steadyState.check(nextDispatch, firstUsed, cycle, state, period, periodCycles);
+            if (skip > 0) {
+                // Jump the model ahead by whole periods. Each instruction jumped
+                // over commits a period's cycles after its counterpart.
+                long long shift = skip / period * periodCycles;
+                if (commits)
+                    for (int k = numCommitted; k < numCommitted + skip; k++)
+                        (*commits)[k] = (*commits)[k - period] + periodCycles;
+
+                for (int n = 0; n < robCount; n++) {
+                    ROBEntry& entry = rob[(robHead + n) % myROBSize];
+                    entry.instrNumber += skip;
+                    entry.writeBack += shift;
+                }
+                for (int r = 0; r < NumDependenceRegisters; r++) {
+                    if (lastWriter[r] >= 0)
+                        lastWriter[r] += skip;
+                    for (unsigned int q = 0; q < readerNumbers[r].size(); q++)
+                        readerNumbers[r][q] += skip;
                 }
+                vector< vector<int> > rotated(myWakeupCycles);
+                for (int c = 0; c < myWakeupCycles; c++)
+                    rotated[(c + shift) % myWakeupCycles].swap(wakeups[c]);
+                wakeups.swap(rotated);
+
+                cycle += shift;
+                frontEndReady += shift;
+                for (int u = 0; u < NUM_UNITS; u++)
+                    unitBusyUntil[u] += shift;
+                lastCommit += shift;
+                numCommitted += skip;
+                nextDispatch += skip;
+                lastChecked = nextDispatch;
             }
-            constructLine(); // instr is leaving pipeline
-            // Account for time taken to determine jump location
-            if (getWriteBack().getInstType() == JTYPE)
-                cycleCounter += 1;
         }
 
-        // Advance stages of pipeline
-        if (inMemory)
-            setWriteBack(inMemory);
-        if (inExecute)
-            setMemory(inExecute);
-        if (inDecode)
-            setExecute(inDecode);
-        if (inFetch)
-            setDecode(inFetch);
+        cycle++;
 
-        // Insert next instruction, if necessary
-        if (instrCycled < numInstructions)
-            setFetch(&myInstructions.at(instrCycled));
+        // Wake up the stations waiting on tags that fire this cycle
+        vector<int>& firing = wakeups[cycle % myWakeupCycles];
+        for (unsigned int t = 0; t < firing.size(); t++) {
+            int tag = firing[t];
+            tagFired[tag] = true;
+            for (int w = 0; w < MAX_STATIONS / 64; w++) {
+                for (uint64_t bits = waiters[tag].words[w]; bits; bits &= bits - 1) {
+                    int s = 64 * w + __builtin_ctzll(bits);
+                    if (--stationPending[s] == 0)
+                        readyStations.set(s);
+                }
+            }
+            waiters[tag].clear();
+        }
+        firing.clear();
+
+        // Commit finished instructions in order
+        for (int n = 0; n < myWidth && robCount > 0; n++) {
+            ROBEntry& head = rob[robHead];
+            if (!head.issued || head.writeBack > cycle)
+                break;
+            if (commits)
+                (*commits)[head.instrNumber] = cycle;
+            lastCommit = cycle;
+            robHead = (robHead + 1) % myROBSize;
+            robCount--;
+            numCommitted++;
+        }
+
+        // Issue the oldest ready instructions that have a free unit
+        int unitsFree[NUM_UNITS] = { myWidth, 1, 1, 1 };
+        for (int n = 0; n < myWidth; n++) {
+            int best = -1;
+            for (int w = 0; w < MAX_STATIONS / 64; w++) {
+                for (uint64_t bits = readyStations.words[w]; bits; bits &= bits - 1) {
+                    int s = 64 * w + __builtin_ctzll(bits);
+                    int instr = rob[stationSlot[s]].instrNumber;
+                    FunctionalUnit unit = unitOf(myInstructions[instr].getOpcode());
+                    if (unitsFree[unit] == 0 || unitBusyUntil[unit] > cycle)
+                        continue;
+                    if (best < 0 || instr < rob[stationSlot[best]].instrNumber)
+                        best = s;
+                }
+            }
+            if (best < 0)
+                break;
+
+            int slot = stationSlot[best];
+            Opcode op = myInstructions[rob[slot].instrNumber].getOpcode();
+            readyStations.reset(best);
+            freeStations.set(best);
+            unitsFree[unitOf(op)]--;
+            if (myOpcodes.getInitiationInterval(op) > 1)
+                unitBusyUntil[unitOf(op)] = cycle + myOpcodes.getInitiationInterval(op);
+
+            // Results forward after execute, and loaded values after memory
+            int latency = myOpcodes.getLatency(op);
+            rob[slot].issued = true;
+            rob[slot].writeBack = cycle + 1 + latency;
+            if (op == LB)
+                latency++;
+            wakeups[(cycle + latency) % myWakeupCycles].push_back(slot);
+            wakeups[(cycle + 1) % myWakeupCycles].push_back(myROBSize + slot);
+        }
+
+        // Rename and dispatch in order while there is room
+        for (int n = 0; n < myWidth && nextDispatch < numInstructions && frontEndReady <= cycle && robCount < myROBSize; n++) {
+            int s = -1;
+            for (int w = 0; w < MAX_STATIONS / 64 && s < 0; w++)
+                if (freeStations.words[w])
+                    s = 64 * w + __builtin_ctzll(freeStations.words[w]);
+            if (s < 0 || s >= myNumStations)
+                break;
+
+            int k = nextDispatch++;
+            Instruction& i = myInstructions[k];
+            int slot = (robHead + robCount) % myROBSize;
+            robCount++;
+            rob[slot].instrNumber = k;
+            rob[slot].issued = false;
+            tagFired[slot] = tagFired[myROBSize + slot] = false;
+
+            freeStations.reset(s);
+            stationSlot[s] = slot;
+            stationPending[s] = 0;
+
+            // Wait on a tag that has not fired, unless already waiting on it.
+            // An instruction is still in flight if it has not committed.
+            auto waitOn = [&](int instr, int tag) {
+                if (instr >= numCommitted && !tagFired[tag] && !waiters[tag].test(s)) {
+                    waiters[tag].set(s);
+                    stationPending[s]++;
+                }
+            };
+
+            unsigned int reads[2];
+            int numReads = checker->getReadRegisters(i, reads);
+            for (int r = 0; r < numReads; r++)
+                if (lastWriter[reads[r]] >= 0)
+                    waitOn(lastWriter[reads[r]], lastWriterSlot[reads[r]]);
+
+            unsigned int written = checker->getWriteRegister(i);
+            if (!rename && written < (unsigned int)NumDependenceRegisters) {
+                // Without renaming, a write waits for the last write to the register
+                // and for every read of it since then
+                if (lastWriter[written] >= 0)
+                    waitOn(lastWriter[written], lastWriterSlot[written]);
+                for (unsigned int r = 0; r < readerSlots[written].size(); r++)
+                    waitOn(readerNumbers[written][r], myROBSize + readerSlots[written][r]);
+            }
+
+            for (int r = 0; r < numReads; r++) {
+                // Readers more than a ROB's worth back have committed, so drop them
+                vector<int>& numbers = readerNumbers[reads[r]];
+                if ((int)numbers.size() >= 2 * myROBSize) {
+                    numbers.erase(numbers.begin(), numbers.end() - myROBSize);
+                    readerSlots[reads[r]].erase(readerSlots[reads[r]].begin(), readerSlots[reads[r]].end() - myROBSize);
+                }
+                readerSlots[reads[r]].push_back(slot);
+                numbers.push_back(k);
+            }
+            if (written < (unsigned int)NumDependenceRegisters) {
+                lastWriter[written] = k;
+                lastWriterSlot[written] = slot;
+                readerSlots[written].clear();
+                readerNumbers[written].clear();
+            }
+
+            if (stationPending[s] == 0)
+                readyStations.set(s);
+
+            // Fetch picks up after a taken branch or jump once it resolves
+            if (myTaken[k] || myControlCycles[k] > 0)
+                frontEndReady = cycle + 1 + myControlCycles[k];
+        }
     }
-    printPipeline("FORWARDING:");
-}
\ No newline at end of file
+
+    return lastCommit + myControlCycles[numInstructions - 1];
+}
@@ -6,9 +6,55 @@
 #include "Instruction.h"
 #include "DependencyChecker.h"
 #include "OpcodeTable.h"
+#include "BranchPredictor.h"
+#include "DataCache.h"
+#include "BlockCache.h"
+#include "Timeline.h"
 
 using namespace std;
 
+// The kinds of functional unit an instruction can issue to
+enum FunctionalUnit { ALU_UNIT, MULT_UNIT, MEMORY_UNIT, BRANCH_UNIT, NUM_UNITS };
+
+/**
+ * Hazard policies tell the in-order engine which stalls a model charges
+ * at compile time. IgnoreHazards charges none. DetectHazards stalls for
+ * dependences, busy functional units, branches and jumps, and cache misses.
+ */
+struct IgnoreHazards {
+    static const bool DETECTS_HAZARDS = false;
+};
+
+struct DetectHazards {
+    static const bool DETECTS_HAZARDS = true;
+};
+
+/**
+ * Forwarding policies tell the in-order engine how long a reader waits for
+ * a result. Given the latency of the instruction producing it, whether that
+ * instruction is a load, and how many instructions later the result is read,
+ * dependenceCycles returns the cycles the reader stalls.
+ */
+struct NoForwarding {
+    // A value is read after it is written back, so a one cycle instruction
+    // stalls the one after it two cycles and the one after that one cycle.
+    // Each extra cycle of latency adds a cycle.
+    static int dependenceCycles(int latency, bool load, int distance) {
+        int stalls = 2 + latency - distance;
+        return (stalls > 0) ? stalls : 0;
+    }
+};
+
+struct FullForwarding {
+    // A result is forwarded as soon as it is computed, so only a value
+    // loaded by the previous instruction or coming from a unit with a
+    // latency over one cycle costs a stall
+    static int dependenceCycles(int latency, bool load, int distance) {
+        int stalls = latency + (load ? 1 : 0) - distance;
+        return (stalls > 0) ? stalls : 0;
+    }
+};
+
 /** 
  * Pipeline Base Class
  * This class simulates a pipeline without considering
@@ -22,17 +68,165 @@ class Pipeline {
         Pipeline();
 
         // Pipeline deconstructor
-        ~Pipeline();
+        virtual ~Pipeline();
 
         // Add a given instruction to the list of instructions
         // @param i - The instruction to add to myInstructions
         void addInstruction(Instruction i);
 
+        // Add an instruction that was fetched from instruction number pc.
+        // taken is true if the instruction redirected fetch.
+        void addInstruction(Instruction i, int pc, bool taken);
+
+        // Fast forward past an instruction fetched from instruction number pc
+        // without timing it. Only the predictor, the data cache and the
+        // dependence checker see it.
+        void skipInstruction(Instruction& i, int pc, bool taken);
+
+        // Time the first warmup instructions added, but leave them out of
+        // the table and the total time
+        void setWarmup(int warmup) { myWarmup = warmup; }
+
+        // Allow or forbid jumping over loop iterations once a model that
+        // supports it reaches a steady state. The times are the same either way.
+        void setExtrapolation(bool extrapolate) { myExtrapolate = extrapolate; }
+
+        // Look up the hazard cycles of each basic block in blocks before
+        // working them out, and remember the ones worked out. The cache is
+        // not owned, so several models can share it.
+        void setBlockCache(BlockTimingCache* blocks) { myBlockCache = blocks; }
+
+        // Record the cycle each instruction enters every stage in timeline
+        // as the table is built. The recorder is not owned.
+        void setTimeline(TimelineRecorder* timeline) { myTimeline = timeline; }
+
+        // Take the dependences between instructions from records, found
+        // earlier over the same instruction stream, rather than working them
+        // out as instructions are added. The first instruction added or
+        // skipped is instruction first of that stream. Call before adding
+        // instructions.
+        void useKnownDependences(const vector<DependenceRecord>* records, int first) { checker->useKnownDependences(records, first); }
+
+        // Charge BEQ and J with the cycles predictor loses on them, where a
+        // mispredicted BEQ costs flushPenalty cycles. The pipeline takes
+        // ownership of the predictor.
+        void setPredictor(BranchPredictor* predictor, int flushPenalty);
+
+        // Send each LB through cache, with numMSHRs misses allowed in flight.
+        // A miss delays the instructions that use the loaded value. The
+        // pipeline takes ownership of the cache.
+        void setDataCache(DataCache* cache, int numMSHRs);
+
+        // Give the address each LB reads, in the order the loads were added.
+        // Without addresses a load reads its immediate, as if the base
+        // register held zero.
+        void setLoadAddresses(vector<uint32_t>& addresses) { myLoadAddresses = addresses; }
+
         // Execute the pipeline simulation
         virtual void runPipeline();
 
+        // Execute the pipeline simulation with the parallel engine. Each of
+        // numThreads chunks of instructions is summarized by the cycles it takes,
+        // the sums are scanned, and completion times are filled in per chunk.
+        // Produces the same table as runPipeline.
+        void runPipelineParallel(int numThreads);
+
+        // Time every instruction without building the table, warming up the
+        // predictor and data cache as it goes. Returns the cycles from
+        // instruction begin - 1 leaving the pipeline to the last one leaving.
+        long long measureCycles(int begin);
+
     protected:
 
+        // Move each instruction through the five stages a cycle at a time,
+        // charging the stalls HazardPolicy detects for as long as
+        // ForwardingPolicy says, and print the table. Every scalar model
+        // runs a copy of this loop specialized to its policies.
+        template <class HazardPolicy, class ForwardingPolicy>
+        void runInOrder();
+
+        // Given an instruction number, returns the stall cycles charged to it
+        // as it leaves the pipeline. The ideal pipeline never stalls.
+        virtual int hazardCycles(int instrNumber) { return 0; }
+
+        // Given an instruction number, returns the cycles it stalls for RAW
+        // dependences on recent instructions, as long as ForwardingPolicy
+        // says. computeRegisterMasks must have run.
+        template <class ForwardingPolicy>
+        int rawCycles(int instrNumber);
+
+        // Find the RAW dependences on the previous two instructions for the
+        // whole trace in one pass over the register masks addInstruction made
+        void computeRegisterMasks();
+
+        // Given an instruction number and the cycles it has stalled for RAW
+        // dependences, returns the cycles it waits for its functional unit to
+        // finish the last instruction issued to it, when that one is not
+        // pipelined. The unit frees up an initiation interval after that
+        // instruction left, counting every cycle since, stalls included.
+        int unitCycles(int instrNumber, int rawStall);
+
+        // Given an instruction number, returns the last instruction before it
+        // on the same functional unit if that unit is not pipelined and may
+        // still be busy, or -1
+        int unitHolder(int instrNumber);
+
+        // Fill in delta[k] for instructions begin to end - 1, the cycles
+        // between instruction k-1 and instruction k leaving the pipeline
+        // before cache misses, a basic block at a time through the block cache
+        void computeDeltas(vector<int>& delta, int begin, int end);
+
+        // Returns what the hazard checks see of instruction k, or a value no
+        // instruction has if there is no instruction k
+        uint64_t hazardFields(int k);
+
+        // Returns true if branches and jumps cost cycles in this pipeline
+        virtual bool modelsControlHazards() { return false; }
+
+        // Returns true if reading a recent result costs cycles in this pipeline
+        virtual bool modelsDataHazards() { return false; }
+
+        // Fill in the cycles lost after each instruction to resolve branches
+        // and jumps. Without a predictor every jump costs one cycle. Each run
+        // starts from a copy of the predictor as the skipped instructions left it.
+        void computeControlCycles();
+
+        // Given a BEQ or J fetched from instruction number pc, returns the
+        // instruction number it goes to when taken
+        uint32_t branchTarget(Instruction& i, int pc);
+
+        // Returns the heading printed above this pipeline's table
+        virtual string pipelineName() { return "IDEAL:"; }
+
+        // Given an opcode, returns the functional unit it issues to
+        FunctionalUnit unitOf(Opcode op);
+
+        // Print anything this pipeline reports beyond the total time
+        virtual void printReport() {}
+
+        // Returns how many cycles after an LB leaves the pipeline an instruction
+        // reading its value can leave when the load hits. 0 means this pipeline
+        // does not model the data cache.
+        virtual int loadUseLag() { return 0; }
+
+        // Run every LB through the data cache in order, filling in the extra
+        // cycles each one takes, and reset the miss timing state. Each run
+        // starts from a copy of the cache as the skipped instructions left it.
+        void computeMemoryCycles();
+
+        // Given an instruction number and the cycle it would leave the pipeline,
+        // returns the cycle it actually leaves once cache misses are accounted for
+        long long applyMemoryTiming(int instrNumber, long long cycle);
+
+        // Given an instruction number, returns how many instructions back its
+        // hazards can reach: two, or further if a multi-cycle result is still
+        // on its way or a unit is still busy
+        int hazardWindow(int instrNumber);
+
+        // Given an instruction number and its completion time,
+        // construct the string to print
+        const char* formatLine(int instrNumber, int completionTime);
+
         // Print the pipeline, given the type of pipeline
         void printPipeline(string pipelineType);
 
@@ -68,7 +262,41 @@ class Pipeline {
 
         vector<Instruction> myInstructions; // list of instruction
 
-        vector<string> instStrings; // Stores information needed for printing, as strings
+        vector<const char*> instStrings; // Stores information needed for printing, as strings in myArena
+
+        Arena* myArena; // the current arena when the pipeline was created, or myOwnArena
+        Arena* myOwnArena; // or nullptr if there was a current arena
+
+        vector<int> myAddresses; // instruction number each instruction was fetched from
+        vector<bool> myTaken; // whether each instruction redirected fetch
+        vector<int> myControlCycles; // cycles lost after each instruction to branches
+
+        vector<uint64_t> myReadMasks; // registers each instruction reads, a bit each
+        vector<uint64_t> myWriteMasks; // register each instruction writes, as a bit
+        vector<uint8_t> myNearRAW; // bit d-1 set if an instruction reads a result from d back, for d of 1 and 2
+
+        BranchPredictor* myPredictor; // predicts BEQ and J in the last run, or nullptr
+        BranchPredictor* myWarmPredictor; // what skipped instructions trained, copied at the start of each run
+        int myFlushPenalty; // cycles lost to a mispredicted BEQ
+
+        DataCache* myCache; // the data cache LB goes through in the last run, or nullptr
+        DataCache* myWarmCache; // what skipped instructions filled, copied at the start of each run
+        MissTracker* myMisses; // outstanding misses to myCache
+        vector<uint32_t> myLoadAddresses; // address read by each LB, in order
+        vector<int> myMemoryCycles; // extra cycles each LB takes in the cache
+        vector<uint32_t> myMemoryLines; // cache line each LB reads
+        vector<bool> myMemoryMissed; // whether each LB missed in L1
+        long long myRegisterReady[NumDependenceRegisters]; // earliest cycle a reader of each register can leave
+
+        bool myReportIPC; // print instructions per cycle under the total time
+        bool myExtrapolate; // jump over loop iterations in a steady state
+        BlockTimingCache* myBlockCache; // hazard cycles of blocks seen before, or nullptr
+        TimelineRecorder* myTimeline; // where stage cycles are recorded, or nullptr
+
+        long long mySkipped; // instructions fast forwarded before the first one added
+        unsigned int myLoadsSkipped; // load addresses used up by skipped instructions
+        int myWarmup; // instructions timed before the table starts
+        long long myWarmupEnd; // cycle the last warm up instruction left the pipeline
 
         // Each variable here stores the instruction in that stage of pipeline
         Instruction *inFetch;
@@ -83,6 +311,8 @@ class Pipeline {
         DependencyChecker* checker; // Use dependency checker to identify dependences
 
         OpcodeTable myOpcodes;
+        int myHazardWindow; // furthest back, in instructions, a hazard can reach
+        int myUnitInterval[NUM_UNITS]; // longest initiation interval on each unit
 
 };
 
@@ -106,7 +336,21 @@ class StallPipeline : public Pipeline {
     
     protected:
 
-        int instrCycled; // Track the number of instr to enter pipeline
+        // Stall for each RAW dependence on a recent instruction, and for
+        // a functional unit that is still busy
+        int hazardCycles(int instrNumber);
+
+        // Jumps are resolved before the next instruction is fetched
+        bool modelsControlHazards() { return true; }
+
+        // Readers wait for results that are not written back yet
+        bool modelsDataHazards() { return true; }
+
+        // Returns the heading printed above this pipeline's table
+        string pipelineName() { return "STALL:"; }
+
+        // A reader right behind a load stalls two cycles
+        int loadUseLag() { return 3; }
 
 };
 
@@ -128,6 +372,118 @@ class ForwardPipeline : public StallPipeline {
         // Override the runPipeline method
         void runPipeline();
 
+    protected:
+
+        // Stall for each RAW dependence as long as forwarding allows, and for
+        // a functional unit that is still busy
+        int hazardCycles(int instrNumber);
+
+        // Returns the heading printed above this pipeline's table
+        string pipelineName() { return "FORWARDING:"; }
+
+        // A reader right behind a load stalls one cycle
+        int loadUseLag() { return 2; }
+
+};
+
+/**
+ * Superscalar Pipeline Class
+ * This class simulates an in-order pipeline that issues a bundle
+ * of up to width instructions each cycle, with data forwarding.
+ * A bundle ends when the next instruction reads or writes a register
+ * the bundle writes, needs a functional unit that is used up, or
+ * follows a taken branch or jump. A unit that is not pipelined stays
+ * used up for its instruction's initiation interval, and a result
+ * from a multi-cycle unit is read once its latency has passed.
+ */
+class SuperscalarPipeline : public Pipeline {
+
+    public:
+
+        // The widest bundle that can be issued
+        static const int MAX_WIDTH = 8;
+
+        // Superscalar pipeline constructor. Every unit kind but the ALU
+        // starts with one unit, and there are width ALUs.
+        SuperscalarPipeline(int width);
+
+        // Virtual deconstructor
+        virtual ~SuperscalarPipeline() {}
+
+        // Set how many of each functional unit a cycle can use. A bundle
+        // never holds more than MAX_WIDTH instructions, so only that many
+        // units of a kind are modelled.
+        void setUnits(int alus, int multipliers, int memoryPorts, int branchUnits);
+
+        // Override the runPipeline method
+        void runPipeline();
+
+    protected:
+
+        // Jumps are resolved before the next bundle is fetched
+        bool modelsControlHazards() { return true; }
+
+        // Returns the heading printed above this pipeline's table
+        string pipelineName() { return "SUPERSCALAR (" + to_string(myWidth) + " wide):"; }
+
+        // Returns how many units of kind unit are modelled
+        int numUnits(int unit) { return (myUnits[unit] < MAX_WIDTH) ? myUnits[unit] : MAX_WIDTH; }
+
+        int myWidth; // most instructions issued in one cycle
+        int myUnits[NUM_UNITS]; // units of each kind usable each cycle
+
+};
+
+/**
+ * Out of Order Pipeline Class
+ * This class simulates a Tomasulo style pipeline. Instructions are renamed
+ * and dispatched in order into a reorder buffer and reservation stations,
+ * issue out of order as soon as their operands are ready, and commit in
+ * order. Results are forwarded, so a value loaded by an LB is ready one
+ * cycle later than an ALU result, and one from a multi-cycle unit once its
+ * latency has passed. A unit that is not pipelined takes nothing new until
+ * its instruction's initiation interval has passed.
+ */
+class OutOfOrderPipeline : public Pipeline {
+
+    public:
+
+        // The most reservation stations the wakeup bitmasks can hold
+        static const int MAX_STATIONS = 128;
+
+        // Out of order pipeline constructor. Up to width instructions are
+        // dispatched, issued and committed each cycle.
+        OutOfOrderPipeline(int robSize, int numStations, int width);
+
+        // Virtual deconstructor
+        virtual ~OutOfOrderPipeline() {}
+
+        // Override the runPipeline method
+        void runPipeline();
+
+    protected:
+
+        // Jumps are resolved before the instructions after them are fetched
+        bool modelsControlHazards() { return true; }
+
+        // Returns the heading printed above this pipeline's table
+        string pipelineName();
+
+        // Print how many cycles WAR and WAW dependences cost without renaming
+        void printReport();
+
+        // Schedule every instruction and return the cycle the last one commits.
+        // If rename is false, instructions also wait out WAR and WAW dependences.
+        // Each instruction's commit cycle is stored in commits, if it is given.
+        long long schedule(bool rename, vector<long long>* commits);
+
+        int myROBSize; // reorder buffer entries
+        int myNumStations; // reservation stations
+        int myWidth; // instructions dispatched, issued and committed per cycle
+        int myWakeupCycles; // cycles the wakeup schedule looks ahead
+
+        long long myUnrenamedTime; // total time when false dependences are kept
+
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,15 +2,73 @@
 
 #include "ASMParser.h"
 #include "BinaryParser.h"
+#include "BlockCache.h"
+#include "Executor.h"
+#include "InputReader.h"
+#include "ParseCache.h"
 #include "Pipeline.h"
+#include "Sampler.h"
+#include "Server.h"
+#include "Timeline.h"
+#include "TimelineIndex.h"
+#include "SimOptions.h"
+#include "TraceFile.h"
+#include "TraceParser.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
 // This template function receives either a Binary or ASM Parser
 // It executes syntax checking and the simulation of the pipeline
+// If cache is given, it is filled in for the next run
 template 
 <class ParserType> 
-void addInstructions(ParserType&& parser);
+void addInstructions(ParserType&& parser, SimOptions& opts, ParseCache* cache);
+
+// Reads the input file opts names and simulates it
+void simulateFile(SimOptions& opts);
+
+// Runs "PIPESIM query INDEX [at CYCLE | between FIRST LAST]", printing
+// what the timeline index says. args are the words after "query".
+int queryTimeline(int argc, char* args[]);
+
+// Parses standard input as fileFormat, reading it on a thread of its
+// own so the parser never waits on a full pipe, and simulates it
+void readStandardInput(string fileFormat, SimOptions& opts);
+
+// Prints each line of the input that could not be parsed
+void reportErrors(vector<ParseError>& errors, SimOptions& opts);
+
+// Simulates program as opts asks. dependences, if given, holds every
+// dependence between the listed instructions, found by an earlier run.
+// Returns the number of instructions simulated.
+long long simulateProgram(vector<Instruction>& program, vector<DependenceRecord>* dependences, SimOptions& opts);
+
+// Simulates program with every timing engine, checking that each prints
+// the same tables as the serial engines and runs about as fast as the
+// rates in opts.verifyBaseline. Exits with 1 if one does not.
+void verifyEngines(vector<Instruction>& program, SimOptions& opts);
+
+// Gives a stall or forwarding model the predictor, data cache and
+// block timing cache asked for
+void configureModel(Pipeline& model, vector<uint32_t>& loadAddresses, BlockTimingCache* blocks, SimOptions& opts);
+
+// Estimates the stall and forwarding total times from a few representative
+// intervals of the trace, chosen by their basic block vectors
+void simulateSampled(vector<Instruction>& program, vector<int>& trace, vector<bool>& taken,
+                     vector<uint32_t>& loadAddresses, BlockTimingCache* blocks, SimOptions& opts);
+
+// Reports how well the block timing cache did and keeps it for the next
+// run, if a file was given
+void finishBlockCache(BlockTimingCache& blocks, SimOptions& opts);
 
 /**
  * This file reads in a file contains assembly or binary code
@@ -19,58 +77,707 @@ void addInstructions(ParserType&& parser);
  * to stdout.
  */
 int main(int argc, char *argv[]) {
+    // Answer questions about a run recorded with --timeline-index
+    if (argc > 1 && string(argv[1]) == "query")
+        return queryTimeline(argc - 2, argv + 2);
+
     // Check for a command line argument
-    if (argc != 2) {
-        cerr << "You need to specify a binary or assembly file to translate." << endl;
+    SimOptions opts;
+    if (!parseOptions(argc, argv, opts))
+        exit(1);
+
+    // Stay up and simulate the inputs sent to us
+    if (opts.serve == "-") {
+        SimServer(simulateFile).serveStream();
+        return 0;
+    }
+    if (opts.serve.length() > 0)
+        return SimServer(simulateFile).serveSocket(opts.serve) ? 0 : 1;
+
+    simulateFile(opts);
+    return 0;
+}
+
+// Returns true if text is a whole number, leaving it in value
+static bool readCount(string text, long long& value) {
+    if (text.length() == 0 || text.length() > 18 || text.find_first_not_of("0123456789") != string::npos)
+        return false;
+    value = atoll(text.c_str());
+    return true;
+}
+
+// Runs "PIPESIM query INDEX [at CYCLE | between FIRST LAST]", printing
+// what the timeline index says. args are the words after "query".
+int queryTimeline(int argc, char* args[]) {
+    static const char* const STAGE_NAMES[5] = { "IF", "ID", "EX", "MEM", "WB" };
+    if (argc < 1) {
+        cerr << "query needs a timeline index, then at CYCLE or between FIRST LAST." << endl;
+        return 1;
+    }
+    TimelineIndex index(args[0]);
+    if (!index.isGood()) {
+        cerr << args[0] << " is not a timeline index." << endl;
+        return 1;
+    }
+
+    // With nothing to ask, describe the run
+    string question = (argc > 1) ? args[1] : "";
+    if (argc == 1) {
+        cout << index.getNumInstructions() << " instructions, " << index.getFirstNumber() << " to " << index.getLastNumber();
+        cout << ", in cycles " << index.getFirstCycle() << " to " << index.getLastCycle() << endl;
+        return 0;
+    }
+
+    long long first, last;
+    if (question == "at" && argc == 3 && readCount(args[2], first)) {
+        vector<TimelineIndex::Occupant> occupants;
+        index.occupancy(first, occupants);
+        for (unsigned int o = 0; o < occupants.size(); o++)
+            cout << occupants[o].number << "\t" << STAGE_NAMES[occupants[o].stage] << "\t|" << occupants[o].assembly << endl;
+        return 0;
+    }
+    if (question == "between" && argc == 4 && readCount(args[2], first) && readCount(args[3], last)) {
+        long long cycles = index.cyclesBetween(first, last);
+        if (cycles < 0) {
+            cerr << "Instructions " << first << " and " << last << " are not both in " << args[0] << endl;
+            return 1;
+        }
+        cout << cycles << " cycles between instructions " << first << " and " << last << " leaving the pipeline" << endl;
+        return 0;
+    }
+    cerr << "query needs a timeline index, then at CYCLE or between FIRST LAST." << endl;
+    return 1;
+}
+
+// Reads the input file opts names and simulates it
+void simulateFile(SimOptions& opts) {
+    // Get the input file extension, unless the format was given
+    string filename = opts.filename;
+    size_t fileExtension = filename.rfind('.');
+    string fileFormat;
+    if (opts.format.length() > 0)
+        fileFormat = "." + opts.format;
+    else if (fileExtension != string::npos && filename.find('/', fileExtension) == string::npos)
+        fileFormat = filename.substr(fileExtension, filename.size());
+    bool fromStdin = (filename == "-");
+
+    if (fromStdin) {
+        if (fileFormat == ".asm" || fileFormat == ".mach") {
+            readStandardInput(fileFormat, opts);
+            return;
+        }
+        if (fileFormat == ".trc")
+            cerr << "A packed trace is read out of order, so it cannot come from standard input." << endl;
+        else
+            cerr << "Standard input needs --format asm or --format mach." << endl;
         exit(1);
     }
 
-    // Get the input file extension
-    string filename = argv[1];
-    size_t fileExtension = filename.find('.');
-    string fileFormat = filename.substr(fileExtension, filename.size());
+    // Inputs parsed on an earlier run come straight from their sidecar,
+    // unless the point is to parse them. A listing to be executed is
+    // parsed again, since it must define every label it uses and the
+    // sidecar may come from a run that let it off.
+    unique_ptr<ParseCache> cache;
+    if (opts.parseCache && !opts.checkOnly && ((fileFormat == ".asm" && !opts.execute) || fileFormat == ".mach")) {
+        cache.reset(new ParseCache(filename));
+        vector<Instruction> program;
+        vector<DependenceRecord> dependences;
+        if (cache->load(program, dependences)) {
+            simulateProgram(program, &dependences, opts);
+            return;
+        }
+    }
+
+    // Large inputs are parsed in pieces on the simulation's threads, and
+    // a check uses every core
+    int parseThreads = opts.numThreads;
+    if (parseThreads == 0)
+        parseThreads = opts.checkOnly ? thread::hardware_concurrency() : 1;
 
     // Determine if the input is in assembly or binary
     if (fileFormat == ".asm")
-        addInstructions <ASMParser> (ASMParser(argv[1]));
+        addInstructions <ASMParser> (ASMParser(filename, parseThreads, opts.execute), opts, cache.get());
     else if (fileFormat == ".mach")
-        addInstructions <BinaryParser> (BinaryParser(argv[1]));
+        addInstructions <BinaryParser> (BinaryParser(filename, parseThreads), opts, cache.get());
+    else if (fileFormat == ".trc")
+        addInstructions <TraceParser> (TraceParser(filename), opts, nullptr);
     else {
-        cerr << "The input file needs to be in '.asm' or '.mach' format." << endl;
+        cerr << "The input file needs to be in '.asm', '.mach' or '.trc' format." << endl;
         exit(1);
     }
 }
 
+// Parses standard input as fileFormat, reading it on a thread of its
+// own so the parser never waits on a full pipe, and simulates it
+void readStandardInput(string fileFormat, SimOptions& opts) {
+    InputReader reader(0);
+    istream in(&reader);
+    if (fileFormat == ".asm")
+        addInstructions <ASMParser> (ASMParser(in, opts.execute), opts, nullptr);
+    else
+        addInstructions <BinaryParser> (BinaryParser(in), opts, nullptr);
+}
+
 // This template function receives either a Binary or ASM Parser
 // It executes syntax checking and the simulation of the pipeline
+// If cache is given, it is filled in for the next run
 template <class ParserType> 
-void addInstructions(ParserType&& parser) {
+void addInstructions(ParserType&& parser, SimOptions& opts, ParseCache* cache) {
 
-    // Check for a correct format
+    // Check for a correct format, listing every line that is not
     if (parser.isFormatCorrect() == false) {
+        reportErrors(parser.getErrors(), opts);
         cerr << "The file format is incorrect." << endl;
         exit(1);
     }
 
-    // Create instances of all three pipelines
-    Pipeline pipeline;
-    unique_ptr<StallPipeline> stall(new StallPipeline());
-    unique_ptr<ForwardPipeline> forwarding(new ForwardPipeline());
-
     // Assemble lists of instructions
+    vector<Instruction> program;
     Instruction i;
     i = parser.getNextInstruction();
     while (i.getOpcode() != UNDEFINED) {
-        pipeline.addInstruction(i);
-        stall->addInstruction(i);
-        forwarding->addInstruction(i);
+        program.push_back(i);
         i = parser.getNextInstruction();
     }
-    
+
+    // A packed trace is streamed, so damage can turn up part way through
+    if (parser.isFormatCorrect() == false) {
+        cerr << "The file format is incorrect." << endl;
+        exit(1);
+    }
+
+    if (opts.checkOnly) {
+        cout << program.size() << " instructions, no errors." << endl;
+        return;
+    }
+
+    if (cache == nullptr) {
+        simulateProgram(program, nullptr, opts);
+        return;
+    }
+
+    // Find the dependences once for the sidecar, and let every model use them
+    DependencyChecker checker;
+    for (unsigned int k = 0; k < program.size(); k++)
+        checker.addInstruction(program[k]);
+    vector<DependenceRecord> dependences;
+    checker.getDependenceRecords(dependences);
+    cache->save(program, dependences);
+    simulateProgram(program, &dependences, opts);
+}
+
+// Prints each line of the input that could not be parsed
+void reportErrors(vector<ParseError>& errors, SimOptions& opts) {
+    string name = (opts.filename == "-") ? "<stdin>" : opts.filename;
+    for (unsigned int e = 0; e < errors.size(); e++)
+        cerr << name << ":" << errors[e].line << ": " << errors[e].message << endl;
+    if (errors.size() > 1)
+        cerr << errors.size() << " errors found." << endl;
+}
+
+// Simulates program as opts asks. dependences, if given, holds every
+// dependence between the listed instructions, found by an earlier run.
+// Returns the number of instructions simulated.
+long long simulateProgram(vector<Instruction>& program, vector<DependenceRecord>* dependences, SimOptions& opts) {
+    if (opts.verify) {
+        verifyEngines(program, opts);
+        return program.size();
+    }
+
+    // The instruction number each simulated instruction was fetched from,
+    // whether it redirected fetch, and the address read by each LB
+    vector<int> trace;
+    vector<bool> taken;
+    vector<uint32_t> loadAddresses;
+
+    // Either replay the instructions as listed, or run the program
+    // and simulate the instructions it commits
+    if (opts.execute) {
+        Executor executor;
+        executor.loadProgram(program);
+
+        // Translated blocks do not report load addresses
+        if (opts.translate && opts.dataCache)
+            cerr << "The data cache needs load addresses, so the program is interpreted." << endl;
+
+        if (opts.translate && !opts.dataCache) {
+            // Translated blocks report what they commit a block at a time
+            vector<BlockRecord> blocks;
+            executor.runTranslated(opts.maxSteps, &blocks);
+            for (unsigned int b = 0; b < blocks.size(); b++)
+                for (unsigned int k = 0; k < blocks[b].length; k++)
+                    trace.push_back(blocks[b].startPC + k);
+        }
+        else
+            executor.run(opts.maxSteps, &trace, opts.dataCache ? &loadAddresses : nullptr);
+
+        if (!executor.isHalted())
+            cerr << "Stopped after " << trace.size() << " instructions. Use --max-steps to run longer." << endl;
+
+        // Running off the end finishes a program, but a jump or branch
+        // anywhere else outside it is most likely a wrong target
+        else if (executor.getPC() != (int)program.size() && !trace.empty())
+            cerr << "Instruction " << trace.back() << " went to instruction " << executor.getPC()
+                 << ", outside the program, so the run ended after " << trace.size() << " instructions." << endl;
+
+        // An instruction redirected fetch if the next one committed
+        // does not follow it
+        for (unsigned int k = 0; k < trace.size(); k++) {
+            int next = (k + 1 < trace.size()) ? trace[k + 1] : executor.getPC();
+            taken.push_back(next != trace[k] + 1);
+        }
+    }
+    else {
+        // Listed instructions follow one another, so only jumps redirect fetch
+        for (unsigned int k = 0; k < program.size(); k++) {
+            trace.push_back(k);
+            taken.push_back(program[k].getOpcode() == J);
+        }
+
+        // Base registers hold whatever the listed instructions leave in them
+        if (opts.dataCache) {
+            Executor executor;
+            executor.loadProgram(program, true);
+            executor.run(-1, nullptr, &loadAddresses);
+        }
+    }
+
+    // Pack the instructions that would be simulated instead of timing them
+    if (opts.packFile.length() > 0) {
+        TraceWriter writer(opts.packFile);
+        for (unsigned int k = 0; k < trace.size(); k++)
+            writer.addWord(encodeInstruction(program[trace[k]]));
+        if (!writer.close()) {
+            cerr << "Could not write " << opts.packFile << endl;
+            exit(1);
+        }
+        cout << "Packed " << trace.size() << " instructions into " << writer.getBytesWritten() << " bytes" << endl;
+        return trace.size();
+    }
+
+    if (trace.size() <= opts.skip + opts.warmup) {
+        if (opts.skip + opts.warmup == 0)
+            cerr << "There are no instructions to time." << endl;
+        else
+            cerr << "There are no instructions left to time after --skip and --warmup." << endl;
+        exit(1);
+    }
+
+    // The stall and forwarding models share one block timing cache,
+    // which may hold blocks timed on earlier runs
+    unique_ptr<BlockTimingCache> blocks(opts.blockCache ? new BlockTimingCache() : nullptr);
+    if (blocks && opts.blockCacheFile.length() > 0 && ifstream(opts.blockCacheFile.c_str()).good()
+        && !blocks->load(opts.blockCacheFile))
+        cerr << opts.blockCacheFile << " is not a block timing cache, so every block is timed again." << endl;
+
+    // Sampling starts after the skipped prefix and uses its own warm up
+    if (opts.sampleInterval > 0) {
+        int skippedLoads = 0;
+        for (unsigned int k = 0; k < opts.skip; k++)
+            if (program[trace[k]].getOpcode() == LB)
+                skippedLoads++;
+        trace.erase(trace.begin(), trace.begin() + opts.skip);
+        taken.erase(taken.begin(), taken.begin() + opts.skip);
+        if (skippedLoads <= (int)loadAddresses.size())
+            loadAddresses.erase(loadAddresses.begin(), loadAddresses.begin() + skippedLoads);
+        simulateSampled(program, trace, taken, loadAddresses, blocks.get(), opts);
+        if (blocks)
+            finishBlockCache(*blocks, opts);
+        return trace.size();
+    }
+
+    // The models of a run take their dependences, instruction text and table
+    // lines from one arena, which later runs in this process start over
+    // in instead of going back to the heap
+    static Arena runArena;
+    runArena.reset();
+    ArenaScope scope(&runArena);
+
+    // Create instances of all three pipelines
+    Pipeline pipeline;
+    unique_ptr<StallPipeline> stall(new StallPipeline());
+    unique_ptr<ForwardPipeline> forwarding(new ForwardPipeline());
+
+    // And the superscalar model, if a width was asked for
+    unique_ptr<SuperscalarPipeline> superscalar(opts.width > 0 ? new SuperscalarPipeline(opts.width) : nullptr);
+    if (superscalar && opts.units[0] > 0)
+        superscalar->setUnits(opts.units[0], opts.units[1], opts.units[2], opts.units[3]);
+
+    // And the out of order model, if a window was asked for
+    unique_ptr<OutOfOrderPipeline> outOfOrder(opts.robSize > 0 ? new OutOfOrderPipeline(opts.robSize, opts.numStations, opts.oooWidth) : nullptr);
+
+    // Give every model that charges for branches its own predictor,
+    // and the stall and forwarding models their own data caches
+    configureModel(*stall, loadAddresses, blocks.get(), opts);
+    configureModel(*forwarding, loadAddresses, blocks.get(), opts);
+    if (superscalar && opts.predictor.length() > 0)
+        superscalar->setPredictor(BranchPredictor::create(opts.predictor), opts.flushPenalty);
+    if (outOfOrder && opts.predictor.length() > 0)
+        outOfOrder->setPredictor(BranchPredictor::create(opts.predictor), opts.flushPenalty);
+    if (superscalar)
+        superscalar->setExtrapolation(opts.extrapolate);
+    if (outOfOrder)
+        outOfOrder->setExtrapolation(opts.extrapolate);
+
+    // One model records when each instruction enters every stage
+    unique_ptr<TimelineRecorder> timeline;
+    string timelineFile = (opts.timelineFile.length() > 0) ? opts.timelineFile : opts.timelineIndexFile;
+    if (timelineFile.length() > 0) {
+        if (opts.timelineFile.length() > 0)
+            timeline.reset(new TimelineWriter(timelineFile));
+        else
+            timeline.reset(new TimelineIndexWriter(timelineFile));
+        if (!timeline->isGood()) {
+            cerr << "Could not write " << timelineFile << endl;
+            exit(1);
+        }
+        if (opts.timelineModel == "ideal")
+            pipeline.setTimeline(timeline.get());
+        else if (opts.timelineModel == "stall")
+            stall->setTimeline(timeline.get());
+        else if (opts.timelineModel == "superscalar")
+            superscalar->setTimeline(timeline.get());
+        else
+            forwarding->setTimeline(timeline.get());
+    }
+
+    // Listed instructions are simulated as they are, so the dependences
+    // found between them before hold, skipped ones included
+    if (dependences && !opts.execute) {
+        pipeline.useKnownDependences(dependences, 0);
+        stall->useKnownDependences(dependences, 0);
+        forwarding->useKnownDependences(dependences, 0);
+        if (superscalar)
+            superscalar->useKnownDependences(dependences, 0);
+        if (outOfOrder)
+            outOfOrder->useKnownDependences(dependences, 0);
+    }
+
+    // The skipped prefix only trains predictors and caches
+    for (unsigned int k = 0; k < trace.size(); k++) {
+        Instruction& inst = program[trace[k]];
+        if (k < opts.skip) {
+            stall->skipInstruction(inst, trace[k], taken[k]);
+            forwarding->skipInstruction(inst, trace[k], taken[k]);
+            if (superscalar)
+                superscalar->skipInstruction(inst, trace[k], taken[k]);
+            if (outOfOrder)
+                outOfOrder->skipInstruction(inst, trace[k], taken[k]);
+            pipeline.skipInstruction(inst, trace[k], taken[k]);
+            continue;
+        }
+
+        pipeline.addInstruction(inst, trace[k], taken[k]);
+        stall->addInstruction(inst, trace[k], taken[k]);
+        forwarding->addInstruction(inst, trace[k], taken[k]);
+        if (superscalar)
+            superscalar->addInstruction(inst, trace[k], taken[k]);
+        if (outOfOrder)
+            outOfOrder->addInstruction(inst, trace[k], taken[k]);
+    }
+
+    pipeline.setWarmup(opts.warmup);
+    stall->setWarmup(opts.warmup);
+    forwarding->setWarmup(opts.warmup);
+    if (superscalar)
+        superscalar->setWarmup(opts.warmup);
+    if (outOfOrder)
+        outOfOrder->setWarmup(opts.warmup);
+
     // Simulate the Pipeline
     cout << "Instr#\tCompletionTime\tMnemonic" << endl;
-    pipeline.runPipeline();
-    stall->runPipeline();
-    forwarding->runPipeline();
+    if (opts.numThreads > 0) {
+        pipeline.runPipelineParallel(opts.numThreads);
+        stall->runPipelineParallel(opts.numThreads);
+        forwarding->runPipelineParallel(opts.numThreads);
+    }
+    else if (blocks) {
+        // Blocks are timed by the parallel engine, which on one thread
+        // produces the same tables as the serial engines
+        pipeline.runPipeline();
+        stall->runPipelineParallel(1);
+        forwarding->runPipelineParallel(1);
+    }
+    else {
+        pipeline.runPipeline();
+        stall->runPipeline();
+        forwarding->runPipeline();
+    }
+
+    // Bundles are formed and instructions scheduled cycle by cycle, so
+    // these models always run serially
+    if (superscalar)
+        superscalar->runPipeline();
+    if (outOfOrder)
+        outOfOrder->runPipeline();
+
+    if (timeline && !timeline->close())
+        cerr << "Could not write " << timelineFile << endl;
+    if (blocks)
+        finishBlockCache(*blocks, opts);
+    return trace.size() - opts.skip;
+}
+
+// An engine's rate is the best of VERIFY_SAMPLES samples, each of which
+// repeats the simulation until it has run for VERIFY_SAMPLE_SECONDS
+static const int VERIFY_SAMPLES = 7;
+static const double VERIFY_SAMPLE_SECONDS = 0.1;
+
+// Programs simulating fewer instructions than this are not held to the
+// stored rates, since their runs are mostly setup
+static const long long MIN_GATED_INSTRUCTIONS = 10000;
+
+// One way of timing a program, checked against the serial engines
+struct EngineCheck {
+    string name;
+    int numThreads;
+    bool blockCache;
+    bool extrapolate;
+    bool knownDependences;
+};
+
+// Returns the first line where two outputs differ, counting from 1, or
+// 0 if they are the same. The block timing cache's own report is skipped.
+static long long firstDifference(const string& a, const string& b) {
+    istringstream linesA(a), linesB(b);
+    string lineA, lineB;
+    long long line = 0;
+    while (true) {
+        bool moreA = (bool)getline(linesA, lineA);
+        bool moreB = (bool)getline(linesB, lineB);
+        while (moreB && lineB.compare(0, 19, "Block timing cache:") == 0)
+            moreB = (bool)getline(linesB, lineB);
+        line++;
+        if (!moreA && !moreB)
+            return 0;
+        if (moreA != moreB || lineA != lineB)
+            return line;
+    }
+}
+
+// Simulates program with every timing engine, checking that each prints
+// the same tables as the serial engines and runs about as fast as the
+// rates in opts.verifyBaseline. Exits with 1 if one does not.
+void verifyEngines(vector<Instruction>& program, SimOptions& opts) {
+    // The first engine is the reference: the serial cycle by cycle loops
+    // with nothing remembered or skipped
+    EngineCheck engines[] = {
+        { "serial", 0, false, false, false },
+        { "parallel-1", 1, false, false, false },
+        { "parallel-4", 4, false, false, false },
+        { "block-cache", 0, true, false, false },
+        { "extrapolate", 0, false, true, false },
+        { "known-dependences", 0, false, false, true },
+    };
+    int numEngines = sizeof(engines) / sizeof(engines[0]);
+
+    // Rates stored by an earlier run, in instructions per second
+    map<string, double> baseline;
+    ifstream stored(opts.verifyBaseline.c_str());
+    string name;
+    double rate;
+    while (stored >> name >> rate)
+        baseline[name] = rate;
+
+    // Dependences are only known ahead for instructions replayed as listed
+    vector<DependenceRecord> dependences;
+    if (!opts.execute) {
+        DependencyChecker checker;
+        for (unsigned int k = 0; k < program.size(); k++)
+            checker.addInstruction(program[k]);
+        checker.getDependenceRecords(dependences);
+    }
 
-}
\ No newline at end of file
+    // Each engine's first run prints the tables that are compared
+    vector<SimOptions> engineOpts(numEngines, opts);
+    vector<string> outputs(numEngines);
+    long long simulated = 0;
+    for (int e = 0; e < numEngines; e++) {
+        engineOpts[e].verify = false;
+        engineOpts[e].numThreads = engines[e].numThreads;
+        engineOpts[e].blockCache = engines[e].blockCache;
+        engineOpts[e].blockCacheFile = "";
+        engineOpts[e].extrapolate = engines[e].extrapolate;
+        bool known = engines[e].knownDependences && !opts.execute;
+
+        ostringstream output;
+        streambuf* console = cout.rdbuf(output.rdbuf());
+        simulated = simulateProgram(program, known ? &dependences : nullptr, engineOpts[e]);
+        cout.rdbuf(console);
+        outputs[e] = output.str();
+    }
+
+    // Then the engines take turns being timed, so a stretch where the host
+    // is slow costs each of them one sample rather than all of one's
+    map<string, double> rates;
+    ostringstream discard;
+    streambuf* console = cout.rdbuf(discard.rdbuf());
+    for (int sample = 0; sample < VERIFY_SAMPLES; sample++)
+        for (int e = 0; e < numEngines; e++) {
+            bool known = engines[e].knownDependences && !opts.execute;
+            long long instructions = 0;
+            double seconds = 0;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            while (seconds < VERIFY_SAMPLE_SECONDS) {
+                instructions += simulateProgram(program, known ? &dependences : nullptr, engineOpts[e]);
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                discard.str("");
+            }
+            rates[engines[e].name] = max(rates[engines[e].name], instructions / seconds);
+        }
+    cout.rdbuf(console);
+
+    bool passed = true;
+    for (int e = 0; e < numEngines; e++) {
+        cout << left << setw(20) << engines[e].name << right << setw(14) << (long long)rates[engines[e].name] << " instructions/s  ";
+        long long line = firstDifference(outputs[0], outputs[e]);
+        if (line > 0) {
+            cout << "DIFFERS at line " << line;
+            passed = false;
+        }
+        else
+            cout << "same";
+
+        // A rate well below the stored one fails too
+        map<string, double>::iterator previous = baseline.find(engines[e].name);
+        if (previous != baseline.end() && simulated >= MIN_GATED_INSTRUCTIONS) {
+            double change = 100.0 * (rates[engines[e].name] / previous->second - 1);
+            cout << "  " << showpos << fixed << setprecision(1) << change << "%" << noshowpos;
+            cout.unsetf(ios::fixed);
+            if (change < -opts.maxSlowdown) {
+                cout << " SLOWER than allowed";
+                passed = false;
+            }
+        }
+        cout << endl;
+    }
+
+    if (opts.verifyBaseline.length() > 0 && simulated < MIN_GATED_INSTRUCTIONS)
+        cout << "Rates not checked: fewer than " << MIN_GATED_INSTRUCTIONS << " instructions are simulated" << endl;
+
+    // The first run with a baseline file records the rates to hold to
+    else if (opts.verifyBaseline.length() > 0 && baseline.empty()) {
+        ofstream out(opts.verifyBaseline.c_str());
+        for (int e = 0; e < numEngines; e++)
+            out << engines[e].name << " " << rates[engines[e].name] << endl;
+        if (out.fail())
+            cerr << "Could not write " << opts.verifyBaseline << endl;
+        else
+            cout << "Rates stored in " << opts.verifyBaseline << endl;
+    }
+
+    if (!passed) {
+        cerr << "Verification failed." << endl;
+        exit(1);
+    }
+}
+
+// Gives a stall or forwarding model the predictor, data cache and
+// block timing cache asked for
+void configureModel(Pipeline& model, vector<uint32_t>& loadAddresses, BlockTimingCache* blocks, SimOptions& opts) {
+    if (opts.predictor.length() > 0)
+        model.setPredictor(BranchPredictor::create(opts.predictor), opts.flushPenalty);
+    if (opts.dataCache) {
+        model.setDataCache(new DataCache(opts.l1, opts.l2, opts.memoryLatency, opts.replacement, opts.writes), opts.numMSHRs);
+        model.setLoadAddresses(loadAddresses);
+    }
+    model.setBlockCache(blocks);
+}
+
+// Reports how well the block timing cache did and keeps it for the next
+// run, if a file was given
+void finishBlockCache(BlockTimingCache& blocks, SimOptions& opts) {
+    long long lookups = blocks.getHits() + blocks.getMisses();
+    cout << "Block timing cache: " << blocks.getHits() << " of " << lookups << " blocks found, ";
+    cout << blocks.size() << " blocks known" << endl;
+    if (opts.blockCacheFile.length() > 0 && !blocks.save(opts.blockCacheFile))
+        cerr << "Could not write " << opts.blockCacheFile << endl;
+}
+
+// Returns the cycles a model of type PipelineType takes for instructions
+// begin to end of the trace, after warming up on the warmup before them
+template <class PipelineType>
+long long measureSlice(vector<Instruction>& program, vector<int>& trace, vector<bool>& taken,
+                       vector<uint32_t>& loadAddresses, vector<int>& loadsBefore,
+                       long long begin, long long end, int warmup, BlockTimingCache* blocks, SimOptions& opts) {
+    long long first = (begin > warmup) ? begin - warmup : 0;
+    PipelineType model;
+    for (long long k = first; k < end; k++)
+        model.addInstruction(program[trace[k]], trace[k], taken[k]);
+
+    vector<uint32_t> sliceAddresses;
+    if (opts.dataCache) {
+        int firstLoad = loadsBefore[first];
+        int lastLoad = loadsBefore[end];
+        if (lastLoad <= (int)loadAddresses.size())
+            sliceAddresses.assign(loadAddresses.begin() + firstLoad, loadAddresses.begin() + lastLoad);
+    }
+    configureModel(model, sliceAddresses, blocks, opts);
+    return model.measureCycles(begin - first);
+}
+
+// Estimates the stall and forwarding total times from a few representative
+// intervals of the trace, chosen by their basic block vectors
+void simulateSampled(vector<Instruction>& program, vector<int>& trace, vector<bool>& taken,
+                     vector<uint32_t>& loadAddresses, BlockTimingCache* blocks, SimOptions& opts) {
+    if (trace.size() == 0) {
+        cerr << "Instructions didn't read correctly. Check input file." << endl;
+        exit(1);
+    }
+
+    // One cheap pass builds the basic block vectors, and counts loads so
+    // each slice can be handed its own load addresses
+    BBVSampler sampler(opts.sampleInterval);
+    vector<int> loadsBefore(trace.size() + 1, 0);
+    for (unsigned int k = 0; k < trace.size(); k++) {
+        sampler.addInstruction(trace[k], taken[k]);
+        loadsBefore[k + 1] = loadsBefore[k] + (program[trace[k]].getOpcode() == LB ? 1 : 0);
+    }
+    vector<SimPoint> points = sampler.choosePoints(opts.sampleClusters);
+
+    // Each slice's model is done with before the next is built, so they
+    // all reuse the same arena blocks
+    Arena sliceArena;
+    ArenaScope scope(&sliceArena);
+
+    long long simulated = 0;
+    for (int model = 0; model < 2; model++) {
+        double estimate = 0;
+        double variance = 0;
+
+        for (unsigned int p = 0; p < points.size(); p++) {
+            long long begin = sampler.getIntervalStart(points[p].interval);
+            long long end = begin + sampler.getIntervalSize(points[p].interval);
+            long long cycles = (model == 0)
+                ? measureSlice<StallPipeline>(program, trace, taken, loadAddresses, loadsBefore, begin, end, opts.sampleWarmup, blocks, opts)
+                : measureSlice<ForwardPipeline>(program, trace, taken, loadAddresses, loadsBefore, begin, end, opts.sampleWarmup, blocks, opts);
+            sliceArena.reset();
+            double cpi = (double)cycles / (end - begin);
+            estimate += cpi * points[p].instructions;
+            if (model == 0)
+                simulated += end - begin + ((begin > opts.sampleWarmup) ? opts.sampleWarmup : begin);
+
+            // How far a second member of the cluster strays from the
+            // representative gives the error of standing in for it
+            if (points[p].check >= 0) {
+                long long checkBegin = sampler.getIntervalStart(points[p].check);
+                long long checkEnd = checkBegin + sampler.getIntervalSize(points[p].check);
+                long long checkCycles = (model == 0)
+                    ? measureSlice<StallPipeline>(program, trace, taken, loadAddresses, loadsBefore, checkBegin, checkEnd, opts.sampleWarmup, blocks, opts)
+                    : measureSlice<ForwardPipeline>(program, trace, taken, loadAddresses, loadsBefore, checkBegin, checkEnd, opts.sampleWarmup, blocks, opts);
+                sliceArena.reset();
+                double stray = ((double)checkCycles / (checkEnd - checkBegin) - cpi) * points[p].instructions;
+                variance += stray * stray;
+                if (model == 0)
+                    simulated += checkEnd - checkBegin + ((checkBegin > opts.sampleWarmup) ? opts.sampleWarmup : checkBegin);
+            }
+        }
+
+        cout << ((model == 0) ? "STALL (sampled):" : "FORWARDING (sampled):") << endl;
+        cout << "Estimated total time is " << (long long)(estimate + 0.5) << " (CPI " << estimate / trace.size();
+        cout << ", error about " << (estimate > 0 ? 100.0 * sqrt(variance) / estimate : 0.0) << "%)" << endl << endl;
+    }
+
+    cout << sampler.getNumIntervals() << " intervals of " << opts.sampleInterval << " instructions in ";
+    cout << points.size() << " clusters. Simulated " << simulated << " of " << trace.size() << " instructions." << endl;
+}
@@ -8,6 +8,12 @@ using namespace std;
 typedef int Register;
 const int NumRegisters = 32;
 
+// HI and LO are outside the register file, but dependences through them
+// are tracked as if they were the two registers after it
+const int HIRegister = NumRegisters;
+const int LORegister = NumRegisters + 1;
+const int NumDependenceRegisters = NumRegisters + 2;
+
 // Each register has a number and a string name
 struct RegisterEntry {
     string name;
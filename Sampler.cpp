@@ -0,0 +1,163 @@
+// Palmer Robins
+
+#include "Sampler.h"
+
+#include <stdint.h>
+
+// Iterations of k-means before giving up on convergence
+static const int KMEANS_ITERATIONS = 30;
+
+// Returns a repeatable pseudo random weight in [-1, 1] for a block and dimension
+static double projectionWeight(int block, int dimension) {
+    uint64_t x = (uint64_t)(uint32_t)block * 0x9E3779B97F4A7C15ULL + (uint64_t)dimension * 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 31;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 29;
+    return (double)(x >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+// Creates a sampler for intervals of intervalLength instructions
+BBVSampler::BBVSampler(int intervalLength) {
+    myIntervalLength = intervalLength;
+    myCount = 0;
+    myBlockStart = 0;
+    myBlockEnded = true;
+}
+
+// Counts the next committed instruction, which was fetched from
+// instruction number pc. taken is true if it redirected fetch.
+void BBVSampler::addInstruction(int pc, bool taken) {
+    if (myBlockEnded)
+        myBlockStart = pc;
+    myBlockEnded = taken;
+    myBlockCounts[myBlockStart]++;
+
+    if (++myCount == myIntervalLength)
+        finishInterval();
+}
+
+// Returns the number of instructions in an interval
+int BBVSampler::getIntervalSize(int interval) {
+    if (interval < (int)myIntervalSizes.size())
+        return myIntervalSizes[interval];
+    return myCount;
+}
+
+// Projects the current interval's block counts into a new vector
+void BBVSampler::finishInterval() {
+    double projected[DIMENSIONS] = { 0 };
+    for (unordered_map<int, int>::iterator it = myBlockCounts.begin(); it != myBlockCounts.end(); it++) {
+        double share = (double)it->second / myCount;
+        for (int d = 0; d < DIMENSIONS; d++)
+            projected[d] += share * projectionWeight(it->first, d);
+    }
+
+    myVectors.insert(myVectors.end(), projected, projected + DIMENSIONS);
+    myIntervalSizes.push_back(myCount);
+    myBlockCounts.clear();
+    myCount = 0;
+}
+
+// Returns the squared distance between interval a's vector and point b
+double BBVSampler::distance(int a, const double* b) {
+    double sum = 0;
+    for (int d = 0; d < DIMENSIONS; d++) {
+        double diff = myVectors[a * DIMENSIONS + d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Clusters the intervals into at most numClusters groups and returns
+// one simulation point per group
+vector<SimPoint> BBVSampler::choosePoints(int numClusters) {
+    if (myCount > 0)
+        finishInterval();
+
+    int numIntervals = myIntervalSizes.size();
+    if (numClusters > numIntervals)
+        numClusters = numIntervals;
+    vector<SimPoint> points;
+    if (numClusters == 0)
+        return points;
+
+    // Seed the centers by always taking the interval farthest from every
+    // center so far, which is repeatable and spreads the centers out
+    vector<double> centers(numClusters * DIMENSIONS);
+    vector<double> nearest(numIntervals, 1e300);
+    int pick = 0;
+    for (int c = 0; c < numClusters; c++) {
+        for (int d = 0; d < DIMENSIONS; d++)
+            centers[c * DIMENSIONS + d] = myVectors[pick * DIMENSIONS + d];
+        int farthest = 0;
+        for (int i = 0; i < numIntervals; i++) {
+            double dist = distance(i, &centers[c * DIMENSIONS]);
+            if (dist < nearest[i])
+                nearest[i] = dist;
+            if (nearest[i] > nearest[farthest])
+                farthest = i;
+        }
+        pick = farthest;
+    }
+
+    // Lloyd's iterations
+    vector<int> cluster(numIntervals, -1);
+    for (int iteration = 0; iteration < KMEANS_ITERATIONS; iteration++) {
+        bool changed = false;
+        for (int i = 0; i < numIntervals; i++) {
+            int best = 0;
+            double bestDistance = distance(i, &centers[0]);
+            for (int c = 1; c < numClusters; c++) {
+                double dist = distance(i, &centers[c * DIMENSIONS]);
+                if (dist < bestDistance) {
+                    best = c;
+                    bestDistance = dist;
+                }
+            }
+            if (cluster[i] != best) {
+                cluster[i] = best;
+                changed = true;
+            }
+        }
+        if (!changed)
+            break;
+
+        vector<int> sizes(numClusters, 0);
+        for (unsigned int v = 0; v < centers.size(); v++)
+            centers[v] = 0;
+        for (int i = 0; i < numIntervals; i++) {
+            sizes[cluster[i]]++;
+            for (int d = 0; d < DIMENSIONS; d++)
+                centers[cluster[i] * DIMENSIONS + d] += myVectors[i * DIMENSIONS + d];
+        }
+        for (int c = 0; c < numClusters; c++)
+            for (int d = 0; d < DIMENSIONS; d++)
+                centers[c * DIMENSIONS + d] /= (sizes[c] > 0) ? sizes[c] : 1;
+    }
+
+    // The interval nearest each center represents it. The member farthest along
+    // the trace from it serves as a check on how alike the cluster really is.
+    for (int c = 0; c < numClusters; c++) {
+        SimPoint point;
+        point.interval = point.check = -1;
+        point.instructions = 0;
+        double bestDistance = 0;
+        for (int i = 0; i < numIntervals; i++) {
+            if (cluster[i] != c)
+                continue;
+            point.instructions += myIntervalSizes[i];
+            double dist = distance(i, &centers[c * DIMENSIONS]);
+            if (point.interval < 0 || dist < bestDistance) {
+                point.interval = i;
+                bestDistance = dist;
+            }
+        }
+        if (point.interval < 0)
+            continue;
+        for (int i = numIntervals - 1; i >= 0 && point.check < 0; i--)
+            if (cluster[i] == c && i != point.interval)
+                point.check = i;
+        points.push_back(point);
+    }
+    return points;
+}
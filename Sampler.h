@@ -0,0 +1,72 @@
+// Palmer Robins
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A SimPoint is an interval chosen to stand for a cluster of intervals
+ * whose basic block vectors are alike.
+ */
+struct SimPoint {
+    int interval; // the representative interval
+    int check; // another interval of the cluster, used to estimate error, or -1
+    long long instructions; // instructions in the whole cluster
+};
+
+/**
+ * BBVSampler splits a committed instruction stream into fixed length
+ * intervals and builds a basic block vector for each one in a single pass.
+ * Vectors are randomly projected down to a few dimensions, as SimPoint
+ * does, and clustered with k-means to pick the intervals to simulate.
+ */
+class BBVSampler {
+
+    public:
+
+        // Dimensions each basic block vector is projected down to
+        static const int DIMENSIONS = 15;
+
+        // Creates a sampler for intervals of intervalLength instructions
+        BBVSampler(int intervalLength);
+
+        // Counts the next committed instruction, which was fetched from
+        // instruction number pc. taken is true if it redirected fetch.
+        void addInstruction(int pc, bool taken);
+
+        // Clusters the intervals into at most numClusters groups and returns
+        // one simulation point per group
+        vector<SimPoint> choosePoints(int numClusters);
+
+        // Returns the number of intervals seen so far
+        int getNumIntervals() { return myIntervalSizes.size() + (myCount > 0 ? 1 : 0); }
+
+        // Returns the first instruction of an interval
+        long long getIntervalStart(int interval) { return (long long)interval * myIntervalLength; }
+
+        // Returns the number of instructions in an interval
+        int getIntervalSize(int interval);
+
+    private:
+
+        // Projects the current interval's block counts into a new vector
+        void finishInterval();
+
+        // Returns the squared distance between interval a's vector and point b
+        double distance(int a, const double* b);
+
+        int myIntervalLength;
+        int myCount; // instructions in the current interval
+        int myBlockStart; // instruction number the current basic block started at
+        bool myBlockEnded; // true if the last instruction ended its block
+
+        unordered_map<int, int> myBlockCounts; // instructions per block in the current interval
+        vector<double> myVectors; // DIMENSIONS values per finished interval
+        vector<int> myIntervalSizes; // instructions in each finished interval
+};
+
+#endif
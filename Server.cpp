@@ -0,0 +1,638 @@
+// Palmer Robins
+
+#include "Server.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#if defined(__unix__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#define CAN_SERVE 1
+#else
+#define CAN_SERVE 0
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#define HAVE_MEMFD 1
+#else
+#define HAVE_MEMFD 0
+#endif
+
+// Longest request line accepted, so a client cannot grow the buffer forever
+static const size_t MAX_LINE = 1 << 16;
+
+// Most input bytes a request may send with it
+static const size_t MAX_REQUEST_INPUT = 1 << 28;
+
+// Bytes of a run's output held before they are written to the server
+static const size_t OUTPUT_BATCH = 1 << 16;
+
+#if CAN_SERVE
+
+/**
+ * RequestReader buffers what a client sends, so requests can be read a
+ * line at a time while a run is watched for CANCEL.
+ */
+class RequestReader {
+
+    public:
+
+        RequestReader(int fd) { myFd = fd; myClosed = false; }
+
+        int getFd() { return myFd; }
+
+        // Returns true once the client has closed its end
+        bool isClosed() { return myClosed; }
+
+        // Reads whatever the client has sent. Returns false if nothing
+        // could be read because the client closed its end.
+        bool fill() {
+            char chunk[4096];
+            ssize_t n;
+            do
+                n = read(myFd, chunk, sizeof(chunk));
+            while (n < 0 && errno == EINTR);
+            if (n <= 0) {
+                myClosed = true;
+                return false;
+            }
+            myBuffer.append(chunk, n);
+            return true;
+        }
+
+        // Returns true, and drops the line, if the next line read is CANCEL
+        bool takeCancel() {
+            size_t end = myBuffer.find('\n');
+            if (end == string::npos)
+                return false;
+            string line = myBuffer.substr(0, end);
+            if (line != "CANCEL" && line != "CANCEL\r")
+                return false;
+            myBuffer.erase(0, end + 1);
+            return true;
+        }
+
+        // Sets line to the next line, without its newline. Returns false
+        // if the client closes before finishing one, or it is too long.
+        bool readLine(string& line) {
+            size_t end;
+            while ((end = myBuffer.find('\n')) == string::npos)
+                if (myBuffer.length() > MAX_LINE || !fill())
+                    return false;
+            line = myBuffer.substr(0, end);
+            myBuffer.erase(0, end + 1);
+            if (line.length() > 0 && line[line.length() - 1] == '\r')
+                line.erase(line.length() - 1);
+            return true;
+        }
+
+        // Sets bytes to the next count bytes. Returns false if the client
+        // closes before sending them all.
+        bool readBytes(size_t count, string& bytes) {
+            while (myBuffer.length() < count)
+                if (!fill())
+                    return false;
+            bytes = myBuffer.substr(0, count);
+            myBuffer.erase(0, count);
+            return true;
+        }
+
+    private:
+
+        int myFd;
+        bool myClosed;
+        string myBuffer; // read but not yet used
+};
+
+// Writes all of text to fd. A client that has gone away is ignored.
+static void writeAll(int fd, const string& text) {
+    size_t done = 0;
+    while (done < text.length()) {
+        ssize_t n = write(fd, text.data() + done, text.length() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        done += n;
+    }
+}
+
+/**
+ * BatchedOutput stands in for a run's cout and cerr. The tables end every
+ * line with endl, and a write to the server per line costs more than
+ * the rest of a short run, so output is written OUTPUT_BATCH bytes at a
+ * time and the rest when the run exits.
+ */
+class BatchedOutput : public streambuf {
+
+    public:
+
+        BatchedOutput(int fd) { myFd = fd; }
+
+        // Writes everything held
+        void flushAll() {
+            writeAll(myFd, myBuffer);
+            myBuffer.clear();
+        }
+
+    protected:
+
+        int overflow(int c) {
+            if (c != EOF) {
+                char byte = c;
+                xsputn(&byte, 1);
+            }
+            return c;
+        }
+
+        streamsize xsputn(const char* text, streamsize count) {
+            myBuffer.append(text, count);
+            if (myBuffer.length() >= OUTPUT_BATCH)
+                flushAll();
+            return count;
+        }
+
+        // endl asks for a write; it waits for the batch
+        int sync() { return 0; }
+
+    private:
+
+        int myFd;
+        string myBuffer;
+};
+
+// The run's standard output and error, written out however it exits
+static BatchedOutput* runOutput[2];
+
+// Writes what the run left in its output batches
+static void flushRunOutput() {
+    for (int s = 0; s < 2; s++)
+        if (runOutput[s])
+            runOutput[s]->flushAll();
+}
+
+// Returns the milliseconds of a clock that only moves forward
+static long long nowMillis() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Returns true if s is a non-negative decimal number that fits in a long long
+static bool isNumber(const string& s) {
+    if (s.length() == 0 || s.length() > 18)
+        return false;
+    for (unsigned int i = 0; i < s.length(); i++)
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+    return true;
+}
+
+// Stores input where the run can read it and points opts.filename at it.
+// Where there is memfd_create the input stays in memory and opts.format
+// says what it is; otherwise it is a file in directory named for the
+// extension of the input's name, so the parsers see the right format.
+// Returns false if it could not be stored.
+static bool storeInput(const string& directory, const string& input, SimOptions& opts) {
+    string name = opts.filename;
+    size_t dot = name.rfind('.');
+    string extension = (dot == string::npos || name.find('/', dot) != string::npos) ? "" : name.substr(dot);
+#if HAVE_MEMFD
+    int fd = memfd_create("pipesim-input", 0);
+    string path = "/proc/self/fd/" + to_string(fd);
+    if (opts.format.length() == 0 && extension.length() > 1)
+        opts.format = extension.substr(1);
+#else
+    string path = directory + "/input" + extension;
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+#endif
+    if (fd < 0)
+        return false;
+    writeAll(fd, input);
+    bool written = (lseek(fd, 0, SEEK_CUR) == (off_t)input.length());
+#if !HAVE_MEMFD
+    close(fd);
+#endif
+    opts.filename = path;
+    return written;
+}
+
+// Appends text to message, after its length
+static void appendString(string& message, const string& text) {
+    uint64_t length = text.length();
+    message.append((const char*)&length, sizeof(length));
+    message.append(text);
+}
+
+// Reads count bytes from fd into data. Returns false if fd closes first.
+static bool readAll(int fd, char* data, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+        ssize_t n = read(fd, data + done, count - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+// Reads a string appendString wrote from fd. Returns false if fd closes first.
+static bool readString(int fd, string& text) {
+    uint64_t length;
+    if (!readAll(fd, (char*)&length, sizeof(length)) || length > MAX_REQUEST_INPUT)
+        return false;
+    text.resize(length);
+    return length == 0 || readAll(fd, &text[0], length);
+}
+
+// Removes directory and the files in it
+static void removeDirectory(const string& directory) {
+    DIR* dir = opendir(directory.c_str());
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr)
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, ".."))
+                unlink((directory + "/" + entry->d_name).c_str());
+        closedir(dir);
+    }
+    rmdir(directory.c_str());
+}
+
+// Creates a server that runs requests through simulate
+SimServer::SimServer(Simulator simulate) {
+    mySimulate = simulate;
+}
+
+// Serves requests read from standard input until it closes
+void SimServer::serveStream() {
+    signal(SIGPIPE, SIG_IGN);
+    serveConnection(0, 1);
+}
+
+// Serves requests on the Unix domain socket path. Returns false if
+// it cannot listen there; otherwise it never returns.
+bool SimServer::serveSocket(string path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.length() >= sizeof(address.sun_path)) {
+        cerr << "The socket path " << path << " is too long." << endl;
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    // A socket left by an earlier server is replaced, but nothing else is
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        cerr << "Could not listen on " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    // Connection processes are never waited for
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGCHLD, SIG_IGN);
+    cout << "Serving on " << path << endl;
+
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            signal(SIGCHLD, SIG_DFL);
+            serveConnection(client, client);
+            close(client);
+            _exit(0);
+        }
+        close(client);
+    }
+}
+
+// Forks a process that waits for a request on run.request, runs it, and
+// writes its output to run.output. The process closes the connection's
+// in and out. Returns false if it could not.
+bool SimServer::startRun(Run& run, int in, int out) {
+    int request[2], outPipe[2], errPipe[2];
+    if (pipe(request) != 0)
+        return false;
+    if (pipe(outPipe) != 0) {
+        close(request[0]);
+        close(request[1]);
+        return false;
+    }
+    if (pipe(errPipe) != 0) {
+        close(request[0]);
+        close(request[1]);
+        close(outPipe[0]);
+        close(outPipe[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // The run writes its tables and messages to the pipes
+        if (in > 2)
+            close(in);
+        if (out > 2 && out != in)
+            close(out);
+        int nothing = open("/dev/null", O_RDONLY);
+        dup2(nothing, 0);
+        dup2(outPipe[1], 1);
+        dup2(errPipe[1], 2);
+        close(request[1]);
+        close(outPipe[0]);
+        close(errPipe[0]);
+        runRequest(request[0]);
+    }
+    close(request[0]);
+    close(outPipe[1]);
+    close(errPipe[1]);
+    if (pid < 0) {
+        close(request[1]);
+        close(outPipe[0]);
+        close(errPipe[0]);
+        return false;
+    }
+    run.pid = pid;
+    run.request = request[1];
+    run.output[0] = outPipe[0];
+    run.output[1] = errPipe[0];
+    return true;
+}
+
+// In a process startRun forked, reads the request from fd, runs it and exits
+void SimServer::runRequest(int fd) {
+    string directory, input, count;
+    if (!readString(fd, directory) || !readString(fd, input) || !readString(fd, count))
+        _exit(0); // the server let the run go unused
+    vector<string> arguments(atoi(count.c_str()));
+    for (unsigned int a = 0; a < arguments.size(); a++)
+        if (!readString(fd, arguments[a]))
+            _exit(0);
+    close(fd);
+
+    runOutput[0] = new BatchedOutput(1);
+    runOutput[1] = new BatchedOutput(2);
+    cout.rdbuf(runOutput[0]);
+    cerr.rdbuf(runOutput[1]);
+    atexit(flushRunOutput);
+
+    vector<char*> argv;
+    for (unsigned int a = 0; a < arguments.size(); a++)
+        argv.push_back(&arguments[a][0]);
+    argv.push_back(nullptr);
+
+    SimOptions opts;
+    if (!parseOptions(argv.size() - 1, argv.data(), opts))
+        exit(1);
+    if (opts.serve.length() > 0) {
+        cerr << "--serve cannot be used in a request." << endl;
+        exit(1);
+    }
+    if (input.length() > 0) {
+        if (!storeInput(directory, input, opts)) {
+            cerr << "Could not store the input." << endl;
+            exit(1);
+        }
+        // The input is never seen again, so it needs no sidecar
+        opts.parseCache = false;
+    }
+    mySimulate(opts);
+    exit(0);
+}
+
+// Serves the requests read from in, answering them on out
+void SimServer::serveConnection(int in, int out) {
+    RequestReader reader(in);
+    string line;
+
+    // The process for the next request is forked while the client is
+    // still sending it, so the fork is not part of the request's time
+    Run run;
+    bool haveRun = false;
+
+    while (true) {
+        if (!haveRun)
+            haveRun = startRun(run, in, out);
+        if (!reader.readLine(line))
+            break;
+
+        istringstream words(line);
+        string command;
+        words >> command;
+        if (command.length() == 0)
+            continue;
+        if (command == "QUIT")
+            break;
+        if (command == "CANCEL")
+            continue; // nothing is running
+        if (command != "RUN") {
+            writeAll(out, "ERROR unknown request " + command + "\n");
+            continue;
+        }
+
+        string timeoutText, lengthText;
+        words >> timeoutText >> lengthText;
+        if (!isNumber(timeoutText) || !isNumber(lengthText)) {
+            writeAll(out, "ERROR RUN needs a timeout and an input length\n");
+            continue;
+        }
+        long long timeout = atoll(timeoutText.c_str());
+        long long length = atoll(lengthText.c_str());
+        if (length > (long long)MAX_REQUEST_INPUT) {
+            writeAll(out, "ERROR the input is too long\n");
+            break;
+        }
+        vector<string> arguments(1, "PIPESIM");
+        string word;
+        while (words >> word)
+            arguments.push_back(word);
+
+        string input;
+        if (!reader.readBytes(length, input))
+            break;
+
+        // Input sent with the request is kept in memory, or else goes in a
+        // directory of its own, which is removed however the run ends
+        string directory;
+        if (input.length() > 0 && !HAVE_MEMFD) {
+            char name[] = "/tmp/pipesim-XXXXXX";
+            if (mkdtemp(name) == nullptr) {
+                writeAll(out, "ERROR could not store the input\n");
+                continue;
+            }
+            directory = name;
+        }
+
+        if (!haveRun && !(haveRun = startRun(run, in, out))) {
+            if (directory.length() > 0)
+                removeDirectory(directory);
+            writeAll(out, "ERROR could not start the run\n");
+            continue;
+        }
+        haveRun = false;
+        pid_t pid = run.pid;
+
+        // Hand the request to the run
+        string message;
+        appendString(message, directory);
+        appendString(message, input);
+        appendString(message, to_string(arguments.size()));
+        for (unsigned int a = 0; a < arguments.size(); a++)
+            appendString(message, arguments[a]);
+        writeAll(run.request, message);
+        close(run.request);
+
+        // Collect the run's output until it finishes, stopping it if it
+        // runs out of time or the client cancels it
+        string outcome = "DONE";
+        string output[2];
+        int fds[2] = { run.output[0], run.output[1] };
+        bool reading[2] = { true, true };
+        long long deadline = nowMillis() + timeout;
+        bool running = true;
+
+        while (reading[0] || reading[1]) {
+            struct pollfd polls[3];
+            int numPolls = 0;
+            for (int p = 0; p < 2; p++)
+                if (reading[p]) {
+                    polls[numPolls].fd = fds[p];
+                    polls[numPolls].events = POLLIN;
+                    numPolls++;
+                }
+            int clientPoll = -1;
+            if (running && !reader.isClosed()) {
+                clientPoll = numPolls;
+                polls[numPolls].fd = reader.getFd();
+                polls[numPolls].events = POLLIN;
+                numPolls++;
+            }
+
+            int wait = -1;
+            if (running && timeout > 0) {
+                long long left = deadline - nowMillis();
+                wait = (left > INT_MAX) ? INT_MAX : (left > 0) ? (int)left : 0;
+            }
+            int ready = poll(polls, numPolls, wait);
+            if (ready < 0 && errno != EINTR)
+                break;
+
+            if (running && timeout > 0 && nowMillis() >= deadline) {
+                kill(pid, SIGKILL);
+                running = false;
+                outcome = "TIMEOUT";
+            }
+            if (ready <= 0)
+                continue;
+
+            for (int p = 0, q = 0; p < 2; p++) {
+                if (!reading[p])
+                    continue;
+                if (polls[q].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    char chunk[65536];
+                    ssize_t n = read(fds[p], chunk, sizeof(chunk));
+                    if (n > 0)
+                        output[p].append(chunk, n);
+                    else if (n == 0 || errno != EINTR)
+                        reading[p] = false;
+                }
+                q++;
+            }
+
+            // Only CANCEL is looked at while a request runs; anything else
+            // waits for the next request
+            if (clientPoll >= 0 && (polls[clientPoll].revents & (POLLIN | POLLHUP | POLLERR))) {
+                reader.fill();
+                if (reader.takeCancel()) {
+                    kill(pid, SIGKILL);
+                    running = false;
+                    outcome = "CANCELLED";
+                }
+            }
+        }
+        for (int p = 0; p < 2; p++)
+            close(fds[p]);
+
+        int status = 0;
+        int exitStatus = -1;
+        if (waitpid(pid, &status, 0) == pid) {
+            if (WIFEXITED(status))
+                exitStatus = WEXITSTATUS(status);
+            else if (WIFSIGNALED(status))
+                exitStatus = 128 + WTERMSIG(status);
+        }
+        if (directory.length() > 0)
+            removeDirectory(directory);
+
+        ostringstream header;
+        header << outcome << " " << exitStatus << " " << output[0].length() << " " << output[1].length() << "\n";
+        writeAll(out, header.str() + output[0] + output[1]);
+    }
+
+    // The run forked for a request that never came exits when its request pipe closes
+    if (haveRun) {
+        close(run.request);
+        close(run.output[0]);
+        close(run.output[1]);
+        waitpid(run.pid, nullptr, 0);
+    }
+}
+
+#else
+
+// Creates a server that runs requests through simulate
+SimServer::SimServer(Simulator simulate) {
+    mySimulate = simulate;
+}
+
+// Serves requests read from standard input until it closes
+void SimServer::serveStream() {
+    cerr << "Serving requests needs a Unix system." << endl;
+}
+
+// Serves requests on the Unix domain socket path. Returns false if
+// it cannot listen there; otherwise it never returns.
+bool SimServer::serveSocket(string path) {
+    cerr << "Serving requests needs a Unix system." << endl;
+    return false;
+}
+
+// Forks a process that waits for a request on run.request, runs it, and
+// writes its output to run.output. The process closes the connection's
+// in and out. Returns false if it could not.
+bool SimServer::startRun(Run& run, int in, int out) {
+    return false;
+}
+
+// In a process startRun forked, reads the request from fd, runs it and exits
+void SimServer::runRequest(int fd) {
+}
+
+// Serves the requests read from in, answering them on out
+void SimServer::serveConnection(int in, int out) {
+}
+
+#endif
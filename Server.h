@@ -0,0 +1,81 @@
+// Palmer Robins
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "SimOptions.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * SimServer answers simulation requests over a Unix domain socket, or over
+ * standard input and output, so a tool that simulates many short traces
+ * pays for starting PIPESIM once. A request is one line
+ *
+ *     RUN <timeout ms> <input bytes> <arguments>
+ *
+ * where the arguments are what would follow PIPESIM on the command line,
+ * split at spaces. If input bytes is not 0, that many bytes of input follow
+ * the line and the input file named in the arguments only gives their
+ * format. A timeout of 0 lets the request run as long as it needs. Every
+ * request gets one answer
+ *
+ *     <outcome> <exit status> <output bytes> <error bytes>
+ *
+ * followed by everything the run wrote to standard output and then to
+ * standard error. The outcome is DONE, TIMEOUT or CANCELLED. The line
+ * CANCEL stops the request in progress, and QUIT ends the connection.
+ * A line that is not understood is answered with ERROR and a message.
+ * More than 256 MB of input is answered with ERROR and ends the connection.
+ *
+ * Each request runs in a process forked from the server, so nothing a
+ * run allocates, or a run that exits on a bad input, outlives it. The
+ * process is forked while the server waits for the request, and its
+ * output is written back in large pieces rather than a line at a time.
+ * Every connection to the socket is served by its own process, so
+ * connections run their requests at the same time.
+ */
+class SimServer {
+
+    public:
+
+        // Simulates one request's options, writing the tables to standard output
+        typedef void (*Simulator)(SimOptions& opts);
+
+        // Creates a server that runs requests through simulate
+        SimServer(Simulator simulate);
+
+        // Serves requests read from standard input until it closes
+        void serveStream();
+
+        // Serves requests on the Unix domain socket path. Returns false if
+        // it cannot listen there; otherwise it never returns.
+        bool serveSocket(string path);
+
+    private:
+
+        // A process forked to run a request, and the pipes to it
+        struct Run {
+            int pid;
+            int request; // the request is written here
+            int output[2]; // its standard output and error are read here
+        };
+
+        // Forks a process that waits for a request on run.request, runs it, and
+        // writes its output to run.output. The process closes the connection's
+        // in and out. Returns false if it could not.
+        bool startRun(Run& run, int in, int out);
+
+        // In a process startRun forked, reads the request from fd, runs it and exits
+        void runRequest(int fd);
+
+        // Serves the requests read from in, answering them on out
+        void serveConnection(int in, int out);
+
+        Simulator mySimulate;
+};
+
+#endif
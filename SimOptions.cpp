@@ -0,0 +1,304 @@
+// Palmer Robins
+
+#include "SimOptions.h"
+#include "BranchPredictor.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// Returns true if s is a non-negative decimal number
+static bool isCount(string s) {
+    if (s.length() == 0)
+        return false;
+    for (unsigned int i = 0; i < s.length(); i++)
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+    return true;
+}
+
+// Given a string of count numbers separated by colons, like "32:16:1",
+// fills fields with them and returns true if every one is at least 1
+static bool parseFields(string text, int* fields, int count) {
+    int numFields = 0;
+    size_t begin = 0;
+    while (numFields < count) {
+        size_t end = text.find(':', begin);
+        string field = text.substr(begin, (end == string::npos) ? string::npos : end - begin);
+        if (!isCount(field) || field.length() > 6 || atoi(field.c_str()) < 1)
+            return false;
+        fields[numFields++] = atoi(field.c_str());
+        if (end == string::npos)
+            break;
+        begin = end + 1;
+    }
+    return numFields == count && text.find(':', begin) == string::npos;
+}
+
+// Reads the command line into opts. Prints a message and returns false
+// if the arguments are not understood.
+bool parseOptions(int argc, char* argv[], SimOptions& opts) {
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+
+        if (arg == "--threads") {
+            if (a + 1 >= argc || !isCount(argv[a + 1])) {
+                cerr << "--threads needs a number of threads." << endl;
+                return false;
+            }
+            // More threads than cores only adds switching
+            unsigned long asked = strtoul(argv[++a], nullptr, 10);
+            unsigned long cores = thread::hardware_concurrency();
+            if (cores == 0)
+                cores = 1;
+            opts.numThreads = (asked > cores) ? cores : asked;
+        }
+        else if (arg == "--execute")
+            opts.execute = true;
+        else if (arg == "--translate")
+            opts.execute = opts.translate = true;
+        else if (arg == "--max-steps") {
+            if (a + 1 >= argc || !isCount(argv[a + 1])) {
+                cerr << "--max-steps needs a number of instructions." << endl;
+                return false;
+            }
+            opts.maxSteps = atoll(argv[++a]);
+        }
+        else if (arg == "--predictor") {
+            BranchPredictor* check = (a + 1 < argc) ? BranchPredictor::create(argv[a + 1]) : nullptr;
+            if (check == nullptr) {
+                cerr << "--predictor needs one of static, btfn, bimodal, gshare or btb." << endl;
+                return false;
+            }
+            delete check;
+            opts.predictor = argv[++a];
+        }
+        else if (arg == "--flush-penalty") {
+            if (a + 1 >= argc || !isCount(argv[a + 1])) {
+                cerr << "--flush-penalty needs a number of cycles." << endl;
+                return false;
+            }
+            opts.flushPenalty = atoi(argv[++a]);
+        }
+        else if (arg == "--l1" || arg == "--l2") {
+            CacheConfig& config = (arg == "--l1") ? opts.l1 : opts.l2;
+            if (a + 1 >= argc || !parseCacheConfig(argv[a + 1], config)) {
+                cerr << arg << " needs size:ways:line:latency, with power of two sizes." << endl;
+                return false;
+            }
+            a++;
+            if (arg == "--l1")
+                opts.dataCache = true;
+        }
+        else if (arg == "--memory-latency") {
+            if (a + 1 >= argc || !isCount(argv[a + 1])) {
+                cerr << "--memory-latency needs a number of cycles." << endl;
+                return false;
+            }
+            opts.memoryLatency = atoi(argv[++a]);
+        }
+        else if (arg == "--replacement") {
+            string policy = (a + 1 < argc) ? argv[a + 1] : "";
+            if (policy != "lru" && policy != "plru") {
+                cerr << "--replacement needs lru or plru." << endl;
+                return false;
+            }
+            opts.replacement = (policy == "lru") ? LRU : PLRU;
+            a++;
+        }
+        else if (arg == "--write-policy") {
+            string policy = (a + 1 < argc) ? argv[a + 1] : "";
+            if (policy != "back" && policy != "through") {
+                cerr << "--write-policy needs back or through." << endl;
+                return false;
+            }
+            opts.writes = (policy == "back") ? WRITE_BACK : WRITE_THROUGH;
+            a++;
+        }
+        else if (arg == "--mshrs") {
+            if (a + 1 >= argc || !isCount(argv[a + 1]) || atoi(argv[a + 1]) < 1) {
+                cerr << "--mshrs needs a number of miss registers." << endl;
+                return false;
+            }
+            opts.numMSHRs = atoi(argv[++a]);
+        }
+        else if (arg == "--width") {
+            if (a + 1 >= argc || !isCount(argv[a + 1]) || atoi(argv[a + 1]) < 1 || atoi(argv[a + 1]) > 8) {
+                cerr << "--width needs a bundle width from 1 to 8." << endl;
+                return false;
+            }
+            opts.width = atoi(argv[++a]);
+        }
+        else if (arg == "--units") {
+            if (a + 1 >= argc || !parseFields(argv[a + 1], opts.units, 4)) {
+                cerr << "--units needs alus:multipliers:memory:branch, each at least 1." << endl;
+                return false;
+            }
+            a++;
+        }
+        else if (arg == "--ooo") {
+            int fields[3];
+            if (a + 1 >= argc || !parseFields(argv[a + 1], fields, 3) || fields[1] > 128 || fields[2] > 8) {
+                cerr << "--ooo needs rob:stations:width, with at most 128 stations and 8 wide." << endl;
+                return false;
+            }
+            opts.robSize = fields[0];
+            opts.numStations = fields[1];
+            opts.oooWidth = fields[2];
+            a++;
+        }
+        else if (arg == "--skip" || arg == "--warmup") {
+            if (a + 1 >= argc || !isCount(argv[a + 1]) || strlen(argv[a + 1]) > 9) {
+                cerr << arg << " needs a number of instructions." << endl;
+                return false;
+            }
+            if (arg == "--skip")
+                opts.skip = atoi(argv[++a]);
+            else
+                opts.warmup = atoi(argv[++a]);
+        }
+        else if (arg == "--sample") {
+            int fields[3];
+            if (a + 1 >= argc || !parseFields(argv[a + 1], fields, 3)) {
+                cerr << "--sample needs interval:clusters:warmup, each at least 1." << endl;
+                return false;
+            }
+            opts.sampleInterval = fields[0];
+            opts.sampleClusters = fields[1];
+            opts.sampleWarmup = fields[2];
+            a++;
+        }
+        else if (arg == "--parse-cache")
+            opts.parseCache = true;
+        else if (arg == "--no-cache")
+            opts.parseCache = false;
+        else if (arg == "--check-only")
+            opts.checkOnly = true;
+        else if (arg == "--verify")
+            opts.verify = true;
+        else if (arg == "--verify-baseline") {
+            if (a + 1 >= argc) {
+                cerr << "--verify-baseline needs the name of the file to keep rates in." << endl;
+                return false;
+            }
+            opts.verify = true;
+            opts.verifyBaseline = argv[++a];
+        }
+        else if (arg == "--max-slowdown") {
+            if (a + 1 >= argc || !isCount(argv[a + 1]) || strlen(argv[a + 1]) > 3) {
+                cerr << "--max-slowdown needs a whole percentage." << endl;
+                return false;
+            }
+            opts.maxSlowdown = atoi(argv[++a]);
+        }
+        else if (arg == "--no-extrapolate")
+            opts.extrapolate = false;
+        else if (arg == "--block-cache")
+            opts.blockCache = true;
+        else if (arg == "--block-cache-file") {
+            if (a + 1 >= argc) {
+                cerr << "--block-cache-file needs the name of the file to keep block timings in." << endl;
+                return false;
+            }
+            opts.blockCache = true;
+            opts.blockCacheFile = argv[++a];
+        }
+        else if (arg == "--format") {
+            string format = (a + 1 < argc) ? argv[a + 1] : "";
+            if (format != "asm" && format != "mach" && format != "trc") {
+                cerr << "--format needs asm, mach or trc." << endl;
+                return false;
+            }
+            opts.format = format;
+            a++;
+        }
+        else if (arg == "--serve") {
+            if (a + 1 >= argc) {
+                cerr << "--serve needs a socket to listen on, or - for standard input and output." << endl;
+                return false;
+            }
+            opts.serve = argv[++a];
+        }
+        else if (arg == "--timeline") {
+            if (a + 1 >= argc) {
+                cerr << "--timeline needs the name of the log to write." << endl;
+                return false;
+            }
+            opts.timelineFile = argv[++a];
+        }
+        else if (arg == "--timeline-index") {
+            if (a + 1 >= argc) {
+                cerr << "--timeline-index needs the name of the index to write." << endl;
+                return false;
+            }
+            opts.timelineIndexFile = argv[++a];
+        }
+        else if (arg == "--timeline-model") {
+            string model = (a + 1 < argc) ? argv[a + 1] : "";
+            if (model != "ideal" && model != "stall" && model != "forward" && model != "superscalar") {
+                cerr << "--timeline-model needs ideal, stall, forward or superscalar." << endl;
+                return false;
+            }
+            opts.timelineModel = model;
+            a++;
+        }
+        else if (arg == "--pack") {
+            if (a + 1 >= argc) {
+                cerr << "--pack needs the name of the trace file to write." << endl;
+                return false;
+            }
+            opts.packFile = argv[++a];
+        }
+        else if (arg.length() > 2 && arg.substr(0, 2) == "--") {
+            cerr << "Unknown option " << arg << endl;
+            return false;
+        }
+        else if (opts.filename.length() == 0)
+            opts.filename = arg;
+        else {
+            cerr << "Only one input file can be simulated at a time." << endl;
+            return false;
+        }
+    }
+
+    if (opts.l2.size > 0 && !opts.dataCache) {
+        cerr << "--l2 needs an --l1 in front of it." << endl;
+        return false;
+    }
+
+    if (opts.units[0] > 0 && opts.width == 0) {
+        cerr << "--units needs a --width for the superscalar model." << endl;
+        return false;
+    }
+
+    if (opts.timelineFile.length() > 0 && opts.timelineIndexFile.length() > 0) {
+        cerr << "Only one of --timeline and --timeline-index can be given." << endl;
+        return false;
+    }
+    if (opts.timelineFile.length() > 0 || opts.timelineIndexFile.length() > 0) {
+        if (opts.timelineModel == "superscalar" && opts.width == 0) {
+            cerr << "--timeline-model superscalar needs a --width." << endl;
+            return false;
+        }
+        if (opts.sampleInterval > 0 || opts.verify) {
+            cerr << "A timeline follows every instruction of one run, so it cannot be used with --sample or --verify." << endl;
+            return false;
+        }
+    }
+
+    // A server is sent its inputs with each request
+    if (opts.serve.length() > 0) {
+        if (opts.filename.length() > 0) {
+            cerr << "--serve takes its input files from the requests." << endl;
+            return false;
+        }
+        return true;
+    }
+
+    if (opts.filename.length() == 0) {
+        cerr << "You need to specify a binary or assembly file to translate." << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+// Palmer Robins
+
+#ifndef __SIMOPTIONS_H__
+#define __SIMOPTIONS_H__
+
+#include "DataCache.h"
+
+#include <string>
+
+using namespace std;
+
+/**
+ * SimOptions holds the settings for one simulation run, as read
+ * from the command line.
+ */
+struct SimOptions {
+    string filename; // the binary or assembly file to simulate, "-" for standard input
+    string format; // "asm", "mach" or "trc" to override the file's extension, empty to go by it
+    int numThreads; // worker threads for the parallel engine, at most one per core, 0 to use the serial engines
+    bool execute; // run the program and simulate the committed instructions
+    bool translate; // execute from the translation cache instead of interpreting
+    long long maxSteps; // most instructions the program may commit when executed
+    string predictor; // branch predictor for BEQ and J, empty for the flat jump penalty
+    int flushPenalty; // cycles lost to a mispredicted BEQ
+    bool dataCache; // send loads through a data cache
+    CacheConfig l1; // the L1 data cache
+    CacheConfig l2; // the L2 cache, size 0 for none
+    int memoryLatency; // extra cycles for a load that misses every cache level
+    ReplacementPolicy replacement;
+    WritePolicy writes;
+    int numMSHRs; // cache misses that can be in flight at once
+    int width; // bundle width of the superscalar model, 0 to leave it out
+    int units[4]; // ALUs, multipliers, memory ports and branch units per cycle, 0 for the default
+    int robSize; // reorder buffer entries of the out of order model, 0 to leave it out
+    int numStations; // reservation stations of the out of order model
+    int oooWidth; // instructions the out of order model handles per cycle
+    unsigned int skip; // instructions fast forwarded before timing starts
+    unsigned int warmup; // instructions timed but left out of the tables
+    int sampleInterval; // instructions per sampling interval, 0 to simulate everything
+    int sampleClusters; // most intervals simulated to stand for the rest
+    int sampleWarmup; // instructions simulated before each interval to warm up
+    string packFile; // packed trace to write instead of simulating, empty for none
+    bool parseCache; // read and write the sidecar cache of parsed inputs, off unless asked for
+    bool checkOnly; // only check the input's syntax, reporting every error
+    bool verify; // run every timing engine and check they agree
+    string verifyBaseline; // rates the engines are held to, written by the first run, empty for none
+    double maxSlowdown; // percent an engine may fall below its stored rate
+    bool extrapolate; // let models jump over loop iterations in a steady state
+    bool blockCache; // reuse the stall and forwarding timing of basic blocks seen before; experimental
+    string blockCacheFile; // where the block timings are kept between runs, empty for nowhere
+    string timelineFile; // Konata log of every instruction's stage cycles, empty for none
+    string timelineIndexFile; // indexed record of every instruction's stage cycles for PIPESIM query, empty for none
+    string timelineModel; // "ideal", "stall", "forward" or "superscalar", the model the timeline follows
+    string serve; // Unix socket to serve requests on, "-" for standard input and output, empty to simulate filename
+
+    // Creates the default options: serial engines, trace driven, no input file
+    SimOptions() {
+        numThreads = 0;
+        execute = false;
+        translate = false;
+        maxSteps = 1000000;
+        flushPenalty = 2;
+        dataCache = false;
+        memoryLatency = 20;
+        replacement = LRU;
+        writes = WRITE_BACK;
+        numMSHRs = 4;
+        width = 0;
+        for (int u = 0; u < 4; u++)
+            units[u] = 0;
+        robSize = numStations = oooWidth = 0;
+        skip = warmup = 0;
+        sampleInterval = 0;
+        sampleClusters = 10;
+        sampleWarmup = 1000;
+        parseCache = false;
+        checkOnly = false;
+        verify = false;
+        maxSlowdown = 10;
+        extrapolate = true;
+        blockCache = false;
+        timelineModel = "forward";
+    }
+};
+
+// Reads the command line into opts. Prints a message and returns false
+// if the arguments are not understood.
+bool parseOptions(int argc, char* argv[], SimOptions& opts);
+
+#endif
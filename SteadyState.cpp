@@ -0,0 +1,65 @@
+// Palmer Robins
+
+#include "SteadyState.h"
+
+// Watches a trace: the instruction number each instruction was
+// fetched from, whether it redirected fetch, and the cycles lost
+// after it to control hazards
+SteadyStateDetector::SteadyStateDetector(vector<int>& addresses, vector<bool>& taken, vector<int>& controlCycles)
+    : myAddresses(addresses), myTaken(taken), myControlCycles(controlCycles) {
+}
+
+// Records the model's state when instruction next is the next one
+// to enter it, at cycle cycle. firstUsed is the oldest instruction
+// the state refers to. If the state was seen before and the trace
+// has repeated since, returns how many instructions, a whole number
+// of periods, the model can jump over, and sets period to the
+// instructions and periodCycles to the cycles in one period.
+// Otherwise returns 0.
+int SteadyStateDetector::check(int next, int firstUsed, long long cycle, vector<long long>& state, int& period, long long& periodCycles) {
+    uint64_t hash = hashState(state);
+    unordered_map<uint64_t, Snapshot>::iterator it = mySnapshots.find(hash);
+
+    if (it == mySnapshots.end()) {
+        if (mySnapshots.size() >= MAX_SNAPSHOTS)
+            mySnapshots.clear();
+        Snapshot& snapshot = mySnapshots[hash];
+        snapshot.next = next;
+        snapshot.cycle = cycle;
+        snapshot.state = state;
+        return 0;
+    }
+
+    Snapshot& snapshot = it->second;
+    int skip = 0;
+    period = next - snapshot.next;
+    periodCycles = cycle - snapshot.cycle;
+
+    if (period > 0 && snapshot.state == state && firstUsed >= period) {
+        // The instructions the state refers to must match the last period's,
+        // and then the trace decides how many more periods follow
+        int numInstructions = myAddresses.size();
+        int k = firstUsed;
+        while (k < numInstructions && sameInstruction(k, k - period))
+            k++;
+        if (k >= next)
+            skip = (k - next) / period * period;
+    }
+
+    snapshot.next = next;
+    snapshot.cycle = cycle;
+    if (snapshot.state != state)
+        snapshot.state = state;
+    return skip;
+}
+
+// Returns a hash of a state
+uint64_t SteadyStateDetector::hashState(vector<long long>& state) {
+    uint64_t hash = 0xCBF29CE484222325ULL ^ state.size();
+    for (unsigned int s = 0; s < state.size(); s++) {
+        hash ^= (uint64_t)state[s];
+        hash *= 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
@@ -0,0 +1,74 @@
+// Palmer Robins
+
+#ifndef __STEADYSTATE_H__
+#define __STEADYSTATE_H__
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * SteadyStateDetector spots when a model reaches a periodic steady state
+ * in a loop, so the iterations left can be extrapolated instead of timed.
+ *
+ * At each loop back edge the model hands over its state with every cycle
+ * made relative to the current cycle and every instruction number relative
+ * to the next instruction. If the same state was seen at an earlier back
+ * edge, and the trace since then repeats, the model is known to repeat too:
+ * every instruction of the next period finishes exactly the same number of
+ * cycles after its counterpart in the last one.
+ */
+class SteadyStateDetector {
+
+    public:
+
+        // Most states remembered before starting over, so traces
+        // without loops cannot use up memory
+        static const unsigned int MAX_SNAPSHOTS = 1 << 14;
+
+        // Watches a trace: the instruction number each instruction was
+        // fetched from, whether it redirected fetch, and the cycles lost
+        // after it to control hazards
+        SteadyStateDetector(vector<int>& addresses, vector<bool>& taken, vector<int>& controlCycles);
+
+        // Returns true if instruction k starts a loop iteration, because
+        // the instruction before it went backwards
+        bool startsIteration(int k) {
+            return k > 0 && k < (int)myAddresses.size() && myTaken[k - 1] && myAddresses[k] <= myAddresses[k - 1];
+        }
+
+        // Records the model's state when instruction next is the next one
+        // to enter it, at cycle cycle. firstUsed is the oldest instruction
+        // the state refers to. If the state was seen before and the trace
+        // has repeated since, returns how many instructions, a whole number
+        // of periods, the model can jump over, and sets period to the
+        // instructions and periodCycles to the cycles in one period.
+        // Otherwise returns 0.
+        int check(int next, int firstUsed, long long cycle, vector<long long>& state, int& period, long long& periodCycles);
+
+    private:
+
+        // Returns true if instructions a and b of the trace look the same to a model
+        bool sameInstruction(int a, int b) {
+            return myAddresses[a] == myAddresses[b] && myTaken[a] == myTaken[b] && myControlCycles[a] == myControlCycles[b];
+        }
+
+        // Returns a hash of a state
+        static uint64_t hashState(vector<long long>& state);
+
+        // A state seen at a back edge
+        struct Snapshot {
+            int next;
+            long long cycle;
+            vector<long long> state;
+        };
+
+        vector<int>& myAddresses;
+        vector<bool>& myTaken;
+        vector<int>& myControlCycles;
+        unordered_map<uint64_t, Snapshot> mySnapshots;
+};
+
+#endif
@@ -0,0 +1,91 @@
+// Palmer Robins
+
+#include "SymbolTable.h"
+
+// Slots in a new table
+static const unsigned int INITIAL_SLOTS = 64;
+
+// Creates an empty table
+SymbolTable::SymbolTable() {
+    Symbol empty;
+    empty.value = -1;
+    empty.hash = 0;
+    mySlots.assign(INITIAL_SLOTS, empty);
+    myCount = 0;
+}
+
+// Gives label name the value value, which must not be negative.
+// Returns false if name is already defined.
+bool SymbolTable::define(const string& name, int value) {
+    uint32_t hash = hashName(name);
+    unsigned int slot = findSlot(name, hash);
+    if (mySlots[slot].value != -1)
+        return false;
+
+    mySlots[slot].name = name;
+    mySlots[slot].value = value;
+    mySlots[slot].hash = hash;
+    myCount++;
+
+    // Keep probe sequences short
+    if (2 * myCount > (int)mySlots.size())
+        grow();
+    return true;
+}
+
+// Sets value to the value of label name. Returns false if name
+// is not defined.
+bool SymbolTable::lookup(const string& name, int& value) {
+    unsigned int slot = findSlot(name, hashName(name));
+    if (mySlots[slot].value == -1)
+        return false;
+    value = mySlots[slot].value;
+    return true;
+}
+
+// Returns the slot holding name, or the empty slot where it belongs
+unsigned int SymbolTable::findSlot(const string& name, uint32_t hash) {
+    unsigned int mask = mySlots.size() - 1;
+    unsigned int slot = hash & mask;
+
+    // The table is never more than half full, so an empty slot turns up
+    while (mySlots[slot].value != -1) {
+        if (mySlots[slot].hash == hash && mySlots[slot].name == name)
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Moves every symbol into a table twice the size
+void SymbolTable::grow() {
+    vector<Symbol> old;
+    old.swap(mySlots);
+
+    Symbol empty;
+    empty.value = -1;
+    empty.hash = 0;
+    mySlots.assign(2 * old.size(), empty);
+
+    unsigned int mask = mySlots.size() - 1;
+    for (unsigned int s = 0; s < old.size(); s++) {
+        if (old[s].value == -1)
+            continue;
+        unsigned int slot = old[s].hash & mask;
+        while (mySlots[slot].value != -1)
+            slot = (slot + 1) & mask;
+        mySlots[slot].name.swap(old[s].name);
+        mySlots[slot].value = old[s].value;
+        mySlots[slot].hash = old[s].hash;
+    }
+}
+
+// Returns the FNV-1a hash of name
+uint32_t SymbolTable::hashName(const string& name) {
+    uint32_t hash = 2166136261u;
+    for (unsigned int c = 0; c < name.length(); c++) {
+        hash ^= (uint8_t)name[c];
+        hash *= 16777619u;
+    }
+    return hash;
+}
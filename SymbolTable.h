@@ -0,0 +1,57 @@
+// Palmer Robins
+
+#ifndef __SYMBOLTABLE_H__
+#define __SYMBOLTABLE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** This class maps label names to the instruction numbers they mark. It is
+ * an open addressing hash table with linear probing that doubles in size
+ * whenever it becomes half full, so a lookup is one hash and, almost
+ * always, a single string compare.
+ */
+class SymbolTable {
+
+    public:
+
+        // Creates an empty table
+        SymbolTable();
+
+        // Gives label name the value value, which must not be negative.
+        // Returns false if name is already defined.
+        bool define(const string& name, int value);
+
+        // Sets value to the value of label name. Returns false if name
+        // is not defined.
+        bool lookup(const string& name, int& value);
+
+        // Returns the number of labels defined
+        int size() { return myCount; }
+
+    private:
+
+        // A slot of the table; value is -1 while the slot is empty
+        struct Symbol {
+            string name;
+            int value;
+            uint32_t hash;
+        };
+
+        // Returns the slot holding name, or the empty slot where it belongs
+        unsigned int findSlot(const string& name, uint32_t hash);
+
+        // Moves every symbol into a table twice the size
+        void grow();
+
+        // Returns the FNV-1a hash of name
+        static uint32_t hashName(const string& name);
+
+        vector<Symbol> mySlots; // always a power of two long
+        int myCount;
+};
+
+#endif
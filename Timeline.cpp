@@ -0,0 +1,200 @@
+// Palmer Robins
+
+#include "Timeline.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+// Stage names as the viewer shows them
+static const char* const STAGE_NAMES[5] = { "IF", "ID", "EX", "MEM", "WB" };
+
+// Creates the log filename
+TimelineWriter::TimelineWriter(string filename) {
+    myClosed = false;
+    myBuffer.resize(BUFFER_SIZE);
+    myLength = 0;
+    myFlights.resize(16);
+    myFirst = 0;
+    myNumFlights = 0;
+    myNextId = 0;
+    myRetired = 0;
+    myCycle = -1;
+
+    myOut.open(filename.c_str(), ios::binary | ios::trunc);
+    myGood = myOut.good();
+    const char* header = "Kanata\t0004\n";
+    append(header, strlen(header));
+}
+
+// Finishes the log, if close was not called
+TimelineWriter::~TimelineWriter() {
+    close();
+}
+
+// Adds the next instruction to leave the pipeline. number is its
+// instruction number in the trace and completion the cycle it leaves
+// WB, which is never before the one added ahead of it.
+void TimelineRecorder::addInstruction(long long number, const string& assembly, long long completion) {
+    long long execute = completion - 2;
+    long long fetch = completion - 4;
+    if (myLastExecute >= 0)
+        fetch = min(fetch, myLastExecute - 1);
+    myLastExecute = execute;
+    addStages(number, assembly, fetch, completion);
+}
+
+// Holds an instruction until its row can be written
+void TimelineWriter::addStages(long long number, const string& assembly, long long fetch, long long completion) {
+    long long execute = completion - 2;
+
+    // Make room for one more, keeping the ring in order
+    if (myNumFlights == myFlights.size()) {
+        vector<Flight> flights(2 * myFlights.size());
+        for (size_t f = 0; f < myNumFlights; f++)
+            swap(flights[f], myFlights[(myFirst + f) % myFlights.size()]);
+        myFlights.swap(flights);
+        myFirst = 0;
+    }
+
+    Flight& f = myFlights[(myFirst + myNumFlights++) % myFlights.size()];
+    f.id = myNextId++;
+    f.number = number;
+    f.assembly.assign(assembly);
+    f.cycles[0] = fetch;
+    f.cycles[1] = fetch + 1;
+    f.cycles[2] = execute;
+    f.cycles[3] = execute + 1;
+    f.cycles[4] = completion;
+    f.cycles[5] = completion + 1;
+    f.cycles[6] = LLONG_MAX;
+    f.next = 0;
+
+    // The next instruction is fetched four cycles before it leaves at the
+    // earliest, and it leaves no earlier than this one
+    writeEventsBefore(completion - 4);
+}
+
+// Writes the instructions still in flight. Returns true if the whole
+// log was written.
+bool TimelineWriter::close() {
+    if (myClosed)
+        return myGood;
+    myClosed = true;
+
+    writeEventsBefore(LLONG_MAX);
+    flush();
+    myOut.close();
+    myGood = myGood && !myOut.fail();
+    return myGood;
+}
+
+// Writes every event before cycle, a cycle at a time
+void TimelineWriter::writeEventsBefore(long long cycle) {
+    while (myNumFlights > 0) {
+        long long now = LLONG_MAX;
+        for (size_t f = 0; f < myNumFlights; f++) {
+            Flight& flight = myFlights[(myFirst + f) % myFlights.size()];
+            now = min(now, flight.cycles[flight.next]);
+        }
+        if (now >= cycle)
+            return;
+
+        // Rows are written oldest first within a cycle
+        for (size_t f = 0; f < myNumFlights; f++) {
+            Flight& flight = myFlights[(myFirst + f) % myFlights.size()];
+            if (flight.cycles[flight.next] == now)
+                writeEvent(flight);
+        }
+
+        // Instructions retire in order
+        while (myNumFlights > 0 && myFlights[myFirst].next == 6) {
+            myFirst = (myFirst + 1) % myFlights.size();
+            myNumFlights--;
+        }
+    }
+}
+
+// Writes the next event of f, moving the log's clock up to it first
+void TimelineWriter::writeEvent(Flight& f) {
+    long long cycle = f.cycles[f.next];
+    if (myCycle < 0) {
+        append("C=\t", 3);
+        appendNumber(cycle);
+        append("\n", 1);
+        myCycle = cycle;
+    }
+    else if (cycle > myCycle) {
+        append("C\t", 2);
+        appendNumber(cycle - myCycle);
+        append("\n", 1);
+        myCycle = cycle;
+    }
+
+    if (f.next == 0) {
+        // Start the row, labelled with the instruction number and assembly
+        append("I\t", 2);
+        appendNumber(f.id);
+        append("\t", 1);
+        appendNumber(f.number);
+        append("\t0\nL\t", 5);
+        appendNumber(f.id);
+        append("\t0\t", 3);
+        appendNumber(f.number);
+        append(" ", 1);
+        append(f.assembly.data(), f.assembly.size());
+        append("\n", 1);
+    }
+
+    if (f.next < 5) {
+        const char* name = STAGE_NAMES[f.next];
+        append("S\t", 2);
+        appendNumber(f.id);
+        append("\t0\t", 3);
+        append(name, strlen(name));
+        append("\n", 1);
+    }
+    else {
+        append("R\t", 2);
+        appendNumber(f.id);
+        append("\t", 1);
+        appendNumber(myRetired++);
+        append("\t0\n", 3);
+    }
+    f.next++;
+}
+
+// Appends text to the buffer
+void TimelineWriter::append(const char* text, size_t length) {
+    if (myLength + length > myBuffer.size()) {
+        flush();
+        if (length > myBuffer.size())
+            myBuffer.resize(length);
+    }
+    memcpy(myBuffer.data() + myLength, text, length);
+    myLength += length;
+}
+
+// Appends a number to the buffer
+void TimelineWriter::appendNumber(long long value) {
+    char digits[24];
+    int end = sizeof(digits);
+    bool negative = value < 0;
+    unsigned long long magnitude = negative ? -(unsigned long long)value : value;
+    do {
+        digits[--end] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (negative)
+        digits[--end] = '-';
+    append(digits + end, sizeof(digits) - end);
+}
+
+// Writes the buffer to the file
+void TimelineWriter::flush() {
+    if (myLength > 0 && myGood) {
+        myOut.write(myBuffer.data(), myLength);
+        myGood = myOut.good();
+    }
+    myLength = 0;
+}
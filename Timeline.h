@@ -0,0 +1,124 @@
+// Palmer Robins
+
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * TimelineRecorder works out the cycle each instruction enters IF, ID,
+ * EX, MEM and WB, for the subclasses to record. Instructions are added in
+ * the order they leave the pipeline, with the cycle they leave it. EX,
+ * MEM and WB are the three cycles ending there. An instruction is fetched
+ * as soon as the one ahead of it leaves ID, or four cycles before it
+ * leaves if that is earlier, as when it shares a superscalar bundle, and
+ * waits in ID until it can go on, so stalls show as long stays in ID.
+ */
+class TimelineRecorder {
+
+    public:
+
+        TimelineRecorder() { myLastExecute = -1; }
+
+        virtual ~TimelineRecorder() {}
+
+        // Returns true if the file could be created and written so far
+        virtual bool isGood() = 0;
+
+        // Adds the next instruction to leave the pipeline. number is its
+        // instruction number in the trace and completion the cycle it leaves
+        // WB, which is never before the one added ahead of it.
+        void addInstruction(long long number, const string& assembly, long long completion);
+
+        // Writes whatever is still held. Returns true if the whole file
+        // was written.
+        virtual bool close() = 0;
+
+    protected:
+
+        // Records an instruction fetched in cycle fetch that leaves WB in
+        // cycle completion. It enters ID the cycle after it is fetched, and
+        // EX and MEM two cycles and one cycle before it leaves.
+        virtual void addStages(long long number, const string& assembly, long long fetch, long long completion) = 0;
+
+    private:
+
+        long long myLastExecute; // cycle the previous instruction entered EX, or -1
+};
+
+/**
+ * TimelineWriter writes the stage cycles to a Konata log, which pipeline
+ * viewers draw as a chart with one row per instruction, where stalls show
+ * as long ID bars. Only the few instructions still in flight are held;
+ * everything else is streamed to the file through a buffer as the
+ * simulation goes.
+ */
+class TimelineWriter : public TimelineRecorder {
+
+    public:
+
+        static const size_t BUFFER_SIZE = 1 << 20;
+
+        // Creates the log filename
+        TimelineWriter(string filename);
+
+        // Finishes the log, if close was not called
+        ~TimelineWriter();
+
+        // Returns true if the file could be created and written so far
+        bool isGood() { return myGood; }
+
+        // Writes the instructions still in flight. Returns true if the whole
+        // log was written.
+        bool close();
+
+    protected:
+
+        // Holds an instruction until its row can be written
+        void addStages(long long number, const string& assembly, long long fetch, long long completion);
+
+    private:
+
+        // An instruction whose row is not finished in the log
+        struct Flight {
+            long long id; // the instruction's row in the log
+            long long number;
+            string assembly;
+            long long cycles[7]; // when it enters IF to WB, retires, then LLONG_MAX
+            int next; // the next of those to write
+        };
+
+        // Writes every event before cycle, a cycle at a time
+        void writeEventsBefore(long long cycle);
+
+        // Writes the next event of f, moving the log's clock up to it first
+        void writeEvent(Flight& f);
+
+        // Appends text or a number to the buffer
+        void append(const char* text, size_t length);
+        void appendNumber(long long value);
+
+        // Writes the buffer to the file
+        void flush();
+
+        ofstream myOut;
+        bool myGood;
+        bool myClosed;
+        vector<char> myBuffer;
+        size_t myLength; // bytes used in myBuffer
+
+        // Instructions leave in order, so the ones in flight wait in a ring
+        // that grows when it fills
+        vector<Flight> myFlights;
+        size_t myFirst; // index of the oldest one in flight
+        size_t myNumFlights;
+        long long myNextId;
+        long long myRetired;
+        long long myCycle; // cycle the log is at, or -1 before the first event
+};
+
+#endif
@@ -0,0 +1,363 @@
+// Palmer Robins
+
+#include "TimelineIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char INDEX_MAGIC[8] = "PIPETL";
+
+// The fixed part at the front of an index
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+};
+
+// The fixed part at the end of an index, saying where everything is
+struct IndexTrailer {
+    uint64_t stringsOffset;
+    uint64_t offsetsOffset;
+    uint64_t numStrings;
+    uint64_t entriesOffset;
+    uint64_t numBlocks;
+    uint64_t numInstructions;
+    char magic[8];
+};
+
+// Appends value to out, seven bits a byte with the high bit set on
+// every byte but the last
+static void appendNumber(vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// Reads a number appendNumber wrote at p, moving p past it. Returns
+// false if it runs past end.
+static bool readNumber(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Creates the index filename
+TimelineIndexWriter::TimelineIndexWriter(string filename) {
+    myClosed = false;
+    myOffset = 0;
+    memset(&myEntry, 0, sizeof(myEntry));
+    myLastNumber = 0;
+    myLastCompletion = 0;
+
+    myOut.open(filename.c_str(), ios::binary | ios::trunc);
+    myGood = myOut.good();
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.blockSize = BLOCK_SIZE;
+    write(&header, sizeof(header));
+}
+
+// Finishes the index, if close was not called
+TimelineIndexWriter::~TimelineIndexWriter() {
+    close();
+}
+
+// Appends an instruction to the block being filled
+void TimelineIndexWriter::addStages(long long number, const string& assembly, long long fetch, long long completion) {
+    if (myEntry.count == 0) {
+        myEntry.firstNumber = myLastNumber = number;
+        myEntry.firstFetch = fetch;
+        myEntry.firstCompletion = myLastCompletion = completion;
+    }
+
+    unordered_map<string, uint32_t>::iterator known = myAssemblyIds.find(assembly);
+    uint32_t id;
+    if (known != myAssemblyIds.end())
+        id = known->second;
+    else {
+        id = myAssembly.size();
+        myAssemblyIds[assembly] = id;
+        myAssembly.push_back(assembly);
+    }
+
+    // An instruction leaves four cycles after it is fetched at the soonest
+    appendNumber(myBlock, number - myLastNumber);
+    appendNumber(myBlock, completion - myLastCompletion);
+    appendNumber(myBlock, completion - fetch - 4);
+    appendNumber(myBlock, id);
+    myLastNumber = number;
+    myLastCompletion = completion;
+
+    myEntry.lastNumber = number;
+    myEntry.lastCompletion = completion;
+    if (++myEntry.count == BLOCK_SIZE)
+        writeBlock();
+}
+
+// Writes the block being filled
+void TimelineIndexWriter::writeBlock() {
+    if (myEntry.count == 0)
+        return;
+    myEntry.offset = myOffset;
+    write(myBlock.data(), myBlock.size());
+    myEntries.push_back(myEntry);
+    myBlock.clear();
+    memset(&myEntry, 0, sizeof(myEntry));
+}
+
+// Writes the last block, the assembly strings and the block index.
+// Returns true if the whole file was written.
+bool TimelineIndexWriter::close() {
+    if (myClosed)
+        return myGood;
+    myClosed = true;
+    writeBlock();
+
+    IndexTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.stringsOffset = myOffset;
+    vector<uint64_t> offsets;
+    for (unsigned int s = 0; s < myAssembly.size(); s++) {
+        offsets.push_back(myOffset - trailer.stringsOffset);
+        write(myAssembly[s].data(), myAssembly[s].size());
+    }
+    offsets.push_back(myOffset - trailer.stringsOffset);
+
+    // The tables after the strings are used where they lie in the mapped
+    // file, so they start on a multiple of eight bytes
+    static const char padding[8] = { 0 };
+    write(padding, (8 - myOffset % 8) % 8);
+    trailer.offsetsOffset = myOffset;
+    trailer.numStrings = myAssembly.size();
+    write(offsets.data(), offsets.size() * sizeof(uint64_t));
+
+    trailer.entriesOffset = myOffset;
+    trailer.numBlocks = myEntries.size();
+    for (unsigned int b = 0; b < myEntries.size(); b++)
+        trailer.numInstructions += myEntries[b].count;
+    write(myEntries.data(), myEntries.size() * sizeof(BlockEntry));
+    memcpy(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic));
+    write(&trailer, sizeof(trailer));
+
+    myOut.close();
+    myGood = myGood && !myOut.fail();
+    return myGood;
+}
+
+// Writes bytes to the file, keeping track of where it is
+void TimelineIndexWriter::write(const void* data, size_t length) {
+    if (myGood && length > 0) {
+        myOut.write((const char*)data, length);
+        myGood = myOut.good();
+    }
+    myOffset += length;
+}
+
+// Maps the index filename. isGood is false if it is not one.
+TimelineIndex::TimelineIndex(string filename) : myFile(filename) {
+    myGood = false;
+    myNumInstructions = 0;
+    myEntries = nullptr;
+    myNumBlocks = 0;
+    myStrings = nullptr;
+    myStringOffsets = nullptr;
+    myNumStrings = 0;
+    myDecoded = 0;
+
+    const uint8_t* data = myFile.getData();
+    uint64_t size = myFile.getSize();
+    if (!data || size < sizeof(IndexHeader) + sizeof(IndexTrailer))
+        return;
+
+    IndexHeader header;
+    IndexTrailer trailer;
+    memcpy(&header, data, sizeof(header));
+    memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+    if (memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != TimelineIndexWriter::VERSION)
+        return;
+    if (memcmp(trailer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+        return;
+
+    // Every part has to lie where the trailer says, in order, so a cut
+    // off index is never used
+    uint64_t tables = size - sizeof(trailer);
+    if (trailer.entriesOffset > tables || trailer.entriesOffset % 8 != 0
+        || trailer.numBlocks != (tables - trailer.entriesOffset) / sizeof(BlockEntry)
+        || (tables - trailer.entriesOffset) % sizeof(BlockEntry) != 0)
+        return;
+    if (trailer.offsetsOffset > trailer.entriesOffset || trailer.offsetsOffset % 8 != 0
+        || trailer.numStrings + 1 != (trailer.entriesOffset - trailer.offsetsOffset) / sizeof(uint64_t))
+        return;
+    if (trailer.stringsOffset < sizeof(IndexHeader) || trailer.stringsOffset > trailer.offsetsOffset)
+        return;
+
+    myStrings = (const char*)data + trailer.stringsOffset;
+    myStringOffsets = (const uint64_t*)(data + trailer.offsetsOffset);
+    myNumStrings = trailer.numStrings;
+    myEntries = (const BlockEntry*)(data + trailer.entriesOffset);
+    myNumBlocks = trailer.numBlocks;
+    myNumInstructions = trailer.numInstructions;
+    if (myStringOffsets[myNumStrings] > trailer.offsetsOffset - trailer.stringsOffset)
+        return;
+    myDecoded = myNumBlocks;
+    myGood = true;
+}
+
+// Returns the first and last instruction numbers recorded
+long long TimelineIndex::getFirstNumber() {
+    return (myNumBlocks > 0) ? myEntries[0].firstNumber : -1;
+}
+
+long long TimelineIndex::getLastNumber() {
+    return (myNumBlocks > 0) ? myEntries[myNumBlocks - 1].lastNumber : -1;
+}
+
+// Returns the cycle the first instruction is fetched and the cycle
+// the last one leaves
+long long TimelineIndex::getFirstCycle() {
+    return (myNumBlocks > 0) ? myEntries[0].firstFetch : -1;
+}
+
+long long TimelineIndex::getLastCycle() {
+    return (myNumBlocks > 0) ? myEntries[myNumBlocks - 1].lastCompletion : -1;
+}
+
+// Fills occupants with the instructions in the pipeline during
+// cycle, oldest first, and the stage each is in
+void TimelineIndex::occupancy(long long cycle, vector<Occupant>& occupants) {
+    occupants.clear();
+
+    // Instructions leave in order and are fetched in order, so the ones in
+    // flight run from the first not to have left to the last fetched
+    size_t b = 0;
+    for (size_t count = myNumBlocks; count > 0; ) {
+        size_t half = count / 2;
+        if (myEntries[b + half].lastCompletion < cycle) {
+            b += half + 1;
+            count -= half + 1;
+        }
+        else
+            count = half;
+    }
+
+    for (; b < myNumBlocks && myEntries[b].firstFetch <= cycle; b++) {
+        if (!decodeBlock(b))
+            return;
+        for (unsigned int r = 0; r < myRecords.size(); r++) {
+            Record& record = myRecords[r];
+            if (record.completion < cycle)
+                continue;
+            if (record.fetch > cycle)
+                return;
+
+            Occupant o;
+            o.number = record.number;
+            o.assembly = getAssembly(record.assembly);
+            if (cycle <= record.fetch)
+                o.stage = IF_STAGE;
+            else if (cycle < record.completion - 2)
+                o.stage = ID_STAGE;
+            else if (cycle == record.completion - 2)
+                o.stage = EX_STAGE;
+            else if (cycle == record.completion - 1)
+                o.stage = MEM_STAGE;
+            else
+                o.stage = WB_STAGE;
+            occupants.push_back(o);
+        }
+    }
+}
+
+// Finds instruction number. Fills in the cycles it is fetched and
+// leaves and returns true, or returns false if it was not recorded.
+bool TimelineIndex::find(long long number, long long& fetch, long long& completion) {
+    size_t b = 0;
+    for (size_t count = myNumBlocks; count > 0; ) {
+        size_t half = count / 2;
+        if (myEntries[b + half].lastNumber < number) {
+            b += half + 1;
+            count -= half + 1;
+        }
+        else
+            count = half;
+    }
+    if (b == myNumBlocks || myEntries[b].firstNumber > number || !decodeBlock(b))
+        return false;
+
+    for (unsigned int r = 0; r < myRecords.size(); r++)
+        if (myRecords[r].number == number) {
+            fetch = myRecords[r].fetch;
+            completion = myRecords[r].completion;
+            return true;
+        }
+    return false;
+}
+
+// Returns the cycles between instructions first and last leaving the
+// pipeline, in either order, or -1 if either was not recorded
+long long TimelineIndex::cyclesBetween(long long first, long long last) {
+    if (first > last)
+        swap(first, last);
+    long long fetch, firstCompletion, lastCompletion;
+    if (!find(first, fetch, firstCompletion) || !find(last, fetch, lastCompletion))
+        return -1;
+    return lastCompletion - firstCompletion;
+}
+
+// Decodes block b into myRecords, unless it is there already.
+// Returns false if the block is damaged.
+bool TimelineIndex::decodeBlock(size_t b) {
+    if (b == myDecoded)
+        return true;
+    myDecoded = myNumBlocks;
+    myRecords.clear();
+
+    // Blocks are only checked as they are needed, so opening an index
+    // costs the same however long the run was
+    const BlockEntry& entry = myEntries[b];
+    const uint8_t* data = myFile.getData();
+    uint64_t endOffset = (b + 1 < myNumBlocks) ? myEntries[b + 1].offset : (const uint8_t*)myStrings - data;
+    if (entry.offset < sizeof(IndexHeader) || entry.offset > endOffset || endOffset > (uint64_t)((const uint8_t*)myStrings - data))
+        return false;
+    const uint8_t* p = data + entry.offset;
+    const uint8_t* end = data + endOffset;
+    long long number = entry.firstNumber;
+    long long completion = entry.firstCompletion;
+    for (uint32_t r = 0; r < entry.count; r++) {
+        uint64_t numberDelta, completionDelta, waited, assembly;
+        if (!readNumber(p, end, numberDelta) || !readNumber(p, end, completionDelta)
+            || !readNumber(p, end, waited) || !readNumber(p, end, assembly) || assembly >= myNumStrings) {
+            myRecords.clear();
+            return false;
+        }
+        number += numberDelta;
+        completion += completionDelta;
+
+        Record record;
+        record.number = number;
+        record.completion = completion;
+        record.fetch = completion - 4 - waited;
+        record.assembly = assembly;
+        myRecords.push_back(record);
+    }
+    myDecoded = b;
+    return true;
+}
+
+// Returns the assembly string with id
+string TimelineIndex::getAssembly(uint32_t id) {
+    uint64_t start = myStringOffsets[id];
+    uint64_t end = myStringOffsets[id + 1];
+    if (start > end || end > myStringOffsets[myNumStrings])
+        return "";
+    return string(myStrings + start, end - start);
+}
@@ -0,0 +1,177 @@
+// Palmer Robins
+
+#ifndef __TIMELINEINDEX_H__
+#define __TIMELINEINDEX_H__
+
+#include "MappedFile.h"
+#include "Timeline.h"
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Names of the stages, in the order instructions go through them
+enum PipelineStage {
+    IF_STAGE,
+    ID_STAGE,
+    EX_STAGE,
+    MEM_STAGE,
+    WB_STAGE
+};
+
+/**
+ * TimelineIndexWriter keeps the stage cycles of a run in a compact file
+ * that TimelineIndex answers questions from without simulating again.
+ * Instructions are stored in blocks of BLOCK_SIZE. Each instruction is
+ * the change from the one before it in its instruction number, the cycle
+ * it leaves and how long it waited in ID, plus which of the distinct
+ * assembly strings it is, all as variable length numbers. The assembly
+ * strings come after the blocks, then where each string starts, then an
+ * index with the first and last instruction number and cycles of every
+ * block, so a lookup searches the index and decodes a block or two.
+ */
+class TimelineIndexWriter : public TimelineRecorder {
+
+    public:
+
+        static const uint32_t VERSION = 1;
+        static const int BLOCK_SIZE = 256;
+
+        // Creates the index filename
+        TimelineIndexWriter(string filename);
+
+        // Finishes the index, if close was not called
+        ~TimelineIndexWriter();
+
+        // Returns true if the file could be created and written so far
+        bool isGood() { return myGood; }
+
+        // Writes the last block, the assembly strings and the block index.
+        // Returns true if the whole file was written.
+        bool close();
+
+    protected:
+
+        // Appends an instruction to the block being filled
+        void addStages(long long number, const string& assembly, long long fetch, long long completion);
+
+    private:
+
+        // Where a block starts in the file and what is in it
+        struct BlockEntry {
+            uint64_t offset;
+            uint32_t count;
+            uint32_t reserved;
+            int64_t firstNumber;
+            int64_t lastNumber;
+            int64_t firstFetch;
+            int64_t firstCompletion;
+            int64_t lastCompletion;
+        };
+
+        // Writes the block being filled
+        void writeBlock();
+
+        // Writes bytes to the file, keeping track of where it is
+        void write(const void* data, size_t length);
+
+        friend class TimelineIndex;
+
+        ofstream myOut;
+        bool myGood;
+        bool myClosed;
+        uint64_t myOffset; // bytes written so far
+
+        vector<uint8_t> myBlock; // the block being filled, encoded
+        BlockEntry myEntry; // what is in it
+        long long myLastNumber; // last instruction added
+        long long myLastCompletion;
+        vector<BlockEntry> myEntries; // of the blocks written
+
+        unordered_map<string, uint32_t> myAssemblyIds; // each distinct string's place in myAssembly
+        vector<string> myAssembly;
+};
+
+/**
+ * TimelineIndex answers questions about a run from the file a
+ * TimelineIndexWriter wrote. Each takes a search of the block index and
+ * decodes no more than the blocks holding the instructions asked about.
+ */
+class TimelineIndex {
+
+    public:
+
+        // An instruction and the stage it is in
+        struct Occupant {
+            long long number;
+            string assembly;
+            PipelineStage stage;
+        };
+
+        // Maps the index filename. isGood is false if it is not one.
+        TimelineIndex(string filename);
+
+        // Returns true if the file is a complete timeline index
+        bool isGood() { return myGood; }
+
+        // Returns the number of instructions recorded
+        long long getNumInstructions() { return myNumInstructions; }
+
+        // Returns the first and last instruction numbers recorded
+        long long getFirstNumber();
+        long long getLastNumber();
+
+        // Returns the cycle the first instruction is fetched and the cycle
+        // the last one leaves
+        long long getFirstCycle();
+        long long getLastCycle();
+
+        // Fills occupants with the instructions in the pipeline during
+        // cycle, oldest first, and the stage each is in
+        void occupancy(long long cycle, vector<Occupant>& occupants);
+
+        // Finds instruction number. Fills in the cycles it is fetched and
+        // leaves and returns true, or returns false if it was not recorded.
+        bool find(long long number, long long& fetch, long long& completion);
+
+        // Returns the cycles from instruction first leaving the pipeline to
+        // instruction last leaving, or -1 if either was not recorded
+        long long cyclesBetween(long long first, long long last);
+
+    private:
+
+        typedef TimelineIndexWriter::BlockEntry BlockEntry;
+
+        // One decoded instruction
+        struct Record {
+            long long number;
+            long long fetch;
+            long long completion;
+            uint32_t assembly;
+        };
+
+        // Decodes block b into myRecords, unless it is there already.
+        // Returns false if the block is damaged.
+        bool decodeBlock(size_t b);
+
+        // Returns the assembly string with id
+        string getAssembly(uint32_t id);
+
+        MappedFile myFile;
+        bool myGood;
+        long long myNumInstructions;
+        const BlockEntry* myEntries;
+        size_t myNumBlocks;
+        const char* myStrings; // the assembly strings, one after another
+        const uint64_t* myStringOffsets; // where each starts in myStrings, then where the last ends
+        uint64_t myNumStrings;
+
+        vector<Record> myRecords; // the last block decoded
+        size_t myDecoded; // which block that is, or myNumBlocks for none
+};
+
+#endif
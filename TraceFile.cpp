@@ -0,0 +1,253 @@
+// Palmer Robins
+
+#include "TraceFile.h"
+
+#include <cstring>
+
+static const char TRACE_MAGIC[8] = "PIPETRC";
+static const uint32_t TRACE_VERSION = 1;
+
+// Returns a register field as it sits in an encoding; unused fields are zero
+static uint32_t registerField(Register r) {
+    return (r < 0) ? 0 : (uint32_t)r & 31;
+}
+
+// Returns the 32 bit MIPS encoding of an instruction
+uint32_t encodeInstruction(Instruction& i) {
+    static OpcodeTable opcodes;
+    Opcode op = i.getOpcode();
+    uint32_t word = (uint32_t)stoul(opcodes.getOpcodeField(op), nullptr, 2) << 26;
+
+    switch (opcodes.getInstType(op)) {
+    case RTYPE:
+        word |= registerField(i.getRS()) << 21;
+        word |= registerField(i.getRT()) << 16;
+        word |= registerField(i.getRD()) << 11;
+        if (opcodes.IMMposition(op) != -1)
+            word |= ((uint32_t)i.getImmediate() & 31) << 6;
+        word |= (uint32_t)stoul(opcodes.getFunctField(op), nullptr, 2);
+        break;
+    case ITYPE:
+        word |= registerField(i.getRS()) << 21;
+        word |= registerField(i.getRT()) << 16;
+        word |= (uint32_t)i.getImmediate() & 0xFFFF;
+        break;
+    case JTYPE:
+        word |= ((TEXT_BASE >> 2) + (uint32_t)i.getImmediate()) & 0x3FFFFFF;
+        break;
+    }
+    return word;
+}
+
+// Creates the trace file filename. Room for the header is left at the
+// front and filled in by close.
+TraceWriter::TraceWriter(string filename, int blockLength) {
+    myBlockLength = blockLength;
+    myBlockCount = 0;
+    myPrevious = -1;
+    myNumWords = 0;
+    myOffset = sizeof(TraceHeader);
+    myClosed = false;
+
+    myOut.open(filename.c_str(), ios::binary | ios::trunc);
+    TraceHeader blank;
+    memset(&blank, 0, sizeof(blank));
+    myOut.write((const char*)&blank, sizeof(blank));
+    myGood = myOut.good();
+}
+
+// Finishes the file, if close was not called
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+// Appends the next instruction word
+void TraceWriter::addWord(uint32_t word) {
+    unordered_map<uint32_t, uint32_t>::iterator it = myDictionaryIndex.find(word);
+    uint32_t index;
+    if (it == myDictionaryIndex.end()) {
+        index = myDictionary.size();
+        myDictionaryIndex.insert(make_pair(word, index));
+        myDictionary.push_back(word);
+    }
+    else
+        index = it->second;
+
+    // Zigzag the step from the previous index so small moves either way
+    // stay small, then write it seven bits at a time
+    int64_t delta = (int64_t)index - myPrevious - 1;
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    while (zigzag >= 0x80) {
+        myBlock.push_back((uint8_t)(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    myBlock.push_back((uint8_t)zigzag);
+
+    myPrevious = index;
+    myNumWords++;
+    if (++myBlockCount == myBlockLength)
+        finishBlock();
+}
+
+// Writes the current block and starts the next
+void TraceWriter::finishBlock() {
+    myBlockOffsets.push_back(myOffset);
+    myOut.write((const char*)myBlock.data(), myBlock.size());
+    myOffset += myBlock.size();
+    myBlock.clear();
+    myBlockCount = 0;
+    myPrevious = -1;
+}
+
+// Writes the last block, the dictionary, the index and the header.
+// Returns true if the whole file was written.
+bool TraceWriter::close() {
+    if (myClosed)
+        return myGood;
+    myClosed = true;
+
+    if (myBlockCount > 0)
+        finishBlock();
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.blockLength = myBlockLength;
+    header.numInstructions = myNumWords;
+    header.numBlocks = myBlockOffsets.size();
+    header.dictionarySize = myDictionary.size();
+
+    header.dictionaryOffset = myOffset;
+    myOut.write((const char*)myDictionary.data(), myDictionary.size() * sizeof(uint32_t));
+    myOffset += myDictionary.size() * sizeof(uint32_t);
+
+    // The index ends with where the last block stops
+    header.indexOffset = myOffset;
+    myBlockOffsets.push_back(header.dictionaryOffset);
+    myOut.write((const char*)myBlockOffsets.data(), myBlockOffsets.size() * sizeof(uint64_t));
+    myOffset += myBlockOffsets.size() * sizeof(uint64_t);
+
+    myOut.seekp(0);
+    myOut.write((const char*)&header, sizeof(header));
+    myOut.close();
+    myGood = myGood && !myOut.fail();
+    return myGood;
+}
+
+// Opens the trace file filename and reads its dictionary and index
+TraceReader::TraceReader(string filename) {
+    myValid = false;
+    myPosition = 0;
+    myBlock = 0;
+    memset(&myHeader, 0, sizeof(myHeader));
+
+    myIn.open(filename.c_str(), ios::binary);
+    if (!myIn.read((char*)&myHeader, sizeof(myHeader)))
+        return;
+    if (memcmp(myHeader.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || myHeader.version != TRACE_VERSION)
+        return;
+    if (myHeader.blockLength == 0 || (uint64_t)myHeader.numBlocks * myHeader.blockLength < myHeader.numInstructions)
+        return;
+
+    // The counts in the header must fit in the bytes after the parts they
+    // describe, so a damaged header cannot ask for huge buffers. Every
+    // instruction takes at least a byte.
+    myIn.seekg(0, ios::end);
+    uint64_t size = myIn.tellg();
+    if (myHeader.dictionaryOffset > size || myHeader.indexOffset > size)
+        return;
+    if (myHeader.dictionarySize > (size - myHeader.dictionaryOffset) / sizeof(uint32_t))
+        return;
+    if (myHeader.numBlocks >= (size - myHeader.indexOffset) / sizeof(uint64_t))
+        return;
+    if (myHeader.numInstructions > size || (myHeader.numBlocks > 1 && myHeader.blockLength > size))
+        return;
+
+    myDictionary.resize(myHeader.dictionarySize);
+    myIn.seekg(myHeader.dictionaryOffset);
+    if (!myIn.read((char*)myDictionary.data(), myDictionary.size() * sizeof(uint32_t)))
+        return;
+
+    myBlockOffsets.resize(myHeader.numBlocks + 1);
+    myIn.seekg(myHeader.indexOffset);
+    if (!myIn.read((char*)myBlockOffsets.data(), myBlockOffsets.size() * sizeof(uint64_t)))
+        return;
+    for (uint32_t b = 0; b < myHeader.numBlocks; b++)
+        if (myBlockOffsets[b] > myBlockOffsets[b + 1])
+            return;
+    if (myBlockOffsets[myHeader.numBlocks] > size)
+        return;
+
+    myValid = true;
+
+    // Nothing is decoded yet, so the first call to next loads block 0
+    myBlock = (uint32_t)-1;
+}
+
+// Makes instruction n the next one returned. Returns false if
+// there is no such instruction.
+bool TraceReader::seek(uint64_t n) {
+    if (!myValid || n >= myHeader.numInstructions)
+        return false;
+    uint32_t b = n / myHeader.blockLength;
+    if (b != myBlock && !loadBlock(b))
+        return false;
+    myPosition = n % myHeader.blockLength;
+    return true;
+}
+
+// Reads and decodes block b into myIndices
+bool TraceReader::loadBlock(uint32_t b) {
+    myIndices.clear();
+    myPosition = 0;
+    if (!myValid || b >= myHeader.numBlocks)
+        return false;
+
+    uint64_t length = myBlockOffsets[b + 1] - myBlockOffsets[b];
+    myBytes.resize(length);
+    myIn.clear();
+    myIn.seekg(myBlockOffsets[b]);
+    if (!myIn.read((char*)myBytes.data(), length)) {
+        myValid = false;
+        return false;
+    }
+
+    uint64_t count = myHeader.blockLength;
+    if (b == myHeader.numBlocks - 1)
+        count = myHeader.numInstructions - (uint64_t)b * myHeader.blockLength;
+    if (count > length) {
+        myValid = false;
+        return false;
+    }
+    myIndices.resize(count);
+
+    const uint8_t* p = myBytes.data();
+    const uint8_t* end = p + length;
+    int64_t previous = -1;
+    for (uint64_t k = 0; k < count; k++) {
+        // Most steps fit in one byte
+        uint64_t zigzag = 0;
+        int shift = 0;
+        while (p < end && (*p & 0x80) && shift < 63) {
+            zigzag |= (uint64_t)(*p++ & 0x7F) << shift;
+            shift += 7;
+        }
+        if (p == end) {
+            myValid = false;
+            return false;
+        }
+        zigzag |= (uint64_t)*p++ << shift;
+
+        int64_t index = previous + 1 + (int64_t)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+        if (index < 0 || index >= (int64_t)myDictionary.size()) {
+            myValid = false;
+            return false;
+        }
+        myIndices[k] = index;
+        previous = index;
+    }
+
+    myBlock = b;
+    return true;
+}
@@ -0,0 +1,141 @@
+// Palmer Robins
+
+#ifndef __TRACEFILE_H__
+#define __TRACEFILE_H__
+
+#include "Instruction.h"
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The fixed part at the front of a packed trace. The file holds the
+ * header, then the encoded blocks, then the dictionary of distinct 32 bit
+ * instruction words, then the block index: one file offset per block plus
+ * one for the end of the last block.
+ *
+ * A block lists the dictionary index of each of its instructions. Every
+ * index is stored as the zigzag encoded difference from the previous index
+ * minus one, as an LEB128 varint, so straight line code that repeats the
+ * dictionary's order costs one byte per instruction. The previous index
+ * starts over at -1 in each block, so any block decodes on its own.
+ */
+struct TraceHeader {
+    char magic[8]; // "PIPETRC" and a zero byte
+    uint32_t version;
+    uint32_t blockLength; // instructions per block, except maybe the last
+    uint64_t numInstructions;
+    uint64_t dictionaryOffset;
+    uint32_t dictionarySize; // distinct instruction words
+    uint32_t numBlocks;
+    uint64_t indexOffset;
+};
+
+// Returns the 32 bit MIPS encoding of an instruction
+uint32_t encodeInstruction(Instruction& i);
+
+/**
+ * TraceWriter packs a stream of instruction words into a trace file
+ * in one pass, holding only the dictionary and the current block.
+ */
+class TraceWriter {
+
+    public:
+
+        static const int DEFAULT_BLOCK_LENGTH = 4096;
+
+        // Creates the trace file filename
+        TraceWriter(string filename, int blockLength = DEFAULT_BLOCK_LENGTH);
+
+        // Finishes the file, if close was not called
+        ~TraceWriter();
+
+        // Returns true if the file could be created and written so far
+        bool isGood() { return myGood; }
+
+        // Appends the next instruction word
+        void addWord(uint32_t word);
+
+        // Writes the last block, the dictionary, the index and the header.
+        // Returns true if the whole file was written.
+        bool close();
+
+        // Returns the bytes written so far
+        uint64_t getBytesWritten() { return myOffset; }
+
+    private:
+
+        // Writes the current block and starts the next
+        void finishBlock();
+
+        ofstream myOut;
+        bool myGood;
+        bool myClosed;
+        int myBlockLength;
+        int myBlockCount; // instructions in the current block
+        int64_t myPrevious; // dictionary index of the block's previous instruction
+        uint64_t myNumWords;
+        uint64_t myOffset; // where the next byte lands in the file
+
+        unordered_map<uint32_t, uint32_t> myDictionaryIndex; // word to dictionary index
+        vector<uint32_t> myDictionary;
+        vector<uint64_t> myBlockOffsets;
+        vector<uint8_t> myBlock; // encoded indices of the current block
+};
+
+/**
+ * TraceReader streams the dictionary indices out of a trace file a block
+ * at a time, so only the dictionary, the index and one block are ever in
+ * memory. seek jumps to any instruction through the block index.
+ */
+class TraceReader {
+
+    public:
+
+        // Opens the trace file filename and reads its dictionary and index
+        TraceReader(string filename);
+
+        // Returns true if the file is a trace and every block read so far was sound
+        bool isValid() { return myValid; }
+
+        // Returns the number of instructions in the trace
+        uint64_t getNumInstructions() { return myHeader.numInstructions; }
+
+        // Returns the distinct instruction words, by dictionary index
+        vector<uint32_t>& getDictionary() { return myDictionary; }
+
+        // Sets index to the dictionary index of the next instruction.
+        // Returns false at the end of the trace or if a block is damaged.
+        bool next(uint32_t& index) {
+            if (myPosition == myIndices.size() && !loadBlock(myBlock + 1))
+                return false;
+            index = myIndices[myPosition++];
+            return true;
+        }
+
+        // Makes instruction n the next one returned. Returns false if
+        // there is no such instruction.
+        bool seek(uint64_t n);
+
+    private:
+
+        // Reads and decodes block b into myIndices
+        bool loadBlock(uint32_t b);
+
+        ifstream myIn;
+        bool myValid;
+        TraceHeader myHeader;
+        vector<uint32_t> myDictionary;
+        vector<uint64_t> myBlockOffsets;
+        vector<uint8_t> myBytes; // the encoded block last read
+        vector<uint32_t> myIndices; // the decoded block last read
+        size_t myPosition; // next entry of myIndices to return
+        uint32_t myBlock; // the block in myIndices
+};
+
+#endif
@@ -0,0 +1,22 @@
+// Palmer Robins
+
+#include "TraceParser.h"
+
+// Specify a packed trace file. Function checks the file and decodes
+// its dictionary of instruction words.
+TraceParser::TraceParser(string filename) : myReader(filename) {
+    myFormatCorrect = myReader.isValid();
+
+    vector<uint32_t>& dictionary = myReader.getDictionary();
+    myInstructions.resize(dictionary.size());
+    for (unsigned int d = 0; d < dictionary.size() && myFormatCorrect; d++)
+        myFormatCorrect = myDecoder.decodeWord(dictionary[d], myInstructions[d]);
+}
+
+// Iterator that returns the next Instruction in the trace
+Instruction TraceParser::getNextInstruction() {
+    uint32_t index;
+    if (!myFormatCorrect || !myReader.next(index))
+        return Instruction();
+    return myInstructions[index];
+}
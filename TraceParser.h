@@ -0,0 +1,48 @@
+// Palmer Robins
+
+#ifndef __TRACEPARSER_H__
+#define __TRACEPARSER_H__
+
+#include "BinaryParser.h"
+#include "Instruction.h"
+#include "ParseError.h"
+#include "TraceFile.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * TraceParser reads a packed trace file, as written by --pack. Each
+ * distinct instruction word in the dictionary is decoded once up front;
+ * the instructions themselves are streamed out of the file a block at a
+ * time as getNextInstruction is called.
+ */
+class TraceParser {
+
+public:
+
+    // Specify a packed trace file. Function checks the file and decodes
+    // its dictionary of instruction words.
+    TraceParser(string filename);
+
+    // Returns true if the file specified was a sound trace. Otherwise,
+    // returns false.
+    bool isFormatCorrect() { return myFormatCorrect && myReader.isValid(); };
+
+    // A packed trace has no lines, so its damage is never pinned to one
+    vector<ParseError>& getErrors() { return myErrors; }
+
+    // Iterator that returns the next Instruction in the trace
+    Instruction getNextInstruction();
+
+private:
+
+    TraceReader myReader;
+    BinaryParser myDecoder;
+    vector<Instruction> myInstructions; // the decoded dictionary
+    bool myFormatCorrect;
+    vector<ParseError> myErrors; // always empty
+};
+
+#endif
@@ -0,0 +1,342 @@
+// Palmer Robins
+
+#include "Translator.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define CAN_TRANSLATE 1
+#else
+#define CAN_TRANSLATE 0
+#endif
+
+// x86-64 register numbers used in ModRM reg fields
+static const uint8_t EAX = 0;
+static const uint8_t EDX = 2;
+static const uint8_t ESI = 6;
+static const uint8_t EDI = 7;
+static const uint8_t R12 = 4; // with a REX.R or REX.B prefix
+
+// Offsets of the GuestState fields that compiled code touches
+static const int32_t HI_OFFSET = offsetof(GuestState, hi);
+static const int32_t LO_OFFSET = offsetof(GuestState, lo);
+static const int32_t BUDGET_OFFSET = offsetof(GuestState, budget);
+static const int32_t LOG_OFFSET = offsetof(GuestState, log);
+static const int32_t LOG_END_OFFSET = offsetof(GuestState, logEnd);
+static const int32_t MEMORY_OFFSET = offsetof(GuestState, memory);
+
+// Called from compiled code to carry out a load
+static uint8_t readByteHelper(SparseMemory* memory, uint32_t address) {
+    return memory->readByte(address);
+}
+
+// Maps the code buffer
+TranslationCache::TranslationCache() {
+    myCode = nullptr;
+    myUsed = myStub = 0;
+    myLogging = false;
+
+#if CAN_TRANSLATE
+    // Never writable and executable at once: setExecutable flips it
+    // between the two around each compile
+    void* code = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code != MAP_FAILED)
+        myCode = (uint8_t*)code;
+#endif
+}
+
+// Unmaps the code buffer
+TranslationCache::~TranslationCache() {
+#if CAN_TRANSLATE
+    if (myCode)
+        munmap(myCode, CODE_SIZE);
+#endif
+}
+
+// Makes the code buffer executable and read only, or writable and not
+// executable. If that fails the buffer is unmapped and no more blocks
+// are compiled. Returns false if there is no buffer.
+bool TranslationCache::setExecutable(bool executable) {
+#if CAN_TRANSLATE
+    if (myCode && mprotect(myCode, CODE_SIZE, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) != 0) {
+        munmap(myCode, CODE_SIZE);
+        myCode = nullptr;
+    }
+#endif
+    return myCode != nullptr;
+}
+
+// Discards every compiled block and switches to the given program.
+// If logBlocks is true, compiled blocks log themselves as they run.
+void TranslationCache::reset(vector<Instruction>& program, bool logBlocks) {
+    myProgram = program;
+    myLogging = logBlocks;
+    myEntry.assign(program.size(), -1);
+    myChain.assign(program.size(), -1);
+    myLength.assign(program.size(), 0);
+    myPendingExits.assign(program.size(), vector<size_t>());
+
+    if (!setExecutable(false))
+        return;
+
+    // Every block returns to the executor through this stub, which writes the
+    // budget back: mov [rbx+budget], r12; add rsp, 8; pop r12; pop rbx; ret
+    myUsed = 0;
+    myStub = myUsed;
+    emitRBX(0x4C, 0x89, R12, BUDGET_OFFSET);
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(0x08);
+    emit8(0x41); emit8(0x5C);
+    emit8(0x5B);
+    emit8(0xC3);
+    setExecutable(true);
+}
+
+// Given an instruction number, returns the compiled block that starts
+// there, compiling it first if needed. Returns nullptr if no block
+// can start at that instruction.
+TranslationCache::BlockCode TranslationCache::lookup(int pc) {
+    if (!myCode || pc < 0 || pc >= (int)myProgram.size() || myProgram[pc].getOpcode() == UNDEFINED)
+        return nullptr;
+
+    if (myEntry[pc] < 0) {
+        // Start over with an empty cache once the buffer is full
+        if (myUsed + MAX_BLOCK_CODE > CODE_SIZE)
+            reset(myProgram, myLogging);
+
+        // Compiling also patches the exits of earlier blocks
+        if (!setExecutable(false))
+            return nullptr;
+        translate(pc);
+        if (!setExecutable(true))
+            return nullptr;
+    }
+    return (BlockCode)(myCode + myEntry[pc]);
+}
+
+// Given a register field, returns the offset of its slot in GuestState
+int32_t TranslationCache::regOffset(Register r) {
+    if (r < 0 || r >= NumRegisters)
+        r = NumRegisters;
+    return offsetof(GuestState, regs) + 4 * r;
+}
+
+// Compiles the block starting at pc into the code buffer
+void TranslationCache::translate(int pc) {
+    // Find where the block ends
+    int end = pc;
+    while (end < (int)myProgram.size() && end - pc < MAX_BLOCK_LENGTH) {
+        Opcode op = myProgram[end].getOpcode();
+        if (op == UNDEFINED)
+            break;
+        end++;
+        if (op == J || op == BEQ)
+            break;
+    }
+    int length = end - pc;
+
+    // Entry from the executor keeps the state in rbx and the budget in r12:
+    // push rbx; push r12; sub rsp, 8; mov rbx, rdi; mov r12, [rbx+budget]
+    myEntry[pc] = myUsed;
+    emit8(0x53);
+    emit8(0x41); emit8(0x54);
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(0x08);
+    emit8(0x48); emit8(0x89); emit8(0xFB);
+    emitRBX(0x4C, 0x8B, R12, BUDGET_OFFSET);
+
+    // Chained exits land here: sub r12, length; jl bail
+    myChain[pc] = myUsed;
+    myLength[pc] = length;
+    emit8(0x49); emit8(0x81); emit8(0xEC); emit32(length);
+    emit8(0x0F); emit8(0x8C);
+    size_t budgetFixup = myUsed;
+    emit32(0);
+
+    size_t logFixup = 0;
+    if (myLogging) {
+        // mov rax, [rbx+log]; cmp rax, [rbx+logEnd]; jae bail
+        emitRBX(0x48, 0x8B, EAX, LOG_OFFSET);
+        emitRBX(0x48, 0x3B, EAX, LOG_END_OFFSET);
+        emit8(0x0F); emit8(0x83);
+        logFixup = myUsed;
+        emit32(0);
+        // mov dword [rax], pc; mov dword [rax+4], length; add rax, 8; mov [rbx+log], rax
+        emit8(0xC7); emit8(0x00); emit32(pc);
+        emit8(0xC7); emit8(0x40); emit8(0x04); emit32(length);
+        emit8(0x48); emit8(0x83); emit8(0xC0); emit8(0x08);
+        emitRBX(0x48, 0x89, EAX, LOG_OFFSET);
+    }
+
+    // The guest slot whose value eax still holds, so the next instruction
+    // can skip reloading it
+    myEAXHolds = -1;
+
+    for (int k = pc; k < end; k++) {
+        Instruction& i = myProgram[k];
+        int32_t rs = regOffset(i.getRS());
+        int32_t rt = regOffset(i.getRT());
+        int32_t rd = regOffset(i.getRD());
+        int32_t imm = i.getImmediate();
+
+        // Results bound for $0 are computed but never stored
+        int32_t dest = -1;
+
+        switch (i.getOpcode()) {
+        case ADD: // mov eax, [rs]; add eax, [rt]
+            emitLoadEAX(rs);
+            emitRBX(0, 0x03, EAX, rt);
+            dest = rd;
+            break;
+        case ADDI: // mov eax, [rs]; add eax, imm
+            emitLoadEAX(rs);
+            emit8(0x05); emit32(imm);
+            dest = rt;
+            break;
+        case XOR: // mov eax, [rs]; xor eax, [rt]
+            emitLoadEAX(rs);
+            emitRBX(0, 0x33, EAX, rt);
+            dest = rd;
+            break;
+        case MULT: // mov eax, [rs]; imul dword [rt]; mov [lo], eax; mov [hi], edx
+            emitLoadEAX(rs);
+            emitRBX(0, 0xF7, 5, rt);
+            emitRBX(0, 0x89, EAX, LO_OFFSET);
+            emitRBX(0, 0x89, EDX, HI_OFFSET);
+            myEAXHolds = LO_OFFSET;
+            break;
+        case MFLO: // mov eax, [lo]
+            emitLoadEAX(LO_OFFSET);
+            dest = rd;
+            break;
+        case SLL: // mov eax, [rt]; shl eax, imm
+            emitLoadEAX(rt);
+            emit8(0xC1); emit8(0xE0); emit8(imm & 31);
+            dest = rd;
+            break;
+        case SLT: // mov eax, [rs]; cmp eax, [rt]; setl al; movzx eax, al
+            emitLoadEAX(rs);
+            emitRBX(0, 0x3B, EAX, rt);
+            emit8(0x0F); emit8(0x9C); emit8(0xC0);
+            emit8(0x0F); emit8(0xB6); emit8(0xC0);
+            dest = rd;
+            break;
+        case SLTI: // mov eax, [rs]; cmp eax, imm; setl al; movzx eax, al
+            emitLoadEAX(rs);
+            emit8(0x3D); emit32(imm);
+            emit8(0x0F); emit8(0x9C); emit8(0xC0);
+            emit8(0x0F); emit8(0xB6); emit8(0xC0);
+            dest = rt;
+            break;
+        case LB: // mov esi, [rs]; add esi, imm; mov rdi, [rbx+memory]; call helper; movsx eax, al
+            emitRBX(0, 0x8B, ESI, rs);
+            emit8(0x81); emit8(0xC6); emit32(imm);
+            emitRBX(0x48, 0x8B, EDI, MEMORY_OFFSET);
+            emit8(0x48); emit8(0xB8); emit64((uint64_t)(uintptr_t)&readByteHelper);
+            emit8(0xFF); emit8(0xD0);
+            emit8(0x0F); emit8(0xBE); emit8(0xC0);
+            myEAXHolds = -1;
+            dest = rt;
+            break;
+        case J:
+            emitExit(imm);
+            break;
+        case BEQ: { // mov eax, [rs]; cmp eax, [rt]; je taken
+            emitLoadEAX(rs);
+            emitRBX(0, 0x3B, EAX, rt);
+            emit8(0x0F); emit8(0x84);
+            size_t takenFixup = myUsed;
+            emit32(0);
+            emitExit(k + 1);
+            patchJump(takenFixup, myUsed);
+            emitExit(k + 1 + imm);
+            break;
+        }
+        default:
+            break;
+        }
+
+        // mov [dest], eax
+        if (dest >= 0 && dest != regOffset(0)) {
+            emitRBX(0, 0x89, EAX, dest);
+            myEAXHolds = dest;
+        }
+        else if (dest >= 0)
+            myEAXHolds = -1;
+    }
+
+    // A block cut short by its length limit falls through to the next instruction
+    Opcode last = myProgram[end - 1].getOpcode();
+    if (last != J && last != BEQ)
+        emitExit(end);
+
+    // bail: add r12, length; mov eax, pc; jmp stub
+    patchJump(budgetFixup, myUsed);
+    if (myLogging)
+        patchJump(logFixup, myUsed);
+    emit8(0x49); emit8(0x81); emit8(0xC4); emit32(length);
+    emit8(0xB8); emit32(pc);
+    emit8(0xE9);
+    size_t bailFixup = myUsed;
+    emit32(0);
+    patchJump(bailFixup, myStub);
+
+    // Exits elsewhere that were waiting for this block can now jump straight in
+    vector<size_t>& pending = myPendingExits[pc];
+    for (unsigned int p = 0; p < pending.size(); p++)
+        patchJump(pending[p], myChain[pc]);
+    pending.clear();
+}
+
+// Loads the guest slot at offset into eax, unless eax already holds it
+void TranslationCache::emitLoadEAX(int32_t offset) {
+    if (myEAXHolds == offset)
+        return;
+    emitRBX(0, 0x8B, EAX, offset);
+    myEAXHolds = offset;
+}
+
+// Writes the code that leaves a block for instruction target, either
+// through the return stub or straight into target's block
+void TranslationCache::emitExit(uint32_t target) {
+    // mov eax, target; jmp rel32
+    emit8(0xB8); emit32(target);
+    emit8(0xE9);
+    size_t fixup = myUsed;
+    emit32(0);
+
+    if (target < myProgram.size() && myChain[target] >= 0)
+        patchJump(fixup, myChain[target]);
+    else {
+        patchJump(fixup, myStub);
+        if (target < myProgram.size())
+            myPendingExits[target].push_back(fixup);
+    }
+}
+
+// Points the rel32 field at offset fixup to the code at offset target
+void TranslationCache::patchJump(size_t fixup, size_t target) {
+    int32_t rel = (int32_t)((int64_t)target - (int64_t)(fixup + 4));
+    memcpy(myCode + fixup, &rel, 4);
+}
+
+// Appends a 32 bit little endian value to the code buffer
+void TranslationCache::emit32(uint32_t v) {
+    memcpy(myCode + myUsed, &v, 4);
+    myUsed += 4;
+}
+
+// Appends a 64 bit little endian value to the code buffer
+void TranslationCache::emit64(uint64_t v) {
+    memcpy(myCode + myUsed, &v, 8);
+    myUsed += 8;
+}
+
+// Appends an instruction that addresses [rbx + disp32]
+void TranslationCache::emitRBX(uint8_t prefix, uint8_t opcode, uint8_t reg, int32_t disp) {
+    if (prefix)
+        emit8(prefix);
+    emit8(opcode);
+    emit8(0x80 | (reg << 3) | 3); // mod=10 (disp32), rm=rbx
+    emit32(disp);
+}
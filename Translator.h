@@ -0,0 +1,118 @@
+// Palmer Robins
+
+#ifndef __TRANSLATOR_H__
+#define __TRANSLATOR_H__
+
+#include "Executor.h"
+#include "Instruction.h"
+#include "OpcodeTable.h"
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The TranslationCache compiles basic blocks of a program into x86-64 host code
+ * the first time they are reached and keeps them for later visits. A block
+ * ends at a J or BEQ, so every exit is to a known instruction number, and
+ * exits are patched to jump straight into the next block once it has been
+ * compiled. Control only returns to the executor when the program leaves its
+ * last block, the step budget runs out, or the block log fills up.
+ *
+ * The code buffer is writable while a block is compiled and executable while
+ * blocks run, never both. On hosts that are not x86-64, or where the buffer
+ * cannot be mapped or protected, isAvailable returns false and the executor
+ * interprets instead.
+ */
+class TranslationCache {
+
+    public:
+
+        // A compiled block. Runs from the block's first instruction and returns
+        // the number of the next instruction to execute.
+        typedef uint32_t (*BlockCode)(GuestState* state);
+
+        static const int LOG_RECORDS = 4096; // block records logged before returning
+        static const int MAX_BLOCK_LENGTH = 64; // longest block that gets compiled
+
+        // Maps the code buffer
+        TranslationCache();
+
+        // Unmaps the code buffer
+        ~TranslationCache();
+
+        // Returns true if blocks can be compiled and run on this host
+        bool isAvailable() { return myCode != nullptr; }
+
+        // Returns true if compiled blocks write a record each time they run
+        bool isLogging() { return myLogging; }
+
+        // Discards every compiled block and switches to the given program.
+        // If logBlocks is true, compiled blocks log themselves as they run.
+        void reset(vector<Instruction>& program, bool logBlocks);
+
+        // Given an instruction number, returns the compiled block that starts
+        // there, compiling it first if needed. Returns nullptr if no block
+        // can start at that instruction.
+        BlockCode lookup(int pc);
+
+        // Given an instruction number with a compiled block, returns the
+        // number of instructions in that block
+        int blockLength(int pc) { return myLength[pc]; }
+
+    private:
+
+        static const size_t CODE_SIZE = 16 << 20; // bytes of executable memory
+        static const size_t MAX_BLOCK_CODE = 8 << 10; // upper bound on one block's code
+
+        // Makes the code buffer executable and read only, or writable and not
+        // executable. If that fails the buffer is unmapped and no more blocks
+        // are compiled. Returns false if there is no buffer.
+        bool setExecutable(bool executable);
+
+        // Compiles the block starting at pc into the code buffer
+        void translate(int pc);
+
+        // Given a register field, returns the offset of its slot in GuestState
+        int32_t regOffset(Register r);
+
+        // Loads the guest slot at offset into eax, unless eax already holds it
+        void emitLoadEAX(int32_t offset);
+
+        // Writes the code that leaves a block for instruction target, either
+        // through the return stub or straight into target's block
+        void emitExit(uint32_t target);
+
+        // Points the rel32 field at offset fixup to the code at offset target
+        void patchJump(size_t fixup, size_t target);
+
+        // Appends a byte to the code buffer
+        void emit8(uint8_t b) { myCode[myUsed++] = b; }
+
+        // Appends a 32 bit little endian value to the code buffer
+        void emit32(uint32_t v);
+
+        // Appends a 64 bit little endian value to the code buffer
+        void emit64(uint64_t v);
+
+        // Appends an instruction that addresses [rbx + disp32]
+        void emitRBX(uint8_t prefix, uint8_t opcode, uint8_t reg, int32_t disp);
+
+        uint8_t* myCode; // code buffer, writable or executable
+        size_t myUsed; // bytes of myCode holding code
+        size_t myStub; // offset of the shared return sequence
+        int32_t myEAXHolds; // guest slot cached in eax while a block is compiled, or -1
+
+        vector<Instruction> myProgram;
+        bool myLogging;
+
+        vector<int32_t> myEntry; // offset of each block's called entry, or -1
+        vector<int32_t> myChain; // offset past the prologue, where chained exits land
+        vector<int> myLength; // instructions in each block
+        vector<vector<size_t> > myPendingExits; // exits waiting for a block to be compiled
+
+        OpcodeTable myOpcodes;
+};
+
+#endif